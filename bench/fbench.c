@@ -0,0 +1,132 @@
+// "fbench.c" - host benchmark of the fused output kernel.
+//
+// Takes a record of raw z and peak labels through the output stage of
+// dorun() twice: as separate full-length passes (scale, add noise, then
+// pack block by block, the way dorun() did before sink_writeraw()), and
+// fused (noise per block, then sink_packraw() scales, adds it and packs in
+// one pass). Reports the time per sample of each format, the main memory
+// traffic of each path and the bandwidth it amounts to, and checks that
+// both produce the same bytes.
+//
+//   fbench [samples [blocksize [Anoise]]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "sink.h"
+#include "ran1.h"
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* a checksum of the packed bytes, so that neither path is optimised away */
+static unsigned long sum(const char *buf, long len)
+{
+   long i;
+   unsigned long s;
+
+   s = 0;
+   for(i=0;i<len;i++) s = 31*s + (unsigned char)buf[i];
+   return s;
+}
+
+int main(int argc, char **argv)
+{
+   static const char *names[] = { "txt", "f32", "i16" };
+   double *z,*zs,*ipeak,*noise,Anoise,zmin,zmax,zrange,t0,ts,tf;
+   double mbs,mbf;
+   unsigned long ss,sf;
+   long n,i,len,outs,outf;
+   int bs,m,j,fmt;
+   long seed;
+   ran1state rng;
+   char *buf;
+
+   n = argc > 1 ? atol(argv[1]) : 1L<<23;
+   bs = argc > 2 ? atoi(argv[2]) : 1024;
+   Anoise = argc > 3 ? atof(argv[3]) : 0.05;
+   if(n < 1 || bs < 1) {
+     fprintf(stderr,"fbench: bad parameters\n");
+     return 1;}
+
+   /* a beat-like raw z, labels at 1 Hz */
+   z = (double *)malloc(n*sizeof(double));
+   zs = (double *)malloc(n*sizeof(double));
+   ipeak = (double *)malloc(n*sizeof(double));
+   noise = (double *)calloc(bs,sizeof(double));
+   buf = (char *)malloc((size_t)bs*SINK_MAXREC);
+   for(i=0;i<n;i++)
+   {
+      z[i] = 0.03*exp(-200.0*pow(fmod(i/256.0,1.0)-0.5,2))
+             + 0.005*sin(i/256.0);
+      ipeak[i] = i % 256 == 128 ? 3.0 : 0.0;
+   }
+   zmin = zmax = z[0];
+   for(i=1;i<n;i++)
+   {
+      if(z[i] < zmin)       zmin = z[i];
+      else if(z[i] > zmax)  zmax = z[i];
+   }
+   zrange = zmax-zmin;
+
+   printf("samples            %ld, blocks of %d, Anoise %g mV\n",n,bs,Anoise);
+   for(fmt=SINK_TXT;fmt<=SINK_I16;fmt++)
+   {
+      /* separate passes over the whole record */
+      memcpy(zs,z,n*sizeof(double));
+      seed = -1;
+      memset(&rng,0,sizeof(rng));
+      ss = 0;
+      outs = 0;
+      t0 = now();
+      for(i=0;i<n;i++) zs[i] = (zs[i]-zmin)*(1.6)/zrange - 0.4;
+      for(i=0;i<n;i++) zs[i] += Anoise*(2.0*ran1_r(&seed,&rng) - 1.0);
+      for(i=0;i<n;i+=bs)
+      {
+         m = n-i < bs ? n-i : bs;
+         len = sink_pack(fmt, 1.0/256, i, zs+i, ipeak+i, m, buf);
+         ss += sum(buf, len < 64 ? len : 64);
+         outs += len;
+      }
+      ts = now()-t0;
+
+      /* fused, block by block */
+      seed = -1;
+      memset(&rng,0,sizeof(rng));
+      sf = 0;
+      outf = 0;
+      t0 = now();
+      for(i=0;i<n;i+=bs)
+      {
+         m = n-i < bs ? n-i : bs;
+         if(Anoise != 0.0)
+           for(j=0;j<m;j++) noise[j] = Anoise*(2.0*ran1_r(&seed,&rng) - 1.0);
+         len = sink_packraw(fmt, 1.0/256, i, z+i, noise, ipeak+i, m,
+                            zmin, zrange, buf);
+         sf += sum(buf, len < 64 ? len : 64);
+         outf += len;
+      }
+      tf = now()-t0;
+
+      /* bytes to and from main memory besides the packed output: the
+         separate passes read and write zs twice, then read zs and ipeak;
+         the fused one reads z and ipeak once */
+      mbs = (32.0*n + 16.0*n)/1e6;
+      mbf = 16.0*n/1e6;
+      printf("%s separate       %6.2f ns/sample %7.0f MB %6.2f GB/s\n",
+             names[fmt],1e9*ts/n,mbs,mbs/1e3/ts);
+      printf("%s fused          %6.2f ns/sample %7.0f MB %6.2f GB/s  "
+             "(%.2fx, %s)\n",names[fmt],1e9*tf/n,mbf,mbf/1e3/tf,ts/tf,
+             ss == sf && outs == outf ? "same output" : "OUTPUT DIFFERS");
+   }
+
+   free(z); free(zs); free(ipeak); free(noise); free(buf);
+   return 0;
+}
@@ -0,0 +1,140 @@
+// "qbench.c" - host benchmark of the fixed-point integrator.
+//
+// Integrates the same record with the double integrator (gen_step) and the
+// fixed-point one (genq_step, driven by the same RR process), then reports
+// the cost of a step, the CPU load of real-time generation at sf, and the
+// deviation of the scaled ECG and its peak labels.
+//
+//   qbench [N [sf [hrmean]]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "gen.h"
+#include "gen_tpl.h"
+#include "genq.h"
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* scale z[1..n] to -0.4..1.2 mV as dorun() does */
+static void scale(double *z, int n)
+{
+   int i;
+   double zmin,zmax,zrange;
+
+   zmin = zmax = z[1];
+   for(i=2;i<=n;i++)
+   {
+      if(z[i] < zmin) zmin = z[i];
+      if(z[i] > zmax) zmax = z[i];
+   }
+   zrange = zmax-zmin;
+   for(i=1;i<=n;i++) z[i] = (z[i]-zmin)*1.6/zrange - 0.4;
+}
+
+int main(int argc, char **argv)
+{
+   genparams p;
+   gen g;
+   genq q;
+   q_t *rrq,ti[GENQ_MAXK],ai[GENQ_MAXK],bi[GENQ_MAXK];
+   double *xd,*yd,*zd,*xq,*yq,*zq,*ld,*lq;
+   double t0,td,tq,dev,maxdev,sumsq;
+   int i,j,n,nt,ndiff,nlab;
+
+   memset(&p,0,sizeof(p));
+   p.N = argc > 1 ? atoi(argv[1]) : 256;
+   p.sf = argc > 2 ? atoi(argv[2]) : 256;
+   p.sfecg = p.sf;
+   p.hrmean = argc > 3 ? atof(argv[3]) : 60.0;
+   p.hrstd = 1.0;
+   p.flo = 0.1;
+   p.fhi = 0.25;
+   p.flostd = 0.01;
+   p.fhistd = 0.01;
+   p.lfhfratio = 0.5;
+   p.seed = 1;
+   p.prec = GEN_DOUBLE;
+   if(gen_check(&p) != NULL || gen_init(&g,&p) != 0) {
+     fprintf(stderr,"qbench: bad parameters\n");
+     return 1;}
+
+   /* the fixed-point integrator on the same RR process and morphology */
+   rrq = (q_t *)malloc((size_t)(g.Nrr+1)*sizeof(q_t));
+   for(i=1;i<=g.Nrr;i++) rrq[i] = GENQ_Q(g.rr[i]);
+   genq_init(&q, rrq, g.Nrr, p.sf, GENQ_Q(p.fhi));
+   for(i=1;i<=g.k;i++)
+   {
+      ti[i-1] = GENQ_Q(g.ti[i]);
+      ai[i-1] = GENQ_Q(g.ai[i]);
+      bi[i-1] = GENQ_Q(g.bi[i]);
+   }
+   genq_setmorph(&q, g.k, ti, ai, bi);
+
+   nt = g.Nt;
+   xd = mallocVect(1,nt); yd = mallocVect(1,nt); zd = mallocVect(1,nt);
+   xq = mallocVect(1,nt); yq = mallocVect(1,nt); zq = mallocVect(1,nt);
+   ld = mallocVect(1,nt); lq = mallocVect(1,nt);
+
+   xd[1] = g.x[1]; yd[1] = g.x[2]; zd[1] = g.x[3];
+   t0 = now();
+   for(i=2;i<=nt;i++)
+   {
+      gen_step(&g);
+      xd[i] = g.x[1]; yd[i] = g.x[2]; zd[i] = g.x[3];
+   }
+   td = now()-t0;
+
+   xq[1] = GENQ_D(q.x); yq[1] = GENQ_D(q.y); zq[1] = GENQ_D(q.z);
+   t0 = now();
+   for(i=2;i<=nt;i++)
+   {
+      genq_step(&q);
+      xq[i] = GENQ_D(q.x); yq[i] = GENQ_D(q.y); zq[i] = GENQ_D(q.z);
+   }
+   tq = now()-t0;
+
+   detectpeaks(&g, ld, xd, yd, zd, nt);
+   detectpeaks(&g, lq, xq, yq, zq, nt);
+   scale(zd,nt);
+   scale(zq,nt);
+
+   maxdev = sumsq = 0.0;
+   ndiff = nlab = 0;
+   for(i=1;i<=nt;i++)
+   {
+      dev = fabs(zq[i]-zd[i]);
+      if(dev > maxdev) maxdev = dev;
+      sumsq += dev*dev;
+      if(ld[i] != 0.0) nlab++;
+      if(ld[i] != lq[i]) ndiff++;
+   }
+   n = nt-1;
+
+   printf("samples            %d (%d beats, sf %d Hz)\n",nt,p.N,p.sf);
+   printf("double step        %.1f ns (%.3f%% of a core at sf)\n",
+          1e9*td/n, 100.0*td/n*p.sf);
+   printf("fixed-point step   %.1f ns (%.3f%% of a core at sf)\n",
+          1e9*tq/n, 100.0*tq/n*p.sf);
+   printf("max deviation      %.6f mV\n",maxdev);
+   printf("rms deviation      %.6f mV\n",sqrt(sumsq/nt));
+   j = 0;
+   for(i=1;i<=nt;i++) if(lq[i] != 0.0) j++;
+   printf("peak labels        %d (fixed-point %d, %d samples differ)\n",
+          nlab,j,ndiff);
+
+   freeVect(xd,1,nt); freeVect(yd,1,nt); freeVect(zd,1,nt);
+   freeVect(xq,1,nt); freeVect(yq,1,nt); freeVect(zq,1,nt);
+   freeVect(ld,1,nt); freeVect(lq,1,nt);
+   free(rrq);
+   gen_free(&g);
+   return 0;
+}
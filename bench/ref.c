@@ -0,0 +1,422 @@
+// "ref.c" - frozen reference copies of the numerical kernels.
+//
+// Copied from src/ran1.c, src/dfour1.c and the original src/ecgsyn.c; only
+// the context (refgen), the scratch space (malloc instead of the arena) and
+// the rrpc lookup of the angular frequency differ. Do not optimise or
+// otherwise edit this file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "ref.h"
+
+#define PI (2.0*asin(1.0))
+#define MIN(a,b) (a < b ? a : b)
+#define MAX(a,b) (a > b ? a : b)
+#define SWAP(a,b) tempr=a;a=b;b=tempr
+#define REF_MAXN 8
+
+/* vector v[n0..nx] */
+static double *vect(long n0, long nx)
+{
+   double *v;
+
+   v = (double *)malloc((size_t)(nx-n0+2)*sizeof(double));
+   if(!v)
+   {
+      fprintf(stderr,"refdiff: out of memory\n");
+      exit(1);
+   }
+   return v-n0+1;
+}
+
+static void freevect(double *v, long n0)
+{
+   free(v+n0-1);
+}
+
+static double stdev(double *x, long n)
+{
+   long j;
+   double add,mean,diff,total;
+
+   add = 0.0;
+   for(j=1;j<=n;j++)  add += x[j];
+   mean = add/n;
+
+   total = 0.0;
+   for(j=1;j<=n;j++)
+   {
+      diff = x[j] - mean;
+      total += diff*diff;
+   }
+
+   return (sqrt(total/(n-1)));
+}
+
+/*---------------------------------------------------------------------------*/
+/*      RANDOM NUMBER GENERATOR                                              */
+/*---------------------------------------------------------------------------*/
+
+#define IA 16807
+#define IM 2147483647
+#define AM (1.0/IM)
+#define IQ 127773
+#define IR 2836
+#define NTAB 32
+#define NDIV (1+(IM-1)/NTAB)
+#define EPS 1.2e-7
+#define RNMX (1.0-EPS)
+
+/* ran1 of src/ran1.c with its static shuffle table; ref_rrprocess() seeds it
+   with a negative idum, so each grid point starts a fresh sequence */
+static float ref_ran1(long *idum){
+	int j;
+	long k;
+	static long iy=0;
+	static long iv[NTAB];
+	float temp;
+
+	if (*idum <= 0 || !iy) {
+		if (-(*idum) < 1) *idum=1;
+		else *idum = -(*idum);
+		for (j=NTAB+7;j>=0;j--) {
+			k=(*idum)/IQ;
+			*idum=IA*(*idum-k*IQ)-IR*k;
+			if (*idum < 0) *idum += IM;
+			if (j < NTAB) iv[j] = *idum;
+		}
+		iy=iv[0];
+	}
+	k=(*idum)/IQ;
+	*idum=IA*(*idum-k*IQ)-IR*k;
+	if (*idum < 0) *idum += IM;
+	j=iy/NDIV;
+	iy=iv[j];
+	iv[j] = *idum;
+	if ((temp=AM*iy) > RNMX) return RNMX;
+	else return temp;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      FFT                                                                  */
+/*---------------------------------------------------------------------------*/
+
+void ref_dfour1(double data[], long nn, int isign)
+{
+   long n,mmax,m,j,istep,i;
+   double wtemp,wr,wpr,wpi,wi,theta;
+   double tempr,tempi;
+
+   n=nn << 1;
+   j=1;
+   for (i=1;i<n;i+=2) {
+      if (j > i) {
+         SWAP(data[j],data[i]);
+         SWAP(data[j+1],data[i+1]);
+      }
+      m=n>>1;
+      while (m >= 2 && j > m) {
+         j -= m;
+         m >>= 1;
+      }
+      j+=m;
+   }
+
+   mmax=2;
+   while (n > mmax) {
+      istep=mmax << 1;
+      theta=isign*(6.28318530717959/mmax);
+      wtemp=sin(0.5*theta);
+      wpr = -2.0*wtemp*wtemp;
+      wpi=sin(theta);
+      wr=1.0;
+      wi=0.0;
+      for (m=1;m<mmax;m+=2) {
+         for (i=m;i<=n;i+=istep) {
+            j=i+mmax;
+            tempr=wr*data[j]-wi*data[j+1];
+            tempi=wr*data[j+1]+wi*data[j];
+            data[j]=data[i]-tempr;
+            data[j+1]=data[i+1]-tempi;
+            data[i] += tempr;
+            data[i+1] += tempi;
+         }
+         wr=(wtemp=wr)*wpr-wi*wpi+wr;
+         wi=wi*wpr+wtemp*wpi+wi;
+      }
+      mmax=istep;
+   }
+}
+
+/*---------------------------------------------------------------------------*/
+/*      RR PROCESS                                                           */
+/*---------------------------------------------------------------------------*/
+
+void ref_rrprocess(refgen *r, double *rr, double flo, double fhi,
+                   double flostd, double fhistd, double lfhfratio,
+                   double hrmean, double hrstd, double sf, long n)
+{
+   long i;
+   double c1,c2,w1,w2,sig1,sig2,rrmean,rrstd,xstd,ratio;
+   double df,dw1,dw2,*w,*Hw,*Sw,*ph0,*ph,*SwC;
+
+   w = vect(1,n);
+   Hw = vect(1,n);
+   Sw = vect(1,n);
+   ph0 = vect(1,n/2-1);
+   ph = vect(1,n);
+   SwC = vect(1,2*n);
+
+   w1 = 2.0*PI*flo;
+   w2 = 2.0*PI*fhi;
+   c1 = 2.0*PI*flostd;
+   c2 = 2.0*PI*fhistd;
+   sig2 = 1.0;
+   sig1 = lfhfratio;
+   rrmean = 60.0/hrmean;
+   rrstd = 60.0*hrstd/(hrmean*hrmean);
+
+   df = sf/n;
+   for(i=1;i<=n;i++) w[i] = (i-1)*2.0*PI*df;
+   for(i=1;i<=n;i++)
+   {
+      dw1 = w[i]-w1;
+      dw2 = w[i]-w2;
+      Hw[i] = sig1*exp(-dw1*dw1/(2.0*c1*c1))/sqrt(2*PI*c1*c1)
+            + sig2*exp(-dw2*dw2/(2.0*c2*c2))/sqrt(2*PI*c2*c2);
+   }
+   for(i=1;i<=n/2;i++) Sw[i] = (sf/2.0)*sqrt(Hw[i]);
+   for(i=n/2+1;i<=n;i++) Sw[i] = (sf/2.0)*sqrt(Hw[n-i+1]);
+
+   /* randomise the phases */
+   for(i=1;i<=n/2-1;i++) ph0[i] = 2.0*PI*ref_ran1(&r->rseed);
+   ph[1] = 0.0;
+   for(i=1;i<=n/2-1;i++) ph[i+1] = ph0[i];
+   ph[n/2+1] = 0.0;
+   for(i=1;i<=n/2-1;i++) ph[n-i+1] = - ph0[i];
+
+   /* make complex spectrum */
+   for(i=1;i<=n;i++) SwC[2*i-1] = Sw[i]*cos(ph[i]);
+   for(i=1;i<=n;i++) SwC[2*i] = Sw[i]*sin(ph[i]);
+
+   /* calculate inverse fft */
+   ref_dfour1(SwC,n,-1);
+
+   /* extract real part */
+   for(i=1;i<=n;i++) rr[i] = (1.0/n)*SwC[2*i-1];
+
+   xstd = stdev(rr,n);
+   ratio = rrstd/xstd;
+
+   for(i=1;i<=n;i++) rr[i] *= ratio;
+   for(i=1;i<=n;i++) rr[i] += rrmean;
+
+   freevect(w,1); freevect(Hw,1); freevect(Sw,1);
+   freevect(ph0,1); freevect(ph,1); freevect(SwC,1);
+}
+
+//! @brief Expands r->rr into r->rrpc, the RR interval at every sample, and
+//! sets r->Nt. The samples past the end of the record (the last stage of
+//! the last step looks one ahead) keep the last interval.
+//!
+//! @return r->Nt
+long ref_rrpc(refgen *r)
+{
+   long i,j,k;
+   double tecg;
+
+   r->rrpc = vect(1,2*r->Nrr+1);
+   tecg = 0.0;
+   i = 1;
+   j = 1;
+   while(i <= r->Nrr)
+   {
+      tecg += r->rr[j];
+      j = lrint(tecg/r->h);
+      for(k=i;k<=j;k++) r->rrpc[k] = r->rr[i];
+      i = j+1;
+   }
+   r->Nt = j;
+   for(k=j+1;k<=2*r->Nrr+1;k++) r->rrpc[k] = r->rrpc[j];
+   return j;
+}
+
+//! @brief Frees the rrpc series of ref_rrpc() (rr belongs to the caller).
+void ref_free(refgen *r)
+{
+   if(r->rrpc) freevect(r->rrpc,1);
+   r->rrpc = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      MODEL AND INTEGRATOR                                                 */
+/*---------------------------------------------------------------------------*/
+
+static double angfreq(refgen *r, double t)
+{
+   long i;
+
+   i = 1 + (long)floor(t/r->h);
+   return 2.0*PI/r->rrpc[i];
+}
+
+void ref_derivspqrst(refgen *r, double t0, double x[], double dxdt[])
+{
+   int i,k;
+   double a0,w0,r0,x0,y0,z0;
+   double t,dt,dt2,zbase;
+
+   k = r->k;
+
+   w0 = angfreq(r,t0);
+   r0 = 1.0; x0 = 0.0;  y0 = 0.0;  z0 = 0.0;
+   a0 = 1.0 - sqrt((x[1]-x0)*(x[1]-x0) + (x[2]-y0)*(x[2]-y0))/r0;
+
+   zbase = 0.005*sin(2.0*PI*r->fhi*t0);
+
+   t = atan2(x[2],x[1]);
+   dxdt[1] = a0*(x[1] - x0) - w0*(x[2] - y0);
+   dxdt[2] = a0*(x[2] - y0) + w0*(x[1] - x0);
+   dxdt[3] = 0.0;
+   for(i=1;i<=k;i++)
+   {
+      dt = fmod(t-r->ti[i],2.0*PI);
+      dt2 = dt*dt;
+      dxdt[3] += -r->ai[i]*dt*exp(-0.5*dt2/(r->bi[i]*r->bi[i]));
+   }
+   dxdt[3] += -1.0*(x[3] - zbase);
+}
+
+void ref_drk4(refgen *r, double y[], int n, double x, double h, double yout[],
+              void (*derivs)(refgen *, double, double [], double []))
+{
+   int i;
+   double xh,hh,h6,dydx[REF_MAXN+1],dym[REF_MAXN+1],dyt[REF_MAXN+1];
+   double yt[REF_MAXN+1];
+
+   hh=h*0.5;
+   h6=h/6.0;
+   xh=x+hh;
+   (*derivs)(r,x,y,dydx);
+   for (i=1;i<=n;i++) yt[i]=y[i]+hh*dydx[i];
+   (*derivs)(r,xh,yt,dyt);
+   for (i=1;i<=n;i++) yt[i]=y[i]+hh*dyt[i];
+   (*derivs)(r,xh,yt,dym);
+   for (i=1;i<=n;i++) {
+      yt[i]=y[i]+h*dym[i];
+      dym[i] += dyt[i];
+   }
+   (*derivs)(r,x+h,yt,dyt);
+   for (i=1;i<=n;i++)
+      yout[i]=y[i]+h6*(dydx[i]+dyt[i]+2.0*dym[i]);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      PEAK LABELS                                                          */
+/*---------------------------------------------------------------------------*/
+
+void ref_detectpeaks(refgen *r, double *ipeak, double *x, double *y,
+                     double *z, long n)
+{
+   long i,j,j1,j2,jmin,jmax;
+   int d;
+   double thetap1,thetap2,thetap3,thetap4,thetap5;
+   double theta1,theta2,d1,d2,zmin,zmax;
+   
+   /* use globally defined angles for PQRST */
+   thetap1 = r->ti[1];
+   thetap2 = r->ti[2];
+   thetap3 = r->ti[3];
+   thetap4 = r->ti[4];
+   thetap5 = r->ti[5];
+
+   for(i=1;i<=n;i++) ipeak[i] = 0.0;
+   theta1 = atan2(y[1],x[1]);
+   for(i=1;i<n;i++)
+   {
+      theta2 = atan2(y[i+1],x[i+1]);
+      if( (theta1 <= thetap1) && (thetap1 <= theta2) )  
+      {
+	d1 = thetap1 - theta1;
+        d2 = theta2 - thetap1;
+        if(d1 < d2)  ipeak[i] = 1.0;
+        else         ipeak[i+1] = 1.0;
+      }
+      else if( (theta1 <= thetap2) && (thetap2 <= theta2) )  
+      {
+	d1 = thetap2 - theta1;
+        d2 = theta2 - thetap2;
+        if(d1 < d2)  ipeak[i] = 2.0;
+        else         ipeak[i+1] = 2.0;
+      }
+      else if( (theta1 <= thetap3) && (thetap3 <= theta2) )  
+      {
+	d1 = thetap3 - theta1;
+        d2 = theta2 - thetap3;
+        if(d1 < d2)  ipeak[i] = 3.0;
+        else         ipeak[i+1] = 3.0;
+      }
+      else if( (theta1 <= thetap4) && (thetap4 <= theta2) )  
+      {
+	d1 = thetap4 - theta1;
+        d2 = theta2 - thetap4;
+        if(d1 < d2)  ipeak[i] = 4.0;
+        else         ipeak[i+1] = 4.0;
+      }
+      else if( (theta1 <= thetap5) && (thetap5 <= theta2) )  
+      {
+	d1 = thetap5 - theta1;
+        d2 = theta2 - thetap5;
+        if(d1 < d2)  ipeak[i] = 5.0;
+        else         ipeak[i+1] = 5.0;
+      }
+      theta1 = theta2; 
+   }
+
+   /* correct the peaks */
+   d = (int)ceil(r->sfecg/64);
+   for(i=1;i<=n;i++)
+   { 
+     if( ipeak[i]==1 || ipeak[i]==3 || ipeak[i]==5 )
+     {
+        j1 = MAX(1,i-d);
+        j2 = MIN(n,i+d);
+        jmax = j1;
+        zmax = z[j1];
+        for(j=j1+1;j<=j2;j++)
+	{ 
+	   if(z[j] > zmax) 
+           {
+	      jmax = j;
+              zmax = z[j];
+	   }
+	}
+        if(jmax != i)
+	{
+           ipeak[jmax] = ipeak[i];
+           ipeak[i] = 0;
+	}
+     }
+     else if( ipeak[i]==2 || ipeak[i]==4 )
+     {
+        j1 = MAX(1,i-d);
+        j2 = MIN(n,i+d);
+        jmin = j1;
+        zmin = z[j1];
+        for(j=j1+1;j<=j2;j++)
+	{ 
+	   if(z[j] < zmin) 
+           {
+	      jmin = j;
+              zmin = z[j];
+	   }
+	}
+        if(jmin != i)
+	{
+           ipeak[jmin] = ipeak[i];
+           ipeak[i] = 0;
+	}
+     }
+   }
+}
@@ -0,0 +1,39 @@
+// "ref.h" - frozen reference copies of the numerical kernels.
+//
+// ref.c holds copies of ran1, dfour1, rrprocess, derivspqrst, drk4 and
+// detectpeaks as they stood before any of them was optimised, on a context
+// of their own and without calls into src/, so that changes there cannot
+// reach them. The reference walks the piecewise constant rrpc series of
+// the original ECGSYN instead of the RR cursor, and its detectpeaks knows
+// the five PQRST waves only. Do not change these copies: refdiff checks the
+// kernels in src/ against them.
+
+#ifndef _REF_H
+#define _REF_H
+
+typedef struct refgen {
+  int k;               // number of Gaussian kernels
+  const double *ti,*ai,*bi; // morphology ti[1..k] [rad], ai[1..k], bi[1..k]
+  double fhi;          // High frequency [Hz], of the baseline wander
+  int sfecg;           // ECG sampling frequency [Hz]
+  double h;            // internal time step 1/sf [s]
+  long rseed;          // seed of ran1
+  long Nrr;            // length of the RR process
+  double *rr;          // RR process rr[1..Nrr]
+  long Nt;             // number of internal samples in the record
+  double *rrpc;        // RR interval at every sample, rrpc[1..Nt+1]
+} refgen;
+
+void ref_dfour1(double data[], long nn, int isign);
+void ref_rrprocess(refgen *r, double *rr, double flo, double fhi,
+                   double flostd, double fhistd, double lfhfratio,
+                   double hrmean, double hrstd, double sf, long n);
+long ref_rrpc(refgen *r);
+void ref_derivspqrst(refgen *r, double t0, double x[], double dxdt[]);
+void ref_drk4(refgen *r, double y[], int n, double x, double h, double yout[],
+              void (*derivs)(refgen *, double, double [], double []));
+void ref_detectpeaks(refgen *r, double *ipeak, double *x, double *y,
+                     double *z, long n);
+void ref_free(refgen *r);
+
+#endif /* _REF_H */
@@ -0,0 +1,327 @@
+// "refdiff.c" - the kernels checked against their frozen reference.
+//
+// Runs the optimised kernels of src/ and the frozen copies of bench/ref.c
+// side by side and reports the first divergence:
+//
+//  - dfour1 on random data of 2^4..2^16 points, both directions;
+//  - for every point of a grid of heart rate (-h), its std (-H), sampling
+//    frequencies (-s, -S) and seeds: the RR series (gen_init against
+//    ref_rrprocess), the decimated trajectories of the specialised
+//    gen_step and of drk4 on derivspqrst against ref_drk4 on
+//    ref_derivspqrst, and the peak labels (detectpeaks on the gen_step
+//    trajectory against ref_detectpeaks on the reference one).
+//
+// Values match if they are within -u units in the last place, or for the
+// waveform within -e mV (z after the scaling to -0.4..1.2 mV of the
+// reference; x and y are on the unit circle and take -e as is). Labels
+// must match exactly. The exit status is 1 if anything diverges; -v also
+// reports the error of every FFT size.
+//
+//   refdiff [-n beats] [-u ulps] [-e mV] [-v]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "gen.h"
+#include "gen_tpl.h"
+#include "ref.h"
+
+static long nbeats = 16;        // beats per grid point
+static double maxulp = 4.0;     // tolerance [units in the last place]
+static double maxmv = 1e-6;     // tolerance of the waveform [mV]
+static int verbose = 0;         // report every FFT size
+
+/* distance of a and b in units in the last place */
+static double ulps(double a, double b)
+{
+   int64_t ia,ib;
+
+   if(a == b) return 0.0;
+   if(isnan(a) || isnan(b)) return INFINITY;
+   memcpy(&ia, &a, sizeof(ia));
+   memcpy(&ib, &b, sizeof(ib));
+   if(ia < 0) ia = INT64_MIN - ia;
+   if(ib < 0) ib = INT64_MIN - ib;
+   return fabs((double)ia - (double)ib);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      FFT                                                                  */
+/*---------------------------------------------------------------------------*/
+
+/* dfour1 against ref_dfour1; the error is in ulps of the largest output */
+static int checkfft(void)
+{
+   double *a,*b,m,d,ulp;
+   long n,i,rseed;
+   ran1state rng;
+   int k,isign,bad;
+
+   bad = 0;
+   rseed = -1;
+   memset(&rng,0,sizeof(rng));
+   for(k=4;k<=16;k++)
+   for(isign=-1;isign<=1;isign+=2)
+   {
+      n = 1L << k;
+      a = mallocVect(1,2*n);
+      b = mallocVect(1,2*n);
+      if(!a || !b) exit(1);
+      for(i=1;i<=2*n;i++) a[i] = b[i] = 2.0*ran1_r(&rseed,&rng) - 1.0;
+      dfour1(a,n,isign);
+      ref_dfour1(b,n,isign);
+      m = d = 0.0;
+      for(i=1;i<=2*n;i++) m = MAX(m,fabs(b[i]));
+      ulp = nextafter(m,INFINITY) - m;
+      for(i=1;i<=2*n;i++)
+      {
+         d = MAX(d,fabs(a[i]-b[i])/ulp);
+         if(fabs(a[i]-b[i]) > maxulp*ulp || isnan(a[i]))
+         {
+            printf("dfour1 2^%d isign %2d: diverges at data[%ld]: reference "
+                   "%.17g, optimised %.17g\n", k, isign, i, b[i], a[i]);
+            bad = 1;
+            break;
+         }
+      }
+      if(verbose && i > 2*n)
+        printf("dfour1 2^%d isign %2d: %g ulp\n", k, isign, d);
+      freeVect(a,1,2*n);
+      freeVect(b,1,2*n);
+      if(bad) return 1;
+   }
+   return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      ONE GRID POINT                                                       */
+/*---------------------------------------------------------------------------*/
+
+/* waveform sample j of component c: reference a, optimised b */
+static int wavediff(double a, double b, double scale, double *du, double *dmv)
+{
+   double u,mv;
+
+   u = ulps(a,b);
+   mv = scale*fabs(a-b);
+   if(u > *du) *du = u;
+   if(mv > *dmv) *dmv = mv;
+   return !(u <= maxulp || mv <= maxmv);
+}
+
+static int checkpoint(const genparams *p)
+{
+   gen g,gd;
+   refgen r;
+   long i,j,nts;
+   int c,o,q,bad;
+   double *rw[3],*ow[2][3],*rlab,*olab;
+   double x[4],t,zmin,zmax,scale,du[2],dmv[2],rru;
+   static const char *cname = "xyz";
+   static const char *oname[2] = { "gen_step", "drk4" };
+
+   printf("-h %g -H %g -s %d -S %d -R %d: ", p->hrmean, p->hrstd, p->sfecg,
+          p->sf, p->seed);
+   if(gen_init(&g, p) != 0 || gen_init(&gd, p) != 0)
+   {
+      printf("cannot initialise the generator\n");
+      return 1;
+   }
+   q = g.q;
+
+   /* the RR series */
+   memset(&r,0,sizeof(r));
+   r.k = g.k;
+   r.ti = g.ti;
+   r.ai = g.ai;
+   r.bi = g.bi;
+   r.fhi = p->fhi;
+   r.sfecg = p->sfecg;
+   r.h = 1.0/p->sf;
+   r.rseed = -p->seed;
+   r.Nrr = g.Nrr;
+   r.rr = mallocVect(1,r.Nrr);
+   if(!r.rr) exit(1);
+   ref_rrprocess(&r, r.rr, p->flo, p->fhi, p->flostd, p->fhistd,
+                 p->lfhfratio, p->hrmean, p->hrstd, p->sf, r.Nrr);
+   rru = 0.0;
+   bad = 0;
+   for(i=1;i<=r.Nrr;i++)
+   {
+      rru = MAX(rru,ulps(r.rr[i],g.rr[i]));
+      if(!(ulps(r.rr[i],g.rr[i]) <= maxulp))
+      {
+         printf("RR diverges at rr[%ld]: reference %.17g, optimised %.17g\n",
+                i, r.rr[i], g.rr[i]);
+         bad = 1;
+         break;
+      }
+   }
+   if(!bad && ref_rrpc(&r) != g.Nt)
+   {
+      printf("record length: reference %ld, optimised %ld samples\n",
+             r.Nt, g.Nt);
+      bad = 1;
+   }
+   if(bad)
+   {
+      ref_free(&r);
+      freeVect(r.rr,1,r.Nrr);
+      gen_free(&g);
+      gen_free(&gd);
+      return 1;
+   }
+
+   /* the decimated trajectories */
+   nts = (r.Nt-1)/q+1;
+   for(c=0;c<3;c++)
+   {
+      rw[c] = mallocVect(1,nts);
+      ow[0][c] = mallocVect(1,nts);
+      ow[1][c] = mallocVect(1,nts);
+      if(!rw[c] || !ow[0][c] || !ow[1][c]) exit(1);
+   }
+   rlab = mallocVect(1,nts); 
+   olab = mallocVect(1,nts);
+   if(!rlab || !olab) exit(1);
+   x[1] = 1.0;
+   x[2] = 0.0;
+   x[3] = 0.04;
+   t = 0.0;
+   for(i=1;i<=r.Nt;i++)
+   {
+      if((i-1)%q == 0)
+      {
+         j = (i-1)/q+1;
+         for(c=0;c<3;c++)
+         {
+            rw[c][j] = x[c+1];
+            ow[0][c][j] = g.x[c+1];
+            ow[1][c][j] = gd.x[c+1];
+         }
+      }
+      ref_drk4(&r, x, 3, t, r.h, x, ref_derivspqrst);
+      t += r.h;
+      gen_step(&g);
+      drk4(&gd, gd.x, 3, gd.timev, gd.h, gd.x, derivspqrst);
+      gd.timev += gd.h;
+   }
+   zmin = zmax = rw[2][1];
+   for(j=2;j<=nts;j++)
+   {
+      if(rw[2][j] < zmin) zmin = rw[2][j];
+      if(rw[2][j] > zmax) zmax = rw[2][j];
+   }
+
+   for(o=0;o<2 && !bad;o++)
+   {
+      du[o] = dmv[o] = 0.0;
+      for(j=1;j<=nts && !bad;j++)
+      for(c=0;c<3;c++)
+      {
+         scale = c == 2 ? 1.6/(zmax-zmin) : 1.0;
+         if(wavediff(rw[c][j], ow[o][c][j], scale, &du[o], &dmv[o]))
+         {
+            printf("waveform of %s diverges at %c of sample %ld (%.4f s): "
+                   "reference %.17g, optimised %.17g\n", oname[o], cname[c],
+                   j, (j-1)*q*r.h, rw[c][j], ow[o][c][j]);
+            bad = 1;
+            break;
+         }
+      }
+   }
+
+   /* the labels, exactly */
+   if(!bad)
+   {
+      ref_detectpeaks(&r, rlab, rw[0], rw[1], rw[2], nts);
+      detectpeaks(&g, olab, ow[0][0], ow[0][1], ow[0][2], nts);
+      for(j=1;j<=nts;j++)
+         if(rlab[j] != olab[j])
+         {
+            printf("labels diverge at sample %ld (%.4f s): reference %g, "
+                   "optimised %g\n", j, (j-1)*q*r.h, rlab[j], olab[j]);
+            bad = 1;
+            break;
+         }
+   }
+   if(!bad)
+     printf("same (RR %g ulp, gen_step %g ulp %.3g mV, drk4 %g ulp %.3g mV)\n",
+            rru, du[0], dmv[0], du[1], dmv[1]);
+
+   for(c=0;c<3;c++)
+   {
+      freeVect(rw[c],1,nts);
+      freeVect(ow[0][c],1,nts);
+      freeVect(ow[1][c],1,nts);
+   }
+   freeVect(rlab,1,nts); 
+   freeVect(olab,1,nts);
+   ref_free(&r);
+   freeVect(r.rr,1,r.Nrr);
+   gen_free(&g);
+   gen_free(&gd);
+   return bad;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      MAIN                                                                 */
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+   static const double hr[] = { 45.0, 60.0, 120.0 };
+   static const double hrstd[] = { 1.0, 5.0 };
+   static const int fs[][2] = { { 256, 256 }, { 250, 500 }, { 128, 512 } };
+   static const int seeds[] = { 1, 7, 1234 };
+   genparams p;
+   int k,a,b,c,d,npoint,nbad,fftbad;
+
+   for(k=1;k<argc;k++)
+   {
+      if(k+1 < argc && strcmp(argv[k],"-n") == 0)       nbeats = atol(argv[++k]);
+      else if(k+1 < argc && strcmp(argv[k],"-u") == 0)  maxulp = atof(argv[++k]);
+      else if(k+1 < argc && strcmp(argv[k],"-e") == 0)  maxmv = atof(argv[++k]);
+      else if(strcmp(argv[k],"-v") == 0)                verbose = 1;
+      else {
+        fprintf(stderr,"usage: refdiff [-n beats] [-u ulps] [-e mV] [-v]\n");
+        return 1;}
+   }
+   if(nbeats < 2 || maxulp < 0.0 || maxmv < 0.0) {
+     fprintf(stderr,"refdiff: bad parameters\n");
+     return 1;}
+
+   printf("refdiff: kernels against bench/ref.c, within %g ulp or %g mV\n",
+          maxulp, maxmv);
+   fftbad = checkfft();
+   if(!fftbad) printf("dfour1 2^4..2^16: same\n");
+
+   /* the defaults of ecgsyn but for the grid */
+   memset(&p,0,sizeof(p));
+   p.N = (int)nbeats;
+   p.flo = 0.1;
+   p.fhi = 0.25;
+   p.flostd = 0.01;
+   p.fhistd = 0.01;
+   p.lfhfratio = 0.5;
+   p.prec = GEN_DOUBLE;
+   p.integ = GEN_RK4;
+   npoint = nbad = 0;
+   for(a=0;a<3;a++)
+   for(b=0;b<2;b++)
+   for(c=0;c<3;c++)
+   for(d=0;d<3;d++)
+   {
+      p.hrmean = hr[a];
+      p.hrstd = hrstd[b];
+      p.sfecg = fs[c][0];
+      p.sf = fs[c][1];
+      p.seed = seeds[d];
+      npoint++;
+      nbad += checkpoint(&p);
+   }
+   printf("%d of %d grid points diverge\n", nbad, npoint);
+   return nbad > 0 || fftbad;
+}
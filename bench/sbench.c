@@ -0,0 +1,612 @@
+// "sbench.c" - microbenchmarks of every stage of the pipeline.
+//
+// Times the stages one at a time on synthetic data of the default record:
+// dfour1 at sizes 2^10..2^26, rrprocess, one drk4() step on derivspqrst()
+// and one specialised gen_step(), detectpeaks() over a record, the range
+// and gen_scale() pass (normalisation and noise), and sink_pack() and the
+// fused sink_packraw() of each output format.
+//
+// Every benchmark warms up, then finds a batch of operations that takes at
+// least the minimum time, and times a number of batches. The median time of
+// an operation is reported with the minimum, the mean and the coefficient
+// of variation over the batches, and as samples/s and bytes/s (bytes read
+// and written by the operation, nominal). The results also go to a JSON
+// file, one result per line, which a later run compares against with -c.
+//
+// With -p the timed batches also count cycles, instructions, cache misses
+// and branch misses of the process (user space) through perf_event_open(),
+// reported per operation with the instructions per cycle. A counter the
+// kernel or the container does not give is left out; without any, sbench
+// says so and only times.
+//
+//   sbench [-o file.json] [-c old.json] [-r reps] [-t seconds] [-m log2max]
+//          [-p]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "gen.h"
+#include "gen_tpl.h"
+#include "sink.h"
+
+#ifndef SBENCH_VERSION
+#define SBENCH_VERSION "unknown"
+#endif
+#ifndef SBENCH_CFLAGS
+#define SBENCH_CFLAGS ""
+#endif
+
+#define MAXREPS  101
+#define MAXRES   64
+#define BLOCK    1024     // samples per output block
+#define NCTR     4        // hardware counters
+
+static int reps = 11;           // timed batches per benchmark
+static double mintime = 0.02;   // shortest batch [s]
+static double budget = 2.0;     // longest benchmark, without warm-up [s]
+static int counters = 0;        // read the hardware counters (-p)
+static int ctrfd[NCTR] = { -1, -1, -1, -1 };  // counters, -1 if unavailable
+static const char *ctrname[NCTR] = 
+  { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+/* one line of the report */
+typedef struct result {
+  char name[32];
+  long size;           // problem size [samples]
+  int reps;            // batches timed
+  long batch;          // operations per batch
+  double med,min,mean,cv;  // time of an operation [ns], cv = std/mean
+  double samples;      // samples per operation
+  double bytes;        // bytes read and written per operation
+  double ctr[NCTR];    // counts per operation, < 0 if not counted
+} result;
+
+static result res[MAXRES];
+static int nres = 0;
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static int cmpd(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+
+   return x < y ? -1 : x > y;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      HARDWARE COUNTERS                                                    */
+/*---------------------------------------------------------------------------*/
+
+/* open the counters, each on its own so that one the PMU lacks does not
+   take the others with it; returns the number opened */
+static int ctr_open(void)
+{
+   int c,n,err;
+#ifdef __linux__
+   static const unsigned long long config[NCTR] = { PERF_COUNT_HW_CPU_CYCLES,
+     PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+     PERF_COUNT_HW_BRANCH_MISSES };
+   struct perf_event_attr pa;
+
+   n = err = 0;
+   for(c=0;c<NCTR;c++)
+   {
+      memset(&pa,0,sizeof(pa));
+      pa.type = PERF_TYPE_HARDWARE;
+      pa.size = sizeof(pa);
+      pa.config = config[c];
+      pa.disabled = 1;
+      pa.exclude_kernel = 1;
+      pa.exclude_hv = 1;
+      pa.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED 
+                     | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      ctrfd[c] = (int)syscall(SYS_perf_event_open, &pa, 0, -1, -1, 0);
+      if(ctrfd[c] >= 0) n++;
+      else              err = errno;
+   }
+#else
+   n = 0;
+   err = ENOSYS;
+#endif
+   if(n == 0) 
+     printf("hardware counters unavailable (%s), timing only\n",strerror(err));
+   else if(n < NCTR) 
+   {
+      printf("hardware counters:");
+      for(c=0;c<NCTR;c++) if(ctrfd[c] < 0) printf(" no %s",ctrname[c]);
+      printf(" (%s)\n",strerror(err));
+   }
+   return n;
+}
+
+static void ctr_start(void)
+{
+#ifdef __linux__
+   int c;
+
+   for(c=0;c<NCTR;c++)
+      if(ctrfd[c] >= 0)
+      {
+         ioctl(ctrfd[c], PERF_EVENT_IOC_RESET, 0);
+         ioctl(ctrfd[c], PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+}
+
+/* stop the counters; cnt[c] = count per operation of nop operations, 
+   scaled up if the kernel multiplexed the counter, or -1 */
+static void ctr_stop(double *cnt, double nop)
+{
+   int c;
+#ifdef __linux__
+   unsigned long long v[3];    // value, time enabled, time running
+
+   for(c=0;c<NCTR;c++) 
+      if(ctrfd[c] >= 0) ioctl(ctrfd[c], PERF_EVENT_IOC_DISABLE, 0);
+   for(c=0;c<NCTR;c++)
+   {
+      cnt[c] = -1.0;
+      if(ctrfd[c] < 0 || read(ctrfd[c], v, sizeof(v)) != sizeof(v) || v[2] == 0)
+        continue;
+      cnt[c] = (double)v[0]*((double)v[1]/v[2])/nop;
+   }
+#else
+   for(c=0;c<NCTR;c++) cnt[c] = -1.0;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/*      TIMING                                                               */
+/*---------------------------------------------------------------------------*/
+
+/* time op(arg), which does one operation on `samples` samples touching
+   `bytes` bytes, and add it to the report */
+static void measure(const char *name, long size, double samples, double bytes,
+                    void (*op)(void *), void *arg)
+{
+   double t[MAXREPS],t0,dt,sum,sq,cnt[NCTR];
+   long batch,i;
+   int r,n,c;
+   result *rs;
+
+   /* warm up for five batch times, at least one operation */
+   t0 = now();
+   op(arg);
+   dt = now()-t0;
+   while(now()-t0 < 5*mintime) op(arg);
+
+   /* batch of at least mintime (a slow operation on its own) */
+   batch = 1;
+   while(dt < mintime && batch < (1L<<40))
+   {
+      batch = dt > 0.0 ? MAX(2*batch, (long)(1.2*batch*mintime/dt)) : 2*batch;
+      t0 = now();
+      for(i=0;i<batch;i++) op(arg);
+      dt = now()-t0;
+   }
+
+   /* as many batches as the budget allows, at least three */
+   n = reps;
+   if(n*dt > budget) n = MAX(3, (int)(budget/dt));
+   if(counters) ctr_start();
+   for(r=0;r<n;r++)
+   {
+      t0 = now();
+      for(i=0;i<batch;i++) op(arg);
+      t[r] = 1e9*(now()-t0)/batch;
+   }
+   if(counters) ctr_stop(cnt, (double)n*batch);
+   else for(c=0;c<NCTR;c++) cnt[c] = -1.0;
+
+   rs = &res[nres < MAXRES-1 ? nres++ : nres];
+   snprintf(rs->name, sizeof(rs->name), "%s", name);
+   rs->size = size;
+   rs->reps = n;
+   rs->batch = batch;
+   rs->samples = samples;
+   rs->bytes = bytes;
+   for(c=0;c<NCTR;c++) rs->ctr[c] = cnt[c];
+   sum = sq = 0.0;
+   for(r=0;r<n;r++) sum += t[r];
+   rs->mean = sum/n;
+   for(r=0;r<n;r++) sq += (t[r]-rs->mean)*(t[r]-rs->mean);
+   rs->cv = n > 1 ? sqrt(sq/(n-1))/rs->mean : 0.0;
+   qsort(t, n, sizeof(double), cmpd);
+   rs->min = t[0];
+   rs->med = n % 2 ? t[n/2] : 0.5*(t[n/2-1]+t[n/2]);
+
+   printf("%-14s %9ld %14.1f %14.1f %6.2f%% %10.3g %10.3g", rs->name,
+          rs->size, rs->med, rs->min, 100.0*rs->cv,
+          1e9*rs->samples/rs->med, 1e9*rs->bytes/rs->med);
+   if(counters)
+   {
+      for(c=0;c<NCTR;c++)
+      {
+         if(rs->ctr[c] < 0.0) printf(" %10s","-");
+         else                 printf(" %10.4g",rs->ctr[c]);
+         if(c == 1)
+         {
+            if(rs->ctr[0] > 0.0 && rs->ctr[1] >= 0.0) 
+              printf(" %5.2f",rs->ctr[1]/rs->ctr[0]);
+            else printf(" %5s","-");
+         }
+      }
+   }
+   printf("\n");
+   fflush(stdout);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      STAGES                                                               */
+/*---------------------------------------------------------------------------*/
+
+/* dfour1 alternates forward and inverse transforms; the inverse is scaled
+   back by 1/n (exact, n is a power of two) so the data stay bounded */
+typedef struct fftarg {
+  double *data;
+  long n;
+  int isign;
+} fftarg;
+
+static void op_fft(void *arg)
+{
+   fftarg *a = (fftarg *)arg;
+   long i;
+
+   dfour1(a->data, a->n, a->isign);
+   if(a->isign < 0)
+     for(i=1;i<=2*a->n;i++) a->data[i] *= 1.0/a->n;
+   a->isign = -a->isign;
+}
+
+typedef struct rrarg {
+  gen *g;
+  double *rr;
+  long n;
+} rrarg;
+
+static void op_rr(void *arg)
+{
+   rrarg *a = (rrarg *)arg;
+   const genparams *p = &a->g->p;
+
+   rrprocess(a->g, a->rr, p->flo, p->fhi, p->flostd, p->fhistd, p->lfhfratio,
+             p->hrmean, p->hrstd, p->sf, a->n);
+}
+
+static void op_drk4(void *arg)
+{
+   gen *g = (gen *)arg;
+
+   drk4(g, g->x, 3, g->timev, g->h, g->x, derivspqrst);
+   g->timev += g->h;
+   g->it++;
+}
+
+static void op_step(void *arg)
+{
+   gen_step((gen *)arg);
+}
+
+typedef struct recarg {
+  gen *g;
+  double *x,*y,*z,*ipeak;  // record [1..n]
+  double *noise;           // noise of one block [0..BLOCK-1]
+  char *buf;               // packed block
+  long n;
+  int fmt;
+  double zr;               // range found by op_scale()
+} recarg;
+
+static void op_peaks(void *arg)
+{
+   recarg *a = (recarg *)arg;
+
+   detectpeaks(a->g, a->ipeak, a->x, a->y, a->z, a->n);
+}
+
+/* range of the record and gen_scale() of it; zmin 0, zrange 1.6 make the
+   pass a shift by -0.4 plus noise, so repeated passes stay bounded */
+static void op_scale(void *arg)
+{
+   recarg *a = (recarg *)arg;
+   double zmin,zmax;
+   long i;
+
+   zmin = zmax = a->z[1];
+   for(i=2;i<=a->n;i++)
+   {
+      if(a->z[i] < zmin)       zmin = a->z[i];
+      else if(a->z[i] > zmax)  zmax = a->z[i];
+   }
+   a->zr = zmax-zmin;
+   a->g->zmin = 0.0;
+   a->g->zrange = 1.6;
+   gen_scale(a->g, a->z+1, (int)a->n);
+}
+
+static void op_pack(void *arg)
+{
+   recarg *a = (recarg *)arg;
+
+   sink_pack(a->fmt, 1.0/256, 0, a->z+1, a->ipeak+1, BLOCK, a->buf);
+}
+
+static void op_packraw(void *arg)
+{
+   recarg *a = (recarg *)arg;
+
+   sink_packraw(a->fmt, 1.0/256, 0, a->z+1, a->noise, a->ipeak+1, BLOCK,
+                -0.1, 0.2, a->buf);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      RESULT FILES                                                         */
+/*---------------------------------------------------------------------------*/
+
+static void cpumodel(char *model, int size)
+{
+   FILE *fp;
+   char line[256],*c;
+
+   snprintf(model, size, "unknown");
+   fp = fopen("/proc/cpuinfo","r");
+   if(!fp) return;
+   while(fgets(line, sizeof(line), fp))
+     if(strncmp(line,"model name",10) == 0 && (c = strchr(line,':')))
+     {
+        c += strspn(c+1," ")+1;
+        c[strcspn(c,"\n\"\\")] = '\0';
+        snprintf(model, size, "%s", c);
+        break;
+     }
+   fclose(fp);
+}
+
+static int writejson(const char *filename)
+{
+   FILE *fp;
+   char model[128],date[32];
+   time_t t;
+   int i,c;
+   result *r;
+
+   fp = fopen(filename,"w");
+   if(!fp) return -1;
+   cpumodel(model, sizeof(model));
+   t = time(NULL);
+   strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+   fprintf(fp,"{\"suite\": \"ecgsyn-sbench\", \"format\": 1,\n");
+   fprintf(fp," \"version\": \"%s\", \"date\": \"%s\",\n",SBENCH_VERSION,date);
+   fprintf(fp," \"cpu\": \"%s\", \"compiler\": \"%s\", \"cflags\": \"%s\",\n",
+           model,__VERSION__,SBENCH_CFLAGS);
+   fprintf(fp," \"reps\": %d, \"mintime\": %g, \"budget\": %g, "
+           "\"counters\": [", reps,mintime,budget);
+   for(i=0,c=0;c<NCTR;c++)
+      if(counters && ctrfd[c] >= 0) 
+        fprintf(fp,"%s\"%s\"", i++ ? ", " : "", ctrname[c]);
+   fprintf(fp,"],\n");
+   fprintf(fp," \"results\": [\n");
+   for(i=0;i<nres;i++)
+   {
+      r = &res[i];
+      fprintf(fp,"  {\"name\": \"%s\", \"size\": %ld, \"ns_per_op\": %.6g, "
+              "\"ns_min\": %.6g, \"ns_mean\": %.6g, \"cv\": %.4g, "
+              "\"reps\": %d, \"batch\": %ld, \"samples_per_s\": %.6g, "
+              "\"bytes_per_s\": %.6g", r->name, r->size, r->med, r->min,
+              r->mean, r->cv, r->reps, r->batch, 1e9*r->samples/r->med,
+              1e9*r->bytes/r->med);
+      for(c=0;c<NCTR;c++)
+         if(r->ctr[c] >= 0.0) 
+           fprintf(fp,", \"%s_per_op\": %.6g", ctrname[c], r->ctr[c]);
+      fprintf(fp,"}%s\n", i+1 < nres ? "," : "");
+   }
+   fprintf(fp," ]\n}\n");
+   return fclose(fp) != 0 ? -1 : 0;
+}
+
+/* compare with the results in an older file (as written above: a result per
+   line); a stage is slower if its median exceeds the old one by more than
+   5% plus three times the combined variation. Returns the number of slower
+   stages, or -1 if the file cannot be read. */
+static int compare(const char *filename)
+{
+   FILE *fp;
+   char line[512],name[32];
+   long size;
+   double med,cv,ratio,tol;
+   int i,nslow,nmatch;
+
+   fp = fopen(filename,"r");
+   if(!fp) return -1;
+   printf("\ncompared with %s\n",filename);
+   printf("stage               size       old [ns]       new [ns]  new/old\n");
+   nslow = nmatch = 0;
+   while(fgets(line, sizeof(line), fp))
+   {
+      if(sscanf(line," {\"name\": \"%31[^\"]\", \"size\": %ld, \"ns_per_op\": "
+                "%lf, %*[^,], %*[^,], \"cv\": %lf", name, &size, &med, &cv) != 4)
+        continue;
+      for(i=0;i<nres;i++)
+        if(strcmp(res[i].name,name) == 0 && res[i].size == size) break;
+      if(i == nres) continue;
+      nmatch++;
+      ratio = res[i].med/med;
+      tol = 0.05 + 3.0*sqrt(cv*cv + res[i].cv*res[i].cv);
+      printf("%-14s %9ld %14.1f %14.1f %8.3f%s\n", name, size, med,
+             res[i].med, ratio, ratio > 1.0+tol ? "  SLOWER" :
+             ratio < 1.0/(1.0+tol) ? "  faster" : "");
+      if(ratio > 1.0+tol) nslow++;
+   }
+   fclose(fp);
+   printf("%d stages compared, %d slower\n",nmatch,nslow);
+   return nslow;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      MAIN                                                                 */
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+   const char *outname,*oldname;
+   static const char *fmtname[] = { "txt", "f32", "i16" };
+   char name[32];
+   genparams p;
+   gen g,gs;
+   fftarg fa;
+   rrarg ra;
+   recarg rc;
+   long n,i,j,nt;
+   int k,maxlog2,fmt,nslow;
+
+   outname = "sbench.json";
+   oldname = NULL;
+   maxlog2 = 26;
+   for(k=1;k<argc;k++)
+   {
+      if(k+1 < argc && strcmp(argv[k],"-o") == 0)       outname = argv[++k];
+      else if(k+1 < argc && strcmp(argv[k],"-c") == 0)  oldname = argv[++k];
+      else if(k+1 < argc && strcmp(argv[k],"-r") == 0)  reps = atoi(argv[++k]);
+      else if(k+1 < argc && strcmp(argv[k],"-t") == 0)  budget = atof(argv[++k]);
+      else if(k+1 < argc && strcmp(argv[k],"-m") == 0)  maxlog2 = atoi(argv[++k]);
+      else if(strcmp(argv[k],"-p") == 0)                counters = 1;
+      else {
+        fprintf(stderr,"usage: sbench [-o file.json] [-c old.json] [-r reps] "
+                "[-t seconds] [-m log2max] [-p]\n");
+        return 1;}
+   }
+   if(reps < 1 || reps > MAXREPS || budget <= 0.0 || maxlog2 < 10
+      || maxlog2 > GEN_MAXLOG2NRR) {
+     fprintf(stderr,"sbench: bad parameters\n");
+     return 1;}
+
+   /* the default record of ecgsyn */
+   memset(&p,0,sizeof(p));
+   p.N = 256;
+   p.sfecg = 256;
+   p.sf = 256;
+   p.hrmean = 60.0;
+   p.hrstd = 1.0;
+   p.flo = 0.1;
+   p.fhi = 0.25;
+   p.flostd = 0.01;
+   p.fhistd = 0.01;
+   p.lfhfratio = 0.5;
+   p.seed = 1;
+   p.Anoise = 0.0;
+   p.prec = GEN_DOUBLE;
+   if(gen_check(&p) != NULL || gen_init(&g,&p) != 0) {
+     fprintf(stderr,"sbench: cannot initialise the generator\n");
+     return 1;}
+
+   printf("sbench %s, %d batches of at least %g s, at most %g s per stage\n",
+          SBENCH_VERSION,reps,mintime,budget);
+   if(counters && ctr_open() == 0) counters = 0;
+   printf("stage               size    median [ns]       min [ns]     cv  "
+          "samples/s    bytes/s%s\n", counters ? "     cycles     instrs   IPC"
+          "  cachemiss     brmiss" : "");
+
+   /* dfour1: 2n doubles read and written per pass, log2 n passes */
+   for(k=10;k<=maxlog2;k++)
+   {
+      n = 1L << k;
+      fa.data = mallocVect(1,2*n);
+      if(!fa.data) {
+        fprintf(stderr,"sbench: out of memory at 2^%d\n",k);
+        break;}
+      for(i=1;i<=2*n;i++) fa.data[i] = sin(0.001*i) + 0.5*cos(0.37*i);
+      fa.n = n;
+      fa.isign = 1;
+      measure("dfour1", n, n, 32.0*n*k, op_fft, &fa);
+      freeVect(fa.data,1,2*n);
+   }
+
+   /* rrprocess: the spectrum, the FFT and the scaling of n samples; its
+      scratch space comes from the arena of g */
+   for(k=12;k<=MIN(20,maxlog2);k+=4)
+   {
+      ra.g = &g;
+      ra.n = 1L << k;
+      ra.rr = mallocVect(1,ra.n);
+      measure("rrprocess", ra.n, ra.n, 8.0*ra.n*(2*k+12), op_rr, &ra);
+      freeVect(ra.rr,1,ra.n);
+   }
+
+   /* one integration step: the state vector only */
+   gs = g;
+   measure("drk4", 1, 1, 48.0, op_drk4, &gs);
+   gs = g;
+   measure("gen_step", 1, 1, 48.0, op_step, &gs);
+
+   /* the record at sfecg for the remaining stages */
+   nt = g.Nt;
+   rc.g = &g;
+   rc.n = nt;
+   rc.x = mallocVect(1,nt);
+   rc.y = mallocVect(1,nt);
+   rc.z = mallocVect(1,nt);
+   rc.ipeak = mallocVect(1,nt);
+   rc.noise = (double *)calloc(BLOCK, sizeof(double));
+   rc.buf = (char *)malloc((size_t)BLOCK*SINK_MAXREC);
+   gs = g;
+   for(i=1;i<=nt;i++)
+   {
+      rc.x[i] = gs.x[1];
+      rc.y[i] = gs.x[2];
+      rc.z[i] = gs.x[3];
+      gen_step(&gs);
+   }
+   measure("detectpeaks", nt, nt, 40.0*nt, op_peaks, &rc);
+
+   /* range, scaling and noise: z read twice, written once */
+   measure("scale", nt, nt, 24.0*nt, op_scale, &rc);
+
+   /* a block of output: z and labels in (and noise, fused), the packed 
+      block out */
+   for(i=1;i<=nt;i++) rc.z[i] = 0.01*sin(0.05*i);
+   for(j=0;j<BLOCK;j++) rc.noise[j] = 0.01*(2.0*ran1_r(&g.rseed,&g.rng) - 1.0);
+   for(fmt=SINK_TXT;fmt<=SINK_I16;fmt++)
+   {
+      rc.fmt = fmt;
+      n = sink_pack(fmt, 1.0/256, 0, rc.z+1, rc.ipeak+1, BLOCK, rc.buf);
+      snprintf(name, sizeof(name), "pack_%s", fmtname[fmt]);
+      measure(name, BLOCK, BLOCK, 16.0*BLOCK+n, op_pack, &rc);
+      snprintf(name, sizeof(name), "packraw_%s", fmtname[fmt]);
+      measure(name, BLOCK, BLOCK, 24.0*BLOCK+n, op_packraw, &rc);
+   }
+
+   freeVect(rc.x,1,nt); freeVect(rc.y,1,nt); freeVect(rc.z,1,nt);
+   freeVect(rc.ipeak,1,nt);
+   free(rc.noise); free(rc.buf);
+   gen_free(&g);
+
+   if(writejson(outname) != 0) {
+     fprintf(stderr,"sbench: cannot write %s\n",outname);
+     return 1;}
+   printf("results written to %s\n",outname);
+   if(oldname)
+   {
+      nslow = compare(oldname);
+      if(nslow < 0) {
+        fprintf(stderr,"sbench: cannot read %s\n",oldname);
+        return 1;}
+      if(nslow > 0) return 2;
+   }
+   return 0;
+}
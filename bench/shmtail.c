@@ -0,0 +1,192 @@
+// "shmtail.c" - a consumer of the shared-memory ring of ecgsyn -M.
+//
+// Attaches to the ring, follows the producer until it closes the record and
+// accounts for every sample: each one is either read or lost because the
+// producer lapped the consumer. -d sleeps between reads, so that a small
+// ring (-Q) is overtaken; -i reads the slots in place (shmring_at() and
+// shmring_check()) instead of copying them out with shmring_read(); -c
+// compares the samples read with the f32 output (-o f32) of the same run;
+// -u removes a ring left by an earlier run before waiting for the producer.
+// The exit status is 1 if the samples do not add up or differ.
+//
+//   shmtail [-d usec] [-i] [-u] [-c file.f32] name
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shmring.h"
+
+#define BLOCK 256            // samples per read
+
+static long delay = 0;       // sleep between reads [us]
+static int inplace = 0;      // read the slots in place
+
+/* the samples read, in the order read */
+static uint64_t *rseq;
+static float *rz;
+static int32_t *rlab;
+static long nread,nalloc;
+
+static void keep(uint64_t seq, const float *z, const int32_t *lab, long n)
+{
+   long i;
+
+   if(nread+n > nalloc)
+   {
+      nalloc = 2*(nread+n);
+      rseq = (uint64_t *)realloc(rseq, nalloc*sizeof(uint64_t));
+      rz = (float *)realloc(rz, nalloc*sizeof(float));
+      rlab = (int32_t *)realloc(rlab, nalloc*sizeof(int32_t));
+      if(!rseq || !rz || !rlab)
+      {
+         fprintf(stderr,"shmtail: out of memory\n");
+         exit(1);
+      }
+   }
+   for(i=0;i<n;i++)
+   {
+      rseq[nread] = seq+i;
+      rz[nread] = z[i];
+      rlab[nread] = lab[i];
+      nread++;
+   }
+}
+
+/* shmring_read() done with shmring_at() and shmring_check() */
+static long readinplace(shmring *r, uint64_t *pos, float *z, int32_t *lab,
+                        long n)
+{
+   const shmring_slot *sl;
+   uint64_t head;
+   long i;
+
+   head = shmring_head(r);
+   if(head - *pos > r->mask+1)
+   {
+      *pos = head - (r->mask+1);
+      return -1;
+   }
+   if((uint64_t)n > head - *pos) n = (long)(head - *pos);
+   for(i=0;i<n;i++)
+   {
+      sl = shmring_at(r, *pos+i);
+      z[i] = sl->z;
+      lab[i] = sl->label;
+      if(!shmring_check(r, *pos+i))
+      {
+         *pos = shmring_head(r) - (r->mask+1);
+         return -1;
+      }
+   }
+   *pos += n;
+   return n;
+}
+
+/* the samples read against the records of the f32 output file */
+static int compare(const char *filename)
+{
+   FILE *fp;
+   float z;
+   int32_t lab;
+   long i;
+
+   fp = fopen(filename,"rb");
+   if(!fp)
+   {
+      fprintf(stderr,"shmtail: cannot open %s\n",filename);
+      return 1;
+   }
+   for(i=0;i<nread;i++)
+   {
+      if(fseek(fp, (long)rseq[i]*8, SEEK_SET) != 0
+         || fread(&z,4,1,fp) != 1 || fread(&lab,4,1,fp) != 1)
+      {
+         printf("sample %llu is not in %s\n", (unsigned long long)rseq[i],
+                filename);
+         fclose(fp);
+         return 1;
+      }
+      if(memcmp(&z,&rz[i],4) != 0 || lab != rlab[i])
+      {
+         printf("sample %llu differs: ring %.9g %d, %s %.9g %d\n",
+                (unsigned long long)rseq[i], rz[i], (int)rlab[i], filename,
+                z, (int)lab);
+         fclose(fp);
+         return 1;
+      }
+   }
+   fclose(fp);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   shmring r;
+   uint64_t pos,old,head;
+   float z[BLOCK];
+   int32_t lab[BLOCK];
+   const char *name,*file;
+   long m,lost,laps;
+   int k,fresh,closed,tries,bad;
+
+   file = NULL;
+   fresh = 0;
+   for(k=1;k<argc-1;k++)
+   {
+      if(k+1 < argc-1 && strcmp(argv[k],"-d") == 0)      delay = atol(argv[++k]);
+      else if(k+1 < argc-1 && strcmp(argv[k],"-c") == 0) file = argv[++k];
+      else if(strcmp(argv[k],"-i") == 0)                 inplace = 1;
+      else if(strcmp(argv[k],"-u") == 0)                 fresh = 1;
+      else break;
+   }
+   if(k != argc-1 || delay < 0) {
+     fprintf(stderr,"usage: shmtail [-d usec] [-i] [-u] [-c file.f32] name\n");
+     return 1;}
+   name = argv[k];
+
+   if(fresh) shm_unlink(name);
+   for(tries=0;shmring_attach(&r, name) != 0;tries++)
+   {
+      if(tries == 1000)
+      {
+         fprintf(stderr,"shmtail: no ring %s\n",name);
+         return 1;
+      }
+      usleep(10000);
+   }
+
+   pos = 0;
+   lost = laps = 0;
+   for(;;)
+   {
+      /* closed before the read: a closed ring with nothing left is done */
+      closed = shmring_closed(&r);
+      old = pos;
+      if(inplace) m = readinplace(&r, &pos, z, lab, BLOCK);
+      else        m = shmring_read(&r, &pos, z, lab, BLOCK);
+      if(m < 0)
+      {
+         laps++;
+         lost += (long)(pos-old);
+         continue;
+      }
+      keep(old, z, lab, m);
+      if(m == 0 && closed) break;
+      usleep(m == 0 && delay == 0 ? 100 : delay);
+   }
+   head = shmring_head(&r);
+
+   printf("%s: %llu samples published, %ld read, %ld lost in %ld laps "
+          "(%llu slots, %s)\n", name, (unsigned long long)head, nread, lost,
+          laps, (unsigned long long)r.mask+1, inplace ? "in place" : "copied");
+   bad = (uint64_t)(nread+lost) != head;
+   if(bad) printf("%s: read and lost samples do not add up\n", name);
+   if(!bad && file) bad = compare(file);
+   shmring_detach(&r);
+   return bad;
+}
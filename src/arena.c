@@ -0,0 +1,217 @@
+// "arena.c" - memory arena of one record.
+//
+// A bump allocator over anonymous mappings. When the current mapping is
+// full, the next one that fits is used, or a new one is mapped, at least as
+// large as all the others together; arena_reset() merges them into a single
+// mapping of the high-water mark.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+/*---------------------------------------------------------------------------*/
+/*      MAP AND UNMAP                                                        */
+/*---------------------------------------------------------------------------*/
+
+/* map *size bytes (rounded up), huge-page aligned from ARENA_HUGE on */
+static char *arena_map(size_t *size)
+{
+   size_t page,n;
+   char *p,*q;
+
+   page = (size_t)sysconf(_SC_PAGESIZE);
+   if(*size > SIZE_MAX - 2*ARENA_HUGE) return NULL;
+   if(*size < ARENA_HUGE)
+   {
+      n = (*size + page-1)/page*page;
+      if(n == 0) n = page;
+      p = (char *)mmap(NULL, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+                       -1, 0);
+      if(p == MAP_FAILED) return NULL;
+      *size = n;
+      return p;
+   }
+
+   /* over-map by one huge page and trim to a 2 MB aligned range */
+   n = (*size + ARENA_HUGE-1)/ARENA_HUGE*ARENA_HUGE;
+   p = (char *)mmap(NULL, n+ARENA_HUGE, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   if(p == MAP_FAILED) return NULL;
+   q = (char *)(((uintptr_t)p + ARENA_HUGE-1) & ~(uintptr_t)(ARENA_HUGE-1));
+   if(q > p) munmap(p, q-p);
+   if(q+n < p+n+ARENA_HUGE) munmap(q+n, p+n+ARENA_HUGE-(q+n));
+#ifdef MADV_HUGEPAGE
+   madvise(q, n, MADV_HUGEPAGE);
+#endif
+   *size = n;
+   return q;
+}
+
+static void arena_unmap(arena *a)
+{
+   int i;
+
+   for(i=0;i<a->nchunk;i++) munmap(a->chunk[i], a->size[i]);
+   a->nchunk = 0;
+   a->cur = 0;
+   a->used = 0;
+   a->inuse = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      SET UP                                                               */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Sets up an arena with a first mapping of size bytes (none if 0).
+//!
+//! @return non-zero if the mapping fails
+int arena_init(arena *a, size_t size)
+{
+   memset(a,0,sizeof(*a));
+   if(size == 0) return 0;
+   a->chunk[0] = arena_map(&size);
+   if(!a->chunk[0]) return -1;
+   a->size[0] = size;
+   a->nchunk = 1;
+   return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      ALLOCATE                                                             */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Hands out a 64-byte aligned region of the given size.
+//!
+//! @return the region, or NULL if memory runs out
+void *arena_alloc(arena *a, size_t bytes)
+{
+   size_t size,total;
+   char *p;
+   int i;
+
+   if(bytes > SIZE_MAX - ARENA_ALIGN) return NULL;
+   bytes = (bytes + ARENA_ALIGN-1)/ARENA_ALIGN*ARENA_ALIGN;
+   if(a->nchunk > 0 && a->used + bytes <= a->size[a->cur])
+   {
+      p = a->chunk[a->cur] + a->used;
+      a->used += bytes;
+   }
+   else
+   {
+      /* the next mapping that is large enough, or a new one */
+      for(i = a->nchunk > 0 ? a->cur+1 : 0;i<a->nchunk;i++)
+        if(a->size[i] >= bytes) break;
+      if(i == a->nchunk)
+      {
+         if(a->nchunk == ARENA_MAXCHUNK) return NULL;
+         total = 0;
+         for(i=0;i<a->nchunk;i++) total += a->size[i];
+         size = bytes > total ? bytes : total;
+         p = arena_map(&size);
+         if(!p) return NULL;
+         i = a->nchunk++;
+         a->chunk[i] = p;
+         a->size[i] = size;
+      }
+      a->cur = i;
+      p = a->chunk[i];
+      a->used = bytes;
+   }
+   a->inuse += bytes;
+   if(a->inuse > a->peak) a->peak = a->inuse;
+   return p;
+}
+
+//! @brief Hands out an array of n elements of the given size; the product is
+//! checked, so a size computed from a huge record fails instead of wrapping.
+//!
+//! @return the array, or NULL if n is negative, n*size overflows or memory
+//! runs out
+void *arena_array(arena *a, long n, size_t size)
+{
+   if(n < 0 || (size > 0 && (size_t)n > SIZE_MAX/size)) return NULL;
+   return arena_alloc(a, (size_t)n*size);
+}
+
+//! @brief Hands out a vector v[n0..nx] of doubles, like mallocVect(), with
+//! v[n0] 64-byte aligned.
+//!
+//! @return the vector, or NULL if memory runs out
+double *arena_vect(arena *a, long n0, long nx)
+{
+   double *v;
+
+   if(nx < n0-1) return NULL;
+   v = (double *)arena_array(a, nx-n0+1, sizeof(double));
+   if(!v) return NULL;
+   return v-n0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      RELEASE                                                              */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Returns the current position, to release scratch space back to.
+arenamark arena_mark(const arena *a)
+{
+   arenamark m;
+
+   m.cur = a->cur;
+   m.used = a->used;
+   m.inuse = a->inuse;
+   return m;
+}
+
+//! @brief Releases every region handed out since the mark was taken.
+void arena_release(arena *a, arenamark m)
+{
+   a->cur = m.cur;
+   a->used = m.used;
+   a->inuse = m.inuse;
+}
+
+//! @brief Returns the bytes mapped by the arena.
+size_t arena_size(const arena *a)
+{
+   size_t total;
+   int i;
+
+   total = 0;
+   for(i=0;i<a->nchunk;i++) total += a->size[i];
+   return total;
+}
+
+//! @brief Releases every region for the next record, keeping the memory: a
+//! single mapping is rewound, several are replaced by one of the high-water
+//! mark.
+//!
+//! @return non-zero if the new mapping fails (the arena is then empty)
+int arena_reset(arena *a)
+{
+   size_t size;
+
+   if(a->nchunk <= 1)
+   {
+      a->cur = 0;
+      a->used = 0;
+      a->inuse = 0;
+      return 0;
+   }
+   arena_unmap(a);
+   size = a->peak;
+   a->chunk[0] = arena_map(&size);
+   if(!a->chunk[0]) return -1;
+   a->size[0] = size;
+   a->nchunk = 1;
+   return 0;
+}
+
+//! @brief Unmaps all memory of the arena.
+void arena_free(arena *a)
+{
+   arena_unmap(a);
+   memset(a,0,sizeof(*a));
+}
@@ -0,0 +1,48 @@
+// "arena.h" - memory arena of one record.
+//
+// The buffers of a record (RR process, FFT scratch space, trajectories,
+// morphology) are carved out of a few large anonymous mappings instead of
+// coming from malloc one by one. Every region is 64-byte aligned; mappings
+// of 2 MB and more are aligned to 2 MB and offered to the kernel for
+// transparent huge pages. Regions are never freed one at a time: scratch
+// space is released in stack order back to a mark, and arena_reset()
+// rewinds the whole arena for the next record while keeping its memory, so
+// a run of records settles into one mapping and allocates nothing more.
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN    64          // alignment of every region [bytes]
+#define ARENA_HUGE     (2L<<20)    // huge page size, mapping granularity
+#define ARENA_MAXCHUNK 32          // mappings per arena
+
+typedef struct arena {
+  char *chunk[ARENA_MAXCHUNK];     // mappings
+  size_t size[ARENA_MAXCHUNK];     // size of each mapping [bytes]
+  int nchunk;                      // number of mappings
+  int cur;                         // mapping that regions come from
+  size_t used;                     // bytes of chunk[cur] handed out
+  size_t inuse;                    // bytes handed out over all mappings
+  size_t peak;                     // most bytes ever handed out at once
+} arena;
+
+// Position to release scratch space back to.
+typedef struct arenamark {
+  int cur;
+  size_t used;
+  size_t inuse;
+} arenamark;
+
+int    arena_init(arena *a, size_t size);
+void  *arena_alloc(arena *a, size_t bytes);
+void  *arena_array(arena *a, long n, size_t size);
+double *arena_vect(arena *a, long n0, long nx);
+arenamark arena_mark(const arena *a);
+void   arena_release(arena *a, arenamark m);
+size_t arena_size(const arena *a);
+int    arena_reset(arena *a);
+void   arena_free(arena *a);
+
+#endif /* _ARENA_H */
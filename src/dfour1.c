@@ -5,6 +5,7 @@
 // C routines in Numerical Recipes Second Edition, by chapter and section.
 
 #include <math.h>   // sin
+#include "gen.h"    // prototype
 
 #define SWAP(a,b) tempr=a;a=b;b=tempr
 
@@ -12,11 +13,12 @@
 //! is 1, or it inverse Fourier transform if `isign` is -1.
 //!
 //! @param data     array of complex numbers (1st element real, 2nd imaginary)
-//! @param nn       number of complex elements in data array
+//! @param nn       number of complex elements in data array (a power of two;
+//!                 indices are long, so 2*nn must fit into a long)
 //! @param isign    forward transform if 1, inverse transform if -1
-void dfour1(double data[], int nn, int isign){
+void dfour1(double data[], long nn, int isign){
 
-  int n,mmax,m,j,istep,i;
+  long n,mmax,m,j,istep,i;
   double wtemp,wr,wpr,wpi,wi,theta;
   double tempr,tempi;
 
@@ -25,30 +25,36 @@
 #include <stdio.h>   
 #include <math.h>  
 #include <stdlib.h> 
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include "opt.h"
-#define PI (2.0*asin(1.0))
-#define SWAP(a,b) tempr=(a);(a)=(b);(b)=tempr
-#define MIN(a,b) (a < b ? a : b)
-#define MAX(a,b) (a > b ? a : b)
-#define PI (2.0*asin(1.0))
-#define OFFSET 1
-#define ARG1 char*
-
-#define IA 16807
-#define IM 2147483647
-#define AM (1.0/IM)
-#define IQ 127773
-#define IR 2836
-#define NTAB 32
-#define NDIV (1+(IM-1)/NTAB)
-#define EPS 1.2e-7
-#define RNMX (1.0-EPS)
+#include "gen.h"
+#include "sink.h"
+#include "rtpace.h"
+#include "server.h"
+#include "shmring.h"
+#include "vcg.h"
+#include "morph.h"
+#include "sweep.h"
+#include "gen_tpl.h"
+#include "resample.h"
+#include "partime.h"
+#include "stats.h"
+#include "trace.h"
 
 /*--------------------------------------------------------------------------*/
 /*    DEFINE PARAMETERS AS GLOBAL VARIABLES                                 */
 /*--------------------------------------------------------------------------*/
 
-char outfile[100]="ecgsyn.dat";/*  Output data file                   */ 
+char outfile[100]="ecgsyn.dat";/*  Output data file ("-" for stdout)  */ 
+char outformat[100]="txt";     /*  Output format: txt, f32 or i16     */
+int blocksize = 1024;          /*  Output block size in samples       */
+int realtime = 0;              /*  Pace output at wall-clock rate     */
+char shmname[100]="";          /*  Shared-memory ring to publish to   */
+int shmslots = 65536;          /*  Shared-memory ring size in samples */
 int N = 256;                   /*  Number of heart beats              */
 int sfecg = 256;               /*  ECG sampling frequency             */
 int sf = 256;                  /*  Internal sampling frequency        */
@@ -61,604 +67,1696 @@ double flostd = 0.01;          /*  Low frequency std                  */
 double fhistd = 0.01;          /*  High frequency std                 */
 double lfhfratio = 0.5;        /*  LF/HF ratio                        */
 
-int Necg = 0;                  /*  Number of ECG outputs              */
-int mstate = 3;                /*  System state space dimension       */
-double xinitial = 1.0;         /*  Initial x co-ordinate value        */
-double yinitial = 0.0;         /*  Initial y co-ordinate value        */
-double zinitial = 0.04;        /*  Initial z co-ordinate value        */
 int seed = 1;                  /*  Seed                               */
-long rseed; 
-double h; 
-double *rr,*rrpc;
-double *ti,*ai,*bi;
+char listenaddr[100]="";       /*  Serve streams on this address      */
+int nworkers = 4;              /*  Number of generator threads        */
+int leads12 = 0;               /*  Output the 12-lead ECG             */
+char morphfile[100]="";        /*  Morphology table file              */
+char tilist[100]="";           /*  Kernel angles ti [degrees]         */
+char ailist[100]="";           /*  Kernel amplitudes ai               */
+char bilist[100]="";           /*  Kernel widths bi                   */
+char sweepfile[100]="";        /*  Morphology sweep file              */
+int nlhs = 0;                  /*  Latin hypercube samples of sweep   */
+char precision[100]="double";  /*  Integration precision              */
+int accuracy = 0;              /*  Report float vs double accuracy    */
+char integrator[100]="rk4";    /*  Integration scheme                 */
+int steperror = 0;             /*  Report error vs step of rk4 and etd*/
+char ratelist[100]="";         /*  Output sampling frequencies        */
+int resampled = 0;             /*  Resample instead of decimating     */
+int nthreads = 1;              /*  Threads integrating one record     */
+double warmup = 30.0;          /*  Warm-up of each time segment       */
+int seamcheck = 0;             /*  Check the seams against serial run */
+char ckptfile[100]="";         /*  Checkpoint file written per block  */
+char restorefile[100]="";      /*  Checkpoint file to continue from   */
+char normmode[100]="";         /*  Range of a streamed run            */
+double maxmem = 0.0;           /*  Memory budget [MB], 0 for none     */
+int rrdiv = 0;                 /*  RR process at sf/rrdiv (from -m)   */
+char statsfile[100]="";        /*  Per-stage timing JSON ("-": stderr)*/
+char tracefile[100]="";        /*  Chrome trace-event JSON of threads */
+
+genmorph morph;                /*  Morphology given by the options    */
+int usermorph = 0;             /*  morph is set                       */
 
-/* prototypes for externally defined functions */
-void dfour1(double data[], unsigned long nn, int isign);
-float ran1(long *idum);
-
-/*---------------------------------------------------------------------------*/
-/*      ALLOCATE MEMORY FOR VECTOR                                           */
-/*---------------------------------------------------------------------------*/
+/*--------------------------------------------------------------------------*/
+/*    WRITE VECTOR IN A FILE                                                */
+/*--------------------------------------------------------------------------*/
 
-double *mallocVect(long n0, long nx)
+/* returns the number of bytes written */
+long vecfile(char filename[], double *x, long n)
 {
-        double *vect;
- 
-        vect=(double *)malloc((size_t) ((nx-n0+1+OFFSET)*sizeof(double)));
-        if (!vect){
-	  printf("Memory allocation failure in mallocVect");
-	}
-        return vect-n0+OFFSET;
+   long i,len;
+   FILE *fp;
+  
+   fp = fopen(filename,"w");
+   for(i=1;i<=n;i++)  fprintf(fp,"%e\n",x[i]);
+   len = ftell(fp);
+   fclose(fp);
+   return len;
 }
 
-/*---------------------------------------------------------------------------*/
-/*      FREE MEMORY FOR MALLOCVECT                                           */
-/*---------------------------------------------------------------------------*/
- 
-void freeVect(double *vect, long n0, long nx)
+/*--------------------------------------------------------------------------*/
+/*    COLLECT MODEL PARAMETERS                                              */
+/*--------------------------------------------------------------------------*/
+
+void getparams(genparams *p)
 {
-        free((ARG1) (vect+n0-OFFSET));
+   p->N = N;
+   p->sfecg = sfecg;
+   p->sf = sf;
+   p->Anoise = Anoise;
+   p->hrmean = hrmean;
+   p->hrstd = hrstd;
+   p->flo = flo;
+   p->fhi = fhi;
+   p->flostd = flostd;
+   p->fhistd = fhistd;
+   p->lfhfratio = lfhfratio;
+   p->seed = seed;
+   p->morph = usermorph ? &morph : NULL;
+   if(strcmp(precision,"double") == 0)     p->prec = GEN_DOUBLE;
+   else if(strcmp(precision,"float") == 0) p->prec = GEN_FLOAT;
+   else                                    p->prec = -1;
+   if(strcmp(integrator,"rk4") == 0)      p->integ = GEN_RK4;
+   else if(strcmp(integrator,"etd") == 0) p->integ = GEN_ETD;
+   else                                   p->integ = -1;
+   p->rrdiv = rrdiv;
 }
 
-/*---------------------------------------------------------------------------*/
-/*      MEAN CALCULATOR                                                      */
-/*---------------------------------------------------------------------------*/
- 
-double mean(double *x, int n)
-/* n-by-1 vector, calculate mean */
+/*--------------------------------------------------------------------------*/
+/*    SET UP MORPHOLOGY FROM FILE AND LISTS                                 */
+/*--------------------------------------------------------------------------*/
+
+void setmorph()
 {
-        int j;
-        double add;
- 
-        add = 0.0;
-        for(j=1;j<=n;j++)  add += x[j];
- 
-        return (add/n);
+   int err;
+
+   if(morphfile[0] != '\0')
+   {
+     err = morph_read(&morph, morphfile);
+     if(err < 0) {
+       fprintf(stderr,"Cannot read morphology file: %s\n",morphfile);
+       exit(1);}
+     if(err > 0) {
+       fprintf(stderr,"Invalid kernel in %s, line %d\n",morphfile,err);
+       exit(1);}
+     usermorph = 1;
+   }
+   if(tilist[0] != '\0' || ailist[0] != '\0' || bilist[0] != '\0')
+   {
+     if(!usermorph && morph_copy(&morph, &gen_pqrst) != 0) {
+       fprintf(stderr,"Out of memory\n");
+       exit(1);}
+     usermorph = 1;
+     if(morph_lists(&morph, tilist, ailist, bilist) != 0) {
+       fprintf(stderr,"Invalid kernel lists: -t, -A and -B must be comma separated\n"
+                      "numbers of equal length (all three for a new number of kernels)\n");
+       exit(1);}
+   }
 }
 
+/*--------------------------------------------------------------------------*/
+/*    PRINT BANNER AND PARAMETERS                                           */
+/*--------------------------------------------------------------------------*/
 
-/*---------------------------------------------------------------------------*/
-/*      STANDARD DEVIATION CALCULATOR                                        */
-/*---------------------------------------------------------------------------*/
+void banner()
+{
+   fprintf(stderr,"ECGSYN: A program for generating a realistic synthetic ECG\n" 
+    "Copyright (c) 2003 by Patrick McSharry & Gari Clifford. All rights reserved.\n"
+    "See IEEE Transactions On Biomedical Engineering, 50(3), 289-294, March 2003.\n"
+    "Contact P. McSharry (patrick@mcsharry.net) or G. Clifford (gari@mit.edu)\n"); 
 
-double stdev(double *x, int n)
-/* n-by-1 vector, calculate standard deviation */
+   fprintf(stderr,"Approximate number of heart beats: %d\n",N);
+   fprintf(stderr,"ECG sampling frequency: %d Hertz\n",sfecg);
+   fprintf(stderr,"Internal sampling frequency: %d Hertz\n",sf);
+   fprintf(stderr,"Amplitude of additive uniformly distributed noise: %g mV\n",Anoise);
+   fprintf(stderr,"Heart rate mean: %g beats per minute\n",hrmean);
+   fprintf(stderr,"Heart rate std: %g beats per minute\n",hrstd);
+   fprintf(stderr,"Low frequency: %g Hertz\n",flo);
+   fprintf(stderr,"High frequency std: %g Hertz\n",fhistd);
+   fprintf(stderr,"Low frequency std: %g Hertz\n",flostd);
+   fprintf(stderr,"High frequency: %g Hertz\n",fhi);
+   fprintf(stderr,"LF/HF ratio: %g\n",lfhfratio);
+}
+
+/* write the timeline of the threads to tracefile */
+void writetrace()
 {
-        int j;
-        double add,mean,diff,total;
-
-        add = 0.0;
-        for(j=1;j<=n;j++)  add += x[j];
-        mean = add/n;
-
-        total = 0.0;
-        for(j=1;j<=n;j++)  
-        {
-           diff = x[j] - mean;
-           total += diff*diff;
-        } 
-  
-        return (sqrt(total/(n-1)));
+   if(tracefile[0] != '\0' && trace_write(tracefile) != 0)
+     fprintf(stderr,"Cannot write the trace to %s\n",tracefile);
 }
 
+/* the modes of the program, defined below */
+void dorun(void);
+void dorun12(void);
+void dosweep(void);
+void dorates(void);
+int normof(const char *name);
+void dostream(void);
+void doplan(void);
+void doaccuracy(void);
+void dosteperror(void);
+
 /*--------------------------------------------------------------------------*/
-/*    WRITE VECTOR IN A FILE                                                */
-/*--------------------------------------------------------------------------*/
+/*      MAIN PROGRAM                                                         */
+/*---------------------------------------------------------------------------*/
 
-void vecfile(char filename[], double *x, int n)
+int main(argc,argv)
+int     argc;
+char    **argv;
 {
-   int i;
-   FILE *fp;
-  
-   fp = fopen(filename,"w");
-   for(i=1;i<=n;i++)  fprintf(fp,"%e\n",x[i]);
-   fclose(fp);
+    int plain;
+
+    /* First step is to register the options */
+
+    optregister(outfile,CSTRING,'O',"Name of output data file");  
+    optregister(outformat,CSTRING,'o',"Output format: txt, f32 or i16");
+    optregister(blocksize,INT,'b',"Output block size [samples]");
+    optregister(realtime,FLAG,'r',"Pace output blocks in real time");
+    optregister(shmname,CSTRING,'M',"Also publish to shared-memory ring /name");
+    optregister(shmslots,INT,'Q',"Shared-memory ring size [samples]");
+    optregister(N,INT,'n',"Approximate number of heart beats");    
+    optregister(sfecg,INT,'s',"ECG sampling frequency [Hz]");   
+    optregister(sf,INT,'S',"Internal Sampling frequency [Hz]"); 
+    optregister(Anoise,DOUBLE,'a',"Amplitude of additive uniform noise [mV]");
+    optregister(hrmean,DOUBLE,'h',"Heart rate mean [bpm]");
+    optregister(hrstd,DOUBLE,'H',"Heart rate standard deviation [bpm]");
+    optregister(flo,DOUBLE,'f',"Low frequency [Hz]");
+    optregister(fhi,DOUBLE,'F',"High frequency [Hz]");
+    optregister(flostd,DOUBLE,'v',"Low frequency standard deviation [Hz]");
+    optregister(fhistd,DOUBLE,'V',"High frequency standard deviation [Hz]");
+    optregister(lfhfratio,DOUBLE,'q',"LF/HF ratio");
+    optregister(seed,INT,'R',"Seed");    
+    optregister(listenaddr,CSTRING,'L',"Serve streams on tcp:[host:]port or unix:path");
+    optregister(nworkers,INT,'w',"Number of generator threads");
+    optregister(leads12,FLAG,'l',"Output the 12-lead ECG (text only)");
+    optregister(morphfile,CSTRING,'k',"Morphology file of kernels: ti ai bi [tx]");
+    optregister(tilist,CSTRING,'t',"Kernel angles ti [degrees], comma separated");
+    optregister(ailist,CSTRING,'A',"Kernel amplitudes ai, comma separated");
+    optregister(bilist,CSTRING,'B',"Kernel widths bi, comma separated");
+    optregister(sweepfile,CSTRING,'W',"Sweep morphology: file of name lo hi [n]");
+    optregister(nlhs,INT,'G',"Latin hypercube samples of the sweep (0: grid)");
+    optregister(precision,CSTRING,'p',"Integration precision: double or float");
+    optregister(accuracy,FLAG,'X',"Report the accuracy of float vs double");
+    optregister(integrator,CSTRING,'I',"Integrator: rk4 or etd");
+    optregister(steperror,FLAG,'E',"Report the error of rk4 and etd vs step size");
+    optregister(ratelist,CSTRING,'d',"Output sampling frequencies [Hz], comma separated");
+    optregister(resampled,FLAG,'x',"Resample to the output rate (any -S) with a polyphase filter");
+    optregister(nthreads,INT,'j',"Number of threads integrating one record");
+    optregister(warmup,DOUBLE,'J',"Warm-up of each time segment of -j [s]");
+    optregister(seamcheck,FLAG,'U',"Check the output of -j against the serial integration");
+    optregister(ckptfile,CSTRING,'K',"Checkpoint the generator to this file after every block");
+    optregister(restorefile,CSTRING,'c',"Continue the run saved in this checkpoint file");
+    optregister(normmode,CSTRING,'N',"Stream the record, scaled by: exact, twopass, template or bound");
+    optregister(maxmem,DOUBLE,'m',"Memory budget [MB]: plan the run to fit it, or fail before starting");
+    optregister(statsfile,CSTRING,'T',"Write the time of each stage as JSON to this file (- for stderr)");
+    optregister(tracefile,CSTRING,'Y',"Write a timeline of the threads to this file (Chrome trace JSON)");
+    opt_title_set("ECGSYN: A program for generating a realistic synthetic ECG\n" 
+     "Copyright (c) 2003 by Patrick McSharry & Gari Clifford. All rights reserved.\n");
+
+    getopts(argc,argv);
+    setmorph();
+
+    /* -T times the stages of the default run, -Y traces it and the server */
+    plain = !accuracy && !steperror && sweepfile[0] == '\0' 
+            && ratelist[0] == '\0' && ckptfile[0] == '\0' 
+            && restorefile[0] == '\0' && normmode[0] == '\0' && !leads12;
+    if(statsfile[0] != '\0' && (listenaddr[0] != '\0' || !plain)) {
+      fprintf(stderr,"-T times the default run only, not -L, -N, -K, -c, -l, -W, -d, -X or -E\n");
+      exit(1);}
+    if(tracefile[0] != '\0' && listenaddr[0] == '\0' && !plain) {
+      fprintf(stderr,"-Y traces the default run and -L only, not -N, -K, -c, -l, -W, -d, -X or -E\n");
+      exit(1);}
+    trace_start(tracefile[0] != '\0');
+
+    if(listenaddr[0] != '\0') 
+    {
+       genparams p;
+       int ret,norm;
+       getparams(&p);
+       /* a prescan per connection would delay every stream start by the
+          integration of a whole record: exact only if asked for */
+       norm = normmode[0] != '\0' ? normof(normmode) : GEN_NORM_TEMPLATE;
+       ret = server_run(listenaddr, &p, nworkers, blocksize, 
+                        sink_format(outformat), norm);
+       writetrace();
+       return ret;
+    }
+    if(maxmem > 0.0)          doplan();
+    else if(accuracy)         doaccuracy();
+    else if(steperror)        dosteperror();
+    else if(sweepfile[0] != '\0') dosweep();
+    else if(ratelist[0] != '\0') dorates();
+    else if(ckptfile[0] != '\0' || restorefile[0] != '\0' 
+            || normmode[0] != '\0') dostream();
+    else if(leads12)          dorun12();
+    else                      dorun();
+    writetrace();
+    return 0;
 }
 
+
+
 /*--------------------------------------------------------------------------*/
-/*    INTERP                                                                */
+/*    OUTPUT RATES                                                          */
 /*--------------------------------------------------------------------------*/
 
-void interp(double *y, double *x, int n, int r)
+/* One output rate: the state of the integration is downsampled on the fly 
+   into buffers of its own, either by taking every qth sample or through the
+   polyphase resampler (-x), which needs no integer ratio sf/fs. */
+typedef struct outrate {
+  int fs;              // sampling frequency [Hz]
+  int q;               // decimation factor sf/fs, 0 when resampled
+  long n;              // number of samples
+  long m;              // number of samples stored so far
+  resampler rs;        // resampler of x, y, z when q is 0
+  double *out;         // output frames of one resample_push()
+  double *x,*y,*z;     // downsampled state x[1..n], y[1..n], z[1..n]
+  double *ipeak;       // peak labels ipeak[1..n]
+} outrate;
+
+int outrate_init(outrate *r, int fs, const gen *g, int resampled)
 {
-   int i,j;
-   double a;
+   r->fs = fs;
+   r->m = 0;
+   r->out = NULL;
+   if(resampled)
+   {
+      r->q = 0;
+      if(resample_init(&r->rs, g->p.sf, fs) != 0) return -1;
+      r->n = resample_count(&r->rs, g->Nt);
+      r->out = (double *)arena_alloc(g->mem, (size_t)(r->rs.up/r->rs.down+2)
+                                     *RESAMPLE_NCH*sizeof(double));
+   }
+   else
+   {
+      r->q = g->p.sf/fs;
+      r->n = (g->Nt+r->q-1)/r->q;
+   }
+   r->x = arena_vect(g->mem,1,r->n);
+   r->y = arena_vect(g->mem,1,r->n);
+   r->z = arena_vect(g->mem,1,r->n);
+   r->ipeak = arena_vect(g->mem,1,r->n);
+   if((resampled && !r->out) || !r->x || !r->y || !r->z || !r->ipeak) 
+     return -1;
+   return 0;
+}
+
+/* take internal sample i of nt, the state x[1..3] */
+void outrate_push(outrate *r, const double *x, long i, long nt)
+{
+   int j,k;
+   double in[RESAMPLE_NCH];
 
-   for(i=1;i<=n-1;i++)
+   if(r->q > 0)
    {
-      for(j=1;j<=r;j++) 
+      if((i-1)%r->q == 0)
       {
-         a = (j-1)*1.0/r;
-         y[(i-1)*r+j] = (1.0-a)*x[i] + a*x[i+1];
+         r->m++;
+         r->x[r->m] = x[1];
+         r->y[r->m] = x[2];
+         r->z[r->m] = x[3];
       }
+      return;
    }
+   in[0] = x[1];
+   in[1] = x[2];
+   in[2] = x[3];
+   in[3] = 0.0;
+   do 
+   {
+      k = resample_push(&r->rs, in, r->out, r->n);
+      for(j=0;j<k;j++)
+      {
+         r->m++;
+         r->x[r->m] = r->out[j*RESAMPLE_NCH];
+         r->y[r->m] = r->out[j*RESAMPLE_NCH+1];
+         r->z[r->m] = r->out[j*RESAMPLE_NCH+2];
+      }
+   } while(i == nt && r->m < r->n);          // the end: flush the filter
 }
 
+/* the buffers go with the arena of the generator */
+void outrate_free(outrate *r)
+{
+   if(r->q == 0) resample_free(&r->rs);
+}
 
 /*--------------------------------------------------------------------------*/
-/*    GENERATE RR PROCESS                                                   */
+/*    PARALLEL IN TIME                                                      */
 /*--------------------------------------------------------------------------*/
 
-void rrprocess(double *rr, double flo, double fhi, 
-double flostd, double fhistd, double lfhfratio,  
-double hrmean, double hrstd, double sf, int n)
+/* Budget of the seams: one step of the i16 output (1 uV). */
+#define SEAM_MV 0.001
+
+/* integrate the record of g (not stepped) on nthreads threads into r;
+   returns the number of steps taken, warm-ups included */
+long partime(gen *g, outrate *r)
 {
-   int i,j;
-   double c1,c2,w1,w2,sig1,sig2,rrmean,rrstd,xstd,ratio;
-   double df,dw1,dw2,*w,*Hw,*Sw,*ph0,*ph,*SwC;
-
-   w = mallocVect(1,n);
-   Hw = mallocVect(1,n);
-   Sw = mallocVect(1,n);
-   ph0 = mallocVect(1,n/2-1);
-   ph = mallocVect(1,n);
-   SwC = mallocVect(1,2*n);
-
-
-   w1 = 2.0*PI*flo;
-   w2 = 2.0*PI*fhi;
-   c1 = 2.0*PI*flostd;
-   c2 = 2.0*PI*fhistd;
-   sig2 = 1.0;
-   sig1 = lfhfratio;
-   rrmean = 60.0/hrmean;
-   rrstd = 60.0*hrstd/(hrmean*hrmean);
-
-   df = sf/n;
-   for(i=1;i<=n;i++) w[i] = (i-1)*2.0*PI*df;
-   for(i=1;i<=n;i++) 
-   {
-      dw1 = w[i]-w1;
-      dw2 = w[i]-w2;
-      Hw[i] = sig1*exp(-dw1*dw1/(2.0*c1*c1))/sqrt(2*PI*c1*c1) 
-            + sig2*exp(-dw2*dw2/(2.0*c2*c2))/sqrt(2*PI*c2*c2); 
-   }
-   for(i=1;i<=n/2;i++) Sw[i] = (sf/2.0)*sqrt(Hw[i]);
-   for(i=n/2+1;i<=n;i++) Sw[i] = (sf/2.0)*sqrt(Hw[n-i+1]);
-
-
-   /* randomise the phases */
-   for(i=1;i<=n/2-1;i++) ph0[i] = 2.0*PI*ran1(&rseed);
-   ph[1] = 0.0;
-   for(i=1;i<=n/2-1;i++) ph[i+1] = ph0[i];
-   ph[n/2+1] = 0.0;
-   for(i=1;i<=n/2-1;i++) ph[n-i+1] = - ph0[i]; 
-
-
-   /* make complex spectrum */
-   for(i=1;i<=n;i++) SwC[2*i-1] = Sw[i]*cos(ph[i]);
-   for(i=1;i<=n;i++) SwC[2*i] = Sw[i]*sin(ph[i]);
-
-   /* calculate inverse fft */
-   dfour1(SwC,n,-1);
-
-   /* extract real part */
-   for(i=1;i<=n;i++) rr[i] = (1.0/n)*SwC[2*i-1];
-
-   xstd = stdev(rr,n);
-   ratio = rrstd/xstd; 
-
-   for(i=1;i<=n;i++) rr[i] *= ratio;
-   for(i=1;i<=n;i++) rr[i] += rrmean;
-
-   freeVect(w,1,n);
-   freeVect(Hw,1,n);
-   freeVect(Sw,1,n);
-   freeVect(ph0,1,n/2-1);
-   freeVect(ph,1,n);
-   freeVect(SwC,1,2*n);
-}
+   int s,nseg;
+   long steps;
+   ptseg *seg;
 
-/*--------------------------------------------------------------------------*/
-/*    THE ANGULAR FREQUENCY                                                 */
-/*--------------------------------------------------------------------------*/
+   seg = (ptseg *)malloc(MIN(nthreads,PARTIME_MAXSEG)*sizeof(ptseg));
+   if(!seg) {
+     fprintf(stderr,"Out of memory\n");
+     exit(1);}
+   nseg = partime_plan(g, nthreads, warmup, seg);
+   if(nseg < 1) {
+     fprintf(stderr,"-j needs the double precision rk4 integrator\n");
+     exit(1);}
+   fprintf(stderr,"Integrating %d time segments in parallel, %g s warm-up\n",
+           nseg,warmup);
+   if(partime_run(seg, nseg, r->q, r->x, r->y, r->z) != 0) {
+     fprintf(stderr,"Cannot start the integration threads\n");
+     exit(1);}
+   r->m = r->n;
+   steps = 0;
+   for(s=0;s<nseg;s++) steps += seg[s].end-seg[s].warm+1;
+   free(seg);
+   return steps;
+}
 
-double angfreq(double t)
+/* compare the output of partime() in r with the serial integration of g;
+   exits with status 1 if a seam exceeds SEAM_MV */
+void checkseams(gen *g, outrate *r)
 {
-   int i;
-  
-   i = 1 + (int)floor(t/h);
-  
-   return 2.0*PI/rrpc[i];
+   long i,j,jmax,nxy;
+   double *zs,zmin,zmax,zrange,dev,maxdev;
+   arenamark mark;
+   gen s;
+
+   s = *g;
+   mark = arena_mark(g->mem);
+   zs = arena_vect(g->mem,1,r->n);
+   nxy = 0;
+   for(i=1;i<=s.Nt;i++)
+   {
+      if((i-1)%r->q == 0)
+      {
+         j = (i-1)/r->q+1;
+         zs[j] = s.x[3];
+         if(s.x[1] != r->x[j] || s.x[2] != r->y[j]) nxy++;
+      }
+      gen_step(&s);
+   }
+   zmin = zmax = zs[1];
+   for(j=2;j<=r->n;j++)
+   {
+      if(zs[j] < zmin) zmin = zs[j];
+      if(zs[j] > zmax) zmax = zs[j];
+   }
+   zrange = zmax-zmin;
+   maxdev = 0.0;
+   jmax = 1;
+   for(j=1;j<=r->n;j++)
+   {
+      dev = 1.6*fabs(r->z[j]-zs[j])/zrange;
+      if(dev > maxdev) 
+      {
+         maxdev = dev;
+         jmax = j;
+      }
+   }
+   arena_release(g->mem, mark);
+
+   fprintf(stderr,"Seam check: x, y differ from the serial run in %ld samples\n",
+           nxy);
+   fprintf(stderr,"Seam check: max deviation %.3g mV at %.3f s (budget %g mV)\n",
+           maxdev,(jmax-1)*(double)r->q/g->p.sf,SEAM_MV);
+   if(nxy > 0 || maxdev > SEAM_MV) {
+     fprintf(stderr,"Seam check FAILED\n");
+     exit(1);}
 }
 
 /*--------------------------------------------------------------------------*/
-/*    THE EXACT NONLINEAR DERIVATIVES                                       */
+/*    STAGE TIMING                                                          */
 /*--------------------------------------------------------------------------*/
 
-void derivspqrst(double t0,double x[],double dxdt[])
-{
-   int i,k;
-   double a0,w0,r0,x0,y0,z0;
-   double t,dt,dt2,*xi,*yi,zbase;
- 
-   k = 5; 
-   xi = mallocVect(1,k);
-   yi = mallocVect(1,k); 
-  
-   w0 = angfreq(t0);
-   r0 = 1.0; x0 = 0.0;  y0 = 0.0;  z0 = 0.0;
-   a0 = 1.0 - sqrt((x[1]-x0)*(x[1]-x0) + (x[2]-y0)*(x[2]-y0))/r0;
+#define STATS_BLOCK 4096       /* internal samples per timed interval */
 
-   for(i=1;i<=k;i++) xi[i] = cos(ti[i]);
-   for(i=1;i<=k;i++) yi[i] = sin(ti[i]);   
+runstats stats;                /* stages of dorun() with -T */
 
-   zbase = 0.005*sin(2.0*PI*fhi*t0);
+/* the serial integration of dorun(), timed: STATS_BLOCK steps at a time are
+   integrated with their states kept in xs[0..3*STATS_BLOCK-1] and then
+   decimated, so that the two stages get intervals of their own; the output
+   is that of the untimed loop */
+void integrate_timed(gen *g, outrate *r, double *xs)
+{
+   long i0,k,n;
 
-   t = atan2(x[2],x[1]);
-   dxdt[1] = a0*(x[1] - x0) - w0*(x[2] - y0);
-   dxdt[2] = a0*(x[2] - y0) + w0*(x[1] - x0); 
-   dxdt[3] = 0.0;  
-   for(i=1;i<=k;i++)  
+   for(i0=1;i0<=g->Nt;i0+=STATS_BLOCK)
    {
-      dt = fmod(t-ti[i],2.0*PI);
-      dt2 = dt*dt;
-      dxdt[3] += -ai[i]*dt*exp(-0.5*dt2/(bi[i]*bi[i])); 
+      n = MIN(STATS_BLOCK,g->Nt-i0+1);
+      stats_begin(&stats,"integration");
+      for(k=0;k<n;k++)
+      {
+         xs[3*k] = g->x[1];
+         xs[3*k+1] = g->x[2];
+         xs[3*k+2] = g->x[3];
+         gen_step(g);
+      }
+      stats_end(&stats,n,0.0);
+      stats_begin(&stats,"decimation");
+      for(k=0;k<n;k++) outrate_push(r, xs+3*k-1, i0+k, g->Nt);
+      stats_end(&stats,n,0.0);
    }
-   dxdt[3] += -1.0*(x[3] - zbase);
-  
-   freeVect(xi,1,k);
-   freeVect(yi,1,k);
 }
 
-/*--------------------------------------------------------------------------*/
-/*    RUNGA-KUTTA FOURTH ORDER INTEGRATION                                  */
-/*--------------------------------------------------------------------------*/
-
-void drk4(double y[], int n, double x, double h, double yout[], 
-          void (*derivs)(double, double [], double []))
+/* write the stages of the run of g to statsfile; every integrator evaluates
+   the model four times per step */
+void writestats(const gen *g, long steps, long nout)
 {
-        int i;
-        double xh,hh,h6,*dydx,*dym,*dyt,*yt;
- 
-        dydx=mallocVect(1,n);
-        dym=mallocVect(1,n);
-        dyt=mallocVect(1,n);
-        yt=mallocVect(1,n);
-
-        hh=h*0.5;
-        h6=h/6.0;
-        xh=x+hh;
-        (*derivs)(x,y,dydx);
-        for (i=1;i<=n;i++) yt[i]=y[i]+hh*dydx[i];
-        (*derivs)(xh,yt,dyt);
-        for (i=1;i<=n;i++) yt[i]=y[i]+hh*dyt[i];
-        (*derivs)(xh,yt,dym);
-        for (i=1;i<=n;i++) {
-                yt[i]=y[i]+h*dym[i];
-                dym[i] += dyt[i];
-        }
-        (*derivs)(x+h,yt,dyt);
-        for (i=1;i<=n;i++)
-                yout[i]=y[i]+h6*(dydx[i]+dyt[i]+2.0*dym[i]);
-
-        freeVect(dydx,1,n);
-        freeVect(dym,1,n);
-        freeVect(dyt,1,n);
-        freeVect(yt,1,n);
+   char run[600];
+
+   snprintf(run, sizeof(run), "\"mode\": \"run\", \"N\": %d, "
+            "\"sfecg\": %d, \"sf\": %d, \"integrator\": \"%s\", "
+            "\"precision\": \"%s\", \"threads\": %d, \"format\": \"%s\",\n"
+            " \"rr_samples\": %ld, \"internal_samples\": %ld, "
+            "\"output_samples\": %ld, \"steps\": %ld, "
+            "\"derivative_evaluations\": %ld", N, sfecg, sf, integrator,
+#ifdef ECGSYN_FIXED
+            "fixed",
+#else
+            precision,
+#endif
+            nthreads, outformat, g->Nrr, g->Nt, nout, steps, 4*steps);
+   if(stats_write(&stats, statsfile, run) != 0)
+     fprintf(stderr,"Cannot write the stage times to %s\n",statsfile);
 }
 
 /*--------------------------------------------------------------------------*/
-/*    DETECT PEAKS                                                          */
+/*    DORUN PART OF PROGRAM                                                 */
 /*--------------------------------------------------------------------------*/
 
-double detectpeaks(double *ipeak, double *x, double *y, double *z, int n)
+void dorun()
 {
-   int i,j,j1,j2,jmin,jmax,d;
-   double thetap1,thetap2,thetap3,thetap4,thetap5;
-   double theta1,theta2,d1,d2,zmin,zmax;
-   
-   /* use globally defined angles for PQRST */
-   thetap1 = ti[1];
-   thetap2 = ti[2];
-   thetap3 = ti[3];
-   thetap4 = ti[4];
-   thetap5 = ti[5];
-
-   for(i=1;i<=n;i++) ipeak[i] = 0.0;
-   theta1 = atan2(y[1],x[1]);
-   for(i=1;i<n;i++)
-   {
-      theta2 = atan2(y[i+1],x[i+1]);
-      if( (theta1 <= thetap1) && (thetap1 <= theta2) )  
+   long i,Nts,steps,len;
+   int j,n,fmt;
+   double tstep;
+   double *zts,*rrpc,*noise;
+   double *ipeak,zmin,zmax,zrange;
+   const char *msg;
+   arenamark mark;
+   genparams p;
+   gen g;
+   outrate r;
+   sink out;
+   rtpace pace;
+   shmring ring;
+
+   /* perform some checks on input values */
+   getparams(&p);
+   if(resampled) p.sfecg = p.sf;     /* any sfecg: the resampler gets there */
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg); 
+     fprintf(stderr,"Your current choices are:\n");
+     fprintf(stderr,"ECG sampling frequency: %d Hertz\n",sfecg);
+     fprintf(stderr,"Internal sampling frequency: %d Hertz\n",sf);
+     exit(1);}
+
+   fmt = sink_format(outformat);
+   if(fmt < 0) {
+     fprintf(stderr,"Unknown output format: %s (use txt, f32 or i16)\n",
+             outformat);
+     exit(1);}
+   if(blocksize < 1) {
+     fprintf(stderr,"Output block size must be at least one sample!\n");
+     exit(1);}
+
+   /* calculate time scales */
+   tstep = 1.0/sfecg;
+
+   banner();
+   stats_start(&stats, statsfile[0] != '\0' || trace_on());
+
+   /* set up the model: morphology, seed and rrprocess with required spectrum */
+   stats_begin(&stats,"rr_synthesis");
+   if(gen_init(&g, &p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   stats_end(&stats,g.Nrr,0.0);
+   g.p.sfecg = sfecg;
+   fprintf(stderr,"Using %ld = 2^%d samples for calculating RR intervals\n",
+           g.Nrr,(int)(log10(1.0*g.Nrr)/log10(2.0))); 
+   stats_begin(&stats,"rr_files");
+   len = vecfile("rr.dat",g.rr,g.Nrr);
+   stats_end(&stats,g.Nrr,len);
+
+   /* create piecewise constant rr, as scratch space of the arena */
+   mark = arena_mark(g.mem);
+   rrpc = arena_vect(g.mem,1,2*g.Nrr);
+   stats_begin(&stats,"rrpc");
+   gen_rrpc(&g, rrpc);
+   stats_end(&stats,g.Nt,0.0);
+   stats_begin(&stats,"rr_files");
+   len = vecfile("rrpc.dat",rrpc,g.Nt);
+   stats_end(&stats,g.Nt,len);
+   arena_release(g.mem, mark);
+
+   if(outfile[0] == '-' && outfile[1] == '\0')
+     fprintf(stderr,"Printing ECG signal to standard output\n");
+   else
+     fprintf(stderr,"Printing ECG signal to file: %s\n",outfile);
+
+   /* integrate dynamical system using fourth order Runge-Kutta and
+      downsample to ECG sampling frequency on the fly */
+   if(outrate_init(&r, sfecg, &g, resampled) != 0) {
+     fprintf(stderr,"Cannot set up the output rate of %d Hz\n",sfecg);
+     exit(1);}
+   if(nthreads > 1)
+   {
+      if(resampled) {
+        fprintf(stderr,"-j does not combine with -x\n");
+        exit(1);}
+      stats_begin(&stats,"integration");
+      steps = partime(&g, &r);
+      stats_end(&stats,g.Nt,0.0);
+      if(seamcheck) checkseams(&g, &r);
+   }
+   else if(stats.on)
+   {
+      mark = arena_mark(g.mem);
+      integrate_timed(&g, &r, arena_vect(g.mem,0,3*STATS_BLOCK-1));
+      arena_release(g.mem, mark);
+      steps = g.Nt;
+   }
+   else 
+   {
+      for(i=1;i<=g.Nt;i++)
       {
-	d1 = thetap1 - theta1;
-        d2 = theta2 - thetap1;
-        if(d1 < d2)  ipeak[i] = 1.0;
-        else         ipeak[i+1] = 1.0;
+         outrate_push(&r, g.x, i, g.Nt);
+         gen_step(&g);
       }
-      else if( (theta1 <= thetap2) && (thetap2 <= theta2) )  
+      steps = g.Nt;
+   }
+   Nts = r.n;
+   zts = r.z;
+   ipeak = r.ipeak;
+
+   /* do peak detection using angle */
+   stats_begin(&stats,"peak_detection");
+   detectpeaks(&g, ipeak, r.x, r.y, zts, Nts);
+   stats_end(&stats,Nts,0.0);
+ 
+   /* range of the signal, scaled to lie between -0.4 and 1.2 mV below 
+      (the scaling itself is fused into the output) */
+   stats_begin(&stats,"scaling");
+   zmin = zts[1];
+   zmax = zts[1];
+   for(i=2;i<=Nts;i++)
+   {
+     if(zts[i] < zmin)       zmin = zts[i];
+     else if(zts[i] > zmax)  zmax = zts[i];
+   }
+   zrange = zmax-zmin;
+   stats_end(&stats,Nts,0.0);
+
+   /* output ECG file (or stream), one block at a time: scaling, additive
+      uniformly distributed measurement noise and formatting happen in one
+      pass over each block (sink_writeraw), while it is in cache */
+   stats_begin(&stats,"output");
+   if(sink_open(&out, outfile, fmt, tstep, blocksize) != 0) {
+     fprintf(stderr,"Cannot open output file: %s\n",outfile);
+     exit(1);}
+   if(shmname[0] != '\0') {
+     if(shmslots < 1 || shmring_create(&ring, shmname, shmslots, tstep) != 0) {
+       fprintf(stderr,"Cannot create shared-memory ring: %s\n",shmname);
+       exit(1);}
+     fprintf(stderr,"Publishing ECG signal to shared-memory ring: %s\n",shmname);}
+   noise = arena_vect(g.mem,0,blocksize-1);
+   memset(noise,0,blocksize*sizeof(double));
+   if(realtime) rtpace_start(&pace, blocksize, sfecg);
+   for(i=1;i<=Nts;i+=blocksize)
+   {
+      n = MIN(blocksize,Nts-i+1);
+      if(Anoise != 0.0)
+        for(j=0;j<n;j++) noise[j] = Anoise*(2.0*ran1_r(&g.rseed,&g.rng) - 1.0);
+      if(realtime) rtpace_wait(&pace);
+      if(shmname[0] != '\0')
       {
-	d1 = thetap2 - theta1;
-        d2 = theta2 - thetap2;
-        if(d1 < d2)  ipeak[i] = 2.0;
-        else         ipeak[i+1] = 2.0;
+         /* the ring takes voltages: scale the block in place first */
+         for(j=0;j<n;j++) 
+           zts[i+j] = (zts[i+j]-zmin)*(1.6)/zrange - 0.4 + noise[j];
+         if(sink_write(&out, zts+i, ipeak+i, n) != 0) {
+           fprintf(stderr,"Error writing ECG output\n");
+           exit(1);}
+         shmring_publish(&ring, zts+i, ipeak+i, n);
       }
-      else if( (theta1 <= thetap3) && (thetap3 <= theta2) )  
+      else if(sink_writeraw(&out, zts+i, noise, ipeak+i, n, zmin, zrange) != 0) {
+        fprintf(stderr,"Error writing ECG output\n");
+        exit(1);}
+   }
+   sink_close(&out);
+   if(shmname[0] != '\0') shmring_close(&ring);
+   stats_end(&stats,Nts,out.nbytes);
+   if(realtime) rtpace_report(&pace, stderr);
+
+
+   fprintf(stderr,"Finished ECG output\n");
+   if(statsfile[0] != '\0') writestats(&g, steps, Nts);
+
+outrate_free(&r);
+gen_free(&g);
+
+/* END OF DORUN */
+}
+
+
+
+/*--------------------------------------------------------------------------*/
+/*    12-LEAD PART OF PROGRAM                                               */
+/*--------------------------------------------------------------------------*/
+
+void dorun12()
+{
+   long i,j,Nts;
+   int l,n,q;
+   double tstep;
+   double *xts,*yts,*Xts,*Yts,*Zts,*ipeak,*lead[VCG_NLEAD],*lead2;
+   double zmin,zmax,gain;
+   const char *msg;
+   genparams p;
+   vcg v;
+   rtpace pace;
+   FILE *fp;
+
+   getparams(&p);
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     exit(1);}
+   if(sink_format(outformat) != SINK_TXT || shmname[0] != '\0') {
+     fprintf(stderr,"12-lead output is written as text only\n");
+     exit(1);}
+   if(p.prec != GEN_DOUBLE || p.integ != GEN_RK4) {
+     fprintf(stderr,"12-lead output is integrated in double precision with rk4 only\n");
+     exit(1);}
+   if(usermorph) {
+     fprintf(stderr,"12-lead output has dipoles for the five PQRST waves only: "
+                    "-k, -t, -A and -B cannot be used\n");
+     exit(1);}
+   if(blocksize < 1) {
+     fprintf(stderr,"Output block size must be at least one sample!\n");
+     exit(1);}
+
+   tstep = 1.0/sfecg;
+   banner();
+
+   if(vcg_init(&v, &p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   q = v.g.q;
+   fprintf(stderr,"Using %ld = 2^%d samples for calculating RR intervals\n",
+           v.g.Nrr,(int)(log10(1.0*v.g.Nrr)/log10(2.0)));
+   vecfile("rr.dat",v.g.rr,v.g.Nrr);
+
+   /* integrate the dipole model, keeping every q-th sample */
+   Nts = (v.g.Nt+q-1)/q;
+   xts = arena_vect(v.g.mem,1,Nts);
+   yts = arena_vect(v.g.mem,1,Nts);
+   Xts = arena_vect(v.g.mem,1,Nts);
+   Yts = arena_vect(v.g.mem,1,Nts);
+   Zts = arena_vect(v.g.mem,1,Nts);
+   j=0;
+   for(i=1;i<=v.g.Nt;i++)
+   {
+      if((i-1)%q == 0)
       {
-	d1 = thetap3 - theta1;
-        d2 = theta2 - thetap3;
-        if(d1 < d2)  ipeak[i] = 3.0;
-        else         ipeak[i+1] = 3.0;
+         j++;
+         xts[j] = v.x[1];
+         yts[j] = v.x[2];
+         Xts[j] = v.x[3];
+         Yts[j] = v.x[4];
+         Zts[j] = v.x[5];
       }
-      else if( (theta1 <= thetap4) && (thetap4 <= theta2) )  
+      vcg_step(&v);
+   }
+
+   /* label the peaks on lead II and scale it to span 1.6 mV */
+   lead2 = arena_vect(v.g.mem,1,Nts);
+   for(i=1;i<=Nts;i++)
+     lead2[i] = vcg_dower[1][0]*Xts[i] + vcg_dower[1][1]*Yts[i]
+              + vcg_dower[1][2]*Zts[i];
+   ipeak = arena_vect(v.g.mem,1,Nts);
+   detectpeaks(&v.g, ipeak, xts, yts, lead2, Nts);
+   zmin = zmax = lead2[1];
+   for(i=2;i<=Nts;i++)
+   {
+     if(lead2[i] < zmin)       zmin = lead2[i];
+     else if(lead2[i] > zmax)  zmax = lead2[i];
+   }
+   gain = (zmax > zmin) ? 1.6/(zmax-zmin) : 1.0;
+
+   if(outfile[0] == '-' && outfile[1] == '\0') {
+     fp = stdout;
+     fprintf(stderr,"Printing 12-lead ECG to standard output\n");}
+   else if((fp = fopen(outfile,"w")) == NULL) {
+     fprintf(stderr,"Cannot open output file: %s\n",outfile);
+     exit(1);}
+   else
+     fprintf(stderr,"Printing 12-lead ECG to file: %s\n",outfile);
+
+   /* project one block at a time onto the leads, add noise and print */
+   for(l=0;l<VCG_NLEAD;l++) lead[l] = arena_vect(v.g.mem,0,blocksize-1);
+   if(realtime) rtpace_start(&pace, blocksize, sfecg);
+   for(i=1;i<=Nts;i+=blocksize)
+   {
+      n = MIN(blocksize,Nts-i+1);
+      vcg_project(Xts+i, Yts+i, Zts+i, n, gain, lead);
+      for(l=0;l<VCG_NLEAD;l++)
+        for(j=0;j<n;j++) lead[l][j] += Anoise*(2.0*ran1_r(&v.g.rseed,&v.g.rng) - 1.0);
+
+      if(realtime) rtpace_wait(&pace);
+      for(j=0;j<n;j++)
       {
-	d1 = thetap4 - theta1;
-        d2 = theta2 - thetap4;
-        if(d1 < d2)  ipeak[i] = 4.0;
-        else         ipeak[i+1] = 4.0;
+         fprintf(fp,"%f",(i+j-1)*tstep);
+         for(l=0;l<VCG_NLEAD;l++) fprintf(fp," %f",lead[l][j]);
+         fprintf(fp," %d\n",(int)ipeak[i+j]);
       }
-      else if( (theta1 <= thetap5) && (thetap5 <= theta2) )  
+      if(fp == stdout) fflush(fp);
+   }
+   if(fp != stdout) fclose(fp);
+   if(realtime) rtpace_report(&pace, stderr);
+
+   fprintf(stderr,"Finished ECG output\n");
+
+vcg_free(&v);
+
+/* END OF DORUN12 */
+}
+
+
+
+/*--------------------------------------------------------------------------*/
+/*    SWEEP PART OF PROGRAM                                                 */
+/*--------------------------------------------------------------------------*/
+
+/* output file tagged with v: ecgsyn.dat -> ecgsyn_0001.dat for fmt "%04d" */
+void varfile(char *name, const char *fmt, int v)
+{
+   char *dot,*slash,tag[32];
+   int len;
+
+   dot = strrchr(outfile,'.');
+   slash = strrchr(outfile,'/');
+   if(!dot || (slash && dot < slash)) dot = outfile+strlen(outfile);
+   len = (int)(dot-outfile);
+   sprintf(tag,fmt,v);
+   sprintf(name,"%.*s_%s%s",len,outfile,tag,dot);
+}
+
+void dosweep()
+{
+   long i,Nts;
+   int v,d,fmt,err;
+   double *zts,*ipeak,zmin,zmax,zrange;
+   char name[200];
+   const char *msg;
+   genparams p;
+   genmorph m;
+   sweep sw;
+   zforce f;
+   gen g;
+   long rseed;
+   ran1state rng;
+   sink out;
+   FILE *fp;
+
+   getparams(&p);
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     exit(1);}
+   fmt = sink_format(outformat);
+   if(fmt < 0 || blocksize < 1) {
+     fprintf(stderr,"Invalid output format or block size\n");
+     exit(1);}
+   if((outfile[0] == '-' && outfile[1] == '\0') || realtime || leads12
+      || shmname[0] != '\0') {
+     fprintf(stderr,"A sweep writes single-lead files only (no -O -, -r, -l or -M)\n");
+     exit(1);}
+   if(p.prec != GEN_DOUBLE || p.integ != GEN_RK4) {
+     fprintf(stderr,"A sweep is integrated in double precision with rk4 only\n");
+     exit(1);}
+
+   banner();
+
+   if(gen_init(&g, &p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   err = sweep_read(&sw, sweepfile, g.k, nlhs, seed);
+   if(err < 0) {
+     fprintf(stderr,"Cannot read sweep file %s, or too many variants\n",sweepfile);
+     exit(1);}
+   if(err > 0) {
+     fprintf(stderr,"Invalid parameter in %s, line %d\n",sweepfile,err);
+     exit(1);}
+   fprintf(stderr,"Using %ld = 2^%d samples for calculating RR intervals\n",
+           g.Nrr,(int)(log10(1.0*g.Nrr)/log10(2.0)));
+   vecfile("rr.dat",g.rr,g.Nrr);
+
+   /* one RR series and one forcing table for all variants */
+   if(zforce_init(&f, &g) != 0 
+      || morph_copy(&m, p.morph ? p.morph : &gen_pqrst) != 0) {
+     fprintf(stderr,"Out of memory\n");
+     exit(1);}
+   Nts = f.Nts;
+   zts = arena_vect(g.mem,1,Nts);
+   ipeak = arena_vect(g.mem,1,Nts);
+   rseed = g.rseed;
+   rng = g.rng;
+
+   fp = fopen("sweep.dat","w");
+   if(!fp) {
+     fprintf(stderr,"Cannot open sweep.dat\n");
+     exit(1);}
+   fprintf(fp,"# variant");
+   for(d=0;d<sw.ndim;d++) fprintf(fp," %s",sw.dim[d].name);
+   fprintf(fp,"\n");
+   fprintf(stderr,"Printing %d variants to files like %s (list in sweep.dat)\n",
+           sw.nvar,outfile);
+
+   for(v=0;v<sw.nvar;v++)
+   {
+      sweep_variant(&sw, v, &m);
+      if(gen_setmorph(&g, &m) != 0) {
+        fprintf(stderr,"Out of memory\n");
+        exit(1);}
+      zforce_run(&f, &g, zts);
+      detectpeaks(&g, ipeak, f.xts, f.yts, zts, Nts);
+
+      /* scale signal to lie between -0.4 and 1.2 mV */
+      zmin = zts[1];
+      zmax = zts[1];
+      for(i=2;i<=Nts;i++)
       {
-	d1 = thetap5 - theta1;
-        d2 = theta2 - thetap5;
-        if(d1 < d2)  ipeak[i] = 5.0;
-        else         ipeak[i+1] = 5.0;
+        if(zts[i] < zmin)       zmin = zts[i];
+        else if(zts[i] > zmax)  zmax = zts[i];
       }
-      theta1 = theta2; 
+      zrange = zmax-zmin;
+      for(i=1;i<=Nts;i++) zts[i] = (zts[i]-zmin)*(1.6)/zrange - 0.4;
+
+      /* every variant gets the noise of a run of its own */
+      g.rseed = rseed;
+      g.rng = rng;
+      for(i=1;i<=Nts;i++) zts[i] += Anoise*(2.0*ran1_r(&g.rseed,&g.rng) - 1.0);
+
+      varfile(name, "%04d", v+1);
+      if(sink_open(&out, name, fmt, 1.0/sfecg, blocksize) != 0) {
+        fprintf(stderr,"Cannot open output file: %s\n",name);
+        exit(1);}
+      for(i=1;i<=Nts;i+=blocksize)
+        if(sink_write(&out, zts+i, ipeak+i, MIN(blocksize,Nts-i+1)) != 0) {
+          fprintf(stderr,"Error writing ECG output\n");
+          exit(1);}
+      sink_close(&out);
+
+      fprintf(fp,"%d",v+1);
+      for(d=0;d<sw.ndim;d++) fprintf(fp," %f",sw.val[v*sw.ndim+d]);
+      fprintf(fp,"\n");
    }
+   fclose(fp);
 
-   /* correct the peaks */
-   d = (int)ceil(sfecg/64);
-   for(i=1;i<=n;i++)
-   { 
-     if( ipeak[i]==1 || ipeak[i]==3 || ipeak[i]==5 )
-     {
-        j1 = MAX(1,i-d);
-        j2 = MIN(n,i+d);
-        jmax = j1;
-        zmax = z[j1];
-        for(j=j1+1;j<=j2;j++)
-	{ 
-	   if(z[j] > zmax) 
-           {
-	      jmax = j;
-              zmax = z[j];
-	   }
-	}
-        if(jmax != i)
-	{
-           ipeak[jmax] = ipeak[i];
-           ipeak[i] = 0;
-	}
-     }
-     else if( ipeak[i]==2 || ipeak[i]==4 )
-     {
-        j1 = MAX(1,i-d);
-        j2 = MIN(n,i+d);
-        jmin = j1;
-        zmin = z[j1];
-        for(j=j1+1;j<=j2;j++)
-	{ 
-	   if(z[j] < zmin) 
-           {
-	      jmin = j;
-              zmin = z[j];
-	   }
-	}
-        if(jmin != i)
-	{
-           ipeak[jmin] = ipeak[i];
-           ipeak[i] = 0;
-	}
-     }
-   }
+   fprintf(stderr,"Finished ECG output\n");
+
+zforce_free(&f);
+morph_free(&m);
+sweep_free(&sw);
+gen_free(&g);
 
+/* END OF DOSWEEP */
 }
 
+
+/*--------------------------------------------------------------------------*/
+/*    MULTI-RATE PART OF PROGRAM                                            */
 /*--------------------------------------------------------------------------*/
-/*      MAIN PROGRAM                                                         */
-/*---------------------------------------------------------------------------*/
 
-main(argc,argv)
-int     argc;
-char    **argv;
+#define MAXRATES 8
+
+/* parse the comma separated rates of ratelist into r[], return their number
+   or -1 */
+int parserates(outrate *r)
 {
+   int n;
+   long fs;
+   char *s,*end;
 
-    /* First step is to register the options */
+   n = 0;
+   s = ratelist;
+   while(*s != '\0')
+   {
+      fs = strtol(s,&end,10);
+      if(end == s || fs < 1 || n == MAXRATES) return -1;
+      r[n++].fs = (int)fs;
+      s = end;
+      if(*s == ',') s++;
+      else if(*s != '\0') return -1;
+   }
+   return n;
+}
 
-    optregister(outfile,CSTRING,'O',"Name of output data file");  
-    optregister(N,INT,'n',"Approximate number of heart beats");    
-    optregister(sfecg,INT,'s',"ECG sampling frequency [Hz]");   
-    optregister(sf,INT,'S',"Internal Sampling frequency [Hz]"); 
-    optregister(Anoise,DOUBLE,'a',"Amplitude of additive uniform noise [mV]");
-    optregister(hrmean,DOUBLE,'h',"Heart rate mean [bpm]");
-    optregister(hrstd,DOUBLE,'H',"Heart rate standard deviation [bpm]");
-    optregister(flo,DOUBLE,'f',"Low frequency [Hz]");
-    optregister(fhi,DOUBLE,'F',"High frequency [Hz]");
-    optregister(flostd,DOUBLE,'v',"Low frequency standard deviation [Hz]");
-    optregister(fhistd,DOUBLE,'V',"High frequency standard deviation [Hz]");
-    optregister(lfhfratio,DOUBLE,'q',"LF/HF ratio");
-    optregister(seed,INT,'R',"Seed");    
-    opt_title_set("ECGSYN: A program for generating a realistic synthetic ECG\n" 
-     "Copyright (c) 2003 by Patrick McSharry & Gari Clifford. All rights reserved.\n");
+/* Every rate gets the output of a run with -s fs at the same -S: the same
+   labelling and scaling, and the noise of a run of its own. */
+void dorates()
+{
+   long i;
+   int k,nr,fmt;
+   double zmin,zmax,zrange;
+   char name[200];
+   const char *msg;
+   outrate r[MAXRATES];
+   genparams p;
+   gen g;
+   long rseed;
+   ran1state rng;
+   sink out;
+
+   getparams(&p);
+   nr = parserates(r);
+   if(nr < 1) {
+     fprintf(stderr,"Invalid list of output rates: %s\n",ratelist);
+     exit(1);}
+   p.sfecg = resampled ? p.sf : r[0].fs;
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     exit(1);}
+   for(k=0;k<nr && !resampled;k++)
+     if(sf % r[k].fs != 0) {
+       fprintf(stderr,"Internal sampling frequency %d Hz is not a multiple of "
+               "the output rate %d Hz\n",sf,r[k].fs);
+       exit(1);}
+   fmt = sink_format(outformat);
+   if(fmt < 0 || blocksize < 1) {
+     fprintf(stderr,"Invalid output format or block size\n");
+     exit(1);}
+   if((outfile[0] == '-' && outfile[1] == '\0') || realtime || leads12
+      || shmname[0] != '\0') {
+     fprintf(stderr,"Several rates are written to files only (no -O -, -r, -l or -M)\n");
+     exit(1);}
 
-    getopts(argc,argv);
+   banner();
 
-    dorun();
-}
+   if(gen_init(&g, &p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   fprintf(stderr,"Using %ld = 2^%d samples for calculating RR intervals\n",
+           g.Nrr,(int)(log10(1.0*g.Nrr)/log10(2.0)));
+   vecfile("rr.dat",g.rr,g.Nrr);
 
+   for(k=0;k<nr;k++)
+     if(outrate_init(&r[k], r[k].fs, &g, resampled) != 0) {
+       fprintf(stderr,"Cannot set up the output rate of %d Hz\n",r[k].fs);
+       exit(1);}
 
+   /* integrate once, downsample to every rate on the fly */
+   for(i=1;i<=g.Nt;i++)
+   {
+      for(k=0;k<nr;k++) outrate_push(&r[k], g.x, i, g.Nt);
+      gen_step(&g);
+   }
+   rseed = g.rseed;
+   rng = g.rng;
+
+   for(k=0;k<nr;k++)
+   {
+      /* the labeller's correction window depends on the rate */
+      g.p.sfecg = r[k].fs;
+      detectpeaks(&g, r[k].ipeak, r[k].x, r[k].y, r[k].z, r[k].n);
+
+      /* scale signal to lie between -0.4 and 1.2 mV */
+      zmin = r[k].z[1];
+      zmax = r[k].z[1];
+      for(i=2;i<=r[k].n;i++)
+      {
+        if(r[k].z[i] < zmin)       zmin = r[k].z[i];
+        else if(r[k].z[i] > zmax)  zmax = r[k].z[i];
+      }
+      zrange = zmax-zmin;
+      for(i=1;i<=r[k].n;i++) r[k].z[i] = (r[k].z[i]-zmin)*(1.6)/zrange - 0.4;
+
+      g.rseed = rseed;
+      g.rng = rng;
+      for(i=1;i<=r[k].n;i++) 
+        r[k].z[i] += Anoise*(2.0*ran1_r(&g.rseed,&g.rng) - 1.0);
+
+      varfile(name, "%dhz", r[k].fs);
+      fprintf(stderr,"Printing ECG signal at %d Hertz to file: %s\n",
+              r[k].fs,name);
+      if(sink_open(&out, name, fmt, 1.0/r[k].fs, blocksize) != 0) {
+        fprintf(stderr,"Cannot open output file: %s\n",name);
+        exit(1);}
+      for(i=1;i<=r[k].n;i+=blocksize)
+        if(sink_write(&out, r[k].z+i, r[k].ipeak+i, 
+                      MIN(blocksize,r[k].n-i+1)) != 0) {
+          fprintf(stderr,"Error writing ECG output\n");
+          exit(1);}
+      sink_close(&out);
+   }
+
+   fprintf(stderr,"Finished ECG output\n");
+
+for(k=0;k<nr;k++) outrate_free(&r[k]);
+gen_free(&g);
+
+/* END OF DORATES */
+}
 
 /*--------------------------------------------------------------------------*/
-/*    DORUN PART OF PROGRAM                                                 */
+/*    STREAMED PART OF PROGRAM                                              */
 /*--------------------------------------------------------------------------*/
 
-int dorun()
+/* A checkpoint file is one text line "ecgsyn-ckpt 1 <format> <samples> 
+   <bytes> <size>" with the position of the output, then the gen_save() blob
+   of <size> bytes. It is replaced atomically (written to name.tmp, then 
+   renamed), so a run killed at any point leaves the previous one intact. */
+#define CKPT_VERSION 1
+
+void savecheckpoint(gen *g, sink *out)
 {
-   int i,j,k,q,Nrr,Nt,Nts;
-   double *x,tstep,tecg,rrmean,qd,hrfact,hrfact2;
-   double *xt,*yt,*zt,*xts,*yts,*zts;
-   double timev,*ipeak,zmin,zmax,zrange;
+   char tmp[200];
+   long size;
+   unsigned char *blob;
    FILE *fp;
-   void (*derivs)(double, double [], double []);
 
-   /* perform some checks on input values */
-   q = (int)rint(sf/sfecg);
-   qd = (double)sf/(double)sfecg;
-   if(q != qd) {
-     printf("Internal sampling frequency must be an integer multiple of the \n"); 
-     printf("ECG sampling frequency!\n"); 
-     printf("Your current choices are:\n");
-     printf("ECG sampling frequency: %d Hertz\n",sfecg);
-     printf("Internal sampling frequency: %d Hertz\n",sf);
-     exit(1);}
-
-
-   /* declare and initialise the state vector */
-   x=mallocVect(1,mstate);
-   x[1] = xinitial; 
-   x[2] = yinitial;
-   x[3] = zinitial;
-
-   /* declare and define the ECG morphology vectors (PQRST extrema parameters) */
-   ti=mallocVect(1,5);
-   ai=mallocVect(1,5);
-   bi=mallocVect(1,5);
-   /* P            Q            R           S           T        */
-   ti[1]=-60.0; ti[2]=-15.0; ti[3]=0.0;  ti[4]=15.0; ti[5]=90.0;
-   ai[1]=1.2;   ai[2]=-5.0;  ai[3]=30.0; ai[4]=-7.5; ai[5]=0.75;
-   bi[1]=0.25;  bi[2]=0.1;   bi[3]=0.1;  bi[4]=0.1;  bi[5]=0.4;
-
-   /* convert angles from degrees to radians */
-   for(i=1;i<=5;i++) ti[i] *= PI/180.0;
-
-   /* adjust extrema parameters for mean heart rate */
-   hrfact = sqrt(hrmean/60.0);
-   hrfact2 = sqrt(hrfact);
-   for(i=1;i<=5;i++) bi[i] *= hrfact;
-   ti[1]*=hrfact2;  ti[2]*=hrfact; ti[3]*=1.0; ti[4]*=hrfact; ti[5]*=1.0;
+   size = gen_save(g, NULL, 0);
+   blob = (unsigned char *)malloc(size);
+   if(!blob || gen_save(g, blob, size) != size) {
+     fprintf(stderr,"Cannot save the generator state\n");
+     exit(1);}
+   sprintf(tmp,"%s.tmp",ckptfile);
+   fp = fopen(tmp,"wb");
+   if(!fp 
+      || fprintf(fp,"ecgsyn-ckpt %d %d %ld %ld %ld\n",CKPT_VERSION,
+                 out->format,out->nsamples,out->nbytes,size) < 0
+      || fwrite(blob,1,size,fp) != (size_t)size
+      || fflush(fp) != 0 || fsync(fileno(fp)) != 0 || fclose(fp) != 0
+      || rename(tmp,ckptfile) != 0) {
+     fprintf(stderr,"Cannot write checkpoint file: %s\n",ckptfile);
+     exit(1);}
+   free(blob);
+}
 
+/* restore g from restorefile and reopen the output where it stood */
+void loadcheckpoint(gen *g, sink *out)
+{
+   int version,fmt;
+   long nsamples,nbytes,size;
+   unsigned char *blob;
+   FILE *fp;
 
-   /* calculate time scales */
-   h = 1.0/sf;
-   tstep = 1.0/sfecg;
+   fp = fopen(restorefile,"rb");
+   if(!fp || fscanf(fp,"ecgsyn-ckpt %d %d %ld %ld %ld",&version,&fmt,
+                    &nsamples,&nbytes,&size) != 5 
+      || version != CKPT_VERSION || size < 1 || fgetc(fp) != '\n') {
+     fprintf(stderr,"Not a checkpoint file: %s\n",restorefile);
+     exit(1);}
+   blob = (unsigned char *)malloc(size);
+   if(!blob || fread(blob,1,size,fp) != (size_t)size 
+      || gen_restore(g, blob, size) != 0) {
+     fprintf(stderr,"Damaged checkpoint, or from another version or build: %s\n",
+             restorefile);
+     exit(1);}
+   free(blob);
+   fclose(fp);
 
-   printf("ECGSYN: A program for generating a realistic synthetic ECG\n" 
-    "Copyright (c) 2003 by Patrick McSharry & Gari Clifford. All rights reserved.\n"
-    "See IEEE Transactions On Biomedical Engineering, 50(3), 289-294, March 2003.\n"
-    "Contact P. McSharry (patrick@mcsharry.net) or G. Clifford (gari@mit.edu)\n"); 
+   /* the output position must be one the sink can have written: a known
+      format, and as many bytes as its records of nsamples take */
+   if(fmt < SINK_TXT || fmt > SINK_I16 || nsamples < 0 || nsamples > g->Nt
+      || (fmt == SINK_F32 && nbytes != 8*nsamples)
+      || (fmt == SINK_I16 && nbytes != 4*nsamples)
+      || (fmt == SINK_TXT && (nbytes < nsamples 
+                              || nbytes > (SINK_MAXREC-1)*nsamples))) {
+     fprintf(stderr,"Damaged checkpoint, invalid output position: %s\n",
+             restorefile);
+     exit(1);}
+   if(sink_resume(out, outfile, fmt, 1.0/g->p.sfecg, blocksize, 
+                  nsamples, nbytes) != 0) {
+     fprintf(stderr,"Cannot continue output file: %s\n",outfile);
+     exit(1);}
+   fprintf(stderr,"Continuing at sample %ld from checkpoint %s\n",
+           nsamples,restorefile);
+}
+
+/* -N: GEN_NORM_* of gen.h, or the exact range from a temporary file */
+#define NORM_TWOPASS 3
+
+int normof(const char *name)
+{
+   if(name[0] == '\0' || strcmp(name,"exact") == 0) return GEN_NORM_PRESCAN;
+   if(strcmp(name,"template") == 0) return GEN_NORM_TEMPLATE;
+   if(strcmp(name,"bound") == 0)    return GEN_NORM_BOUND;
+   if(strcmp(name,"twopass") == 0)  return NORM_TWOPASS;
+   return -1;
+}
+
+/* Exact scaling with a single integration: the raw output goes block by 
+   block to an unlinked temporary file, whose range is that of the whole
+   record; the file is then mapped read-only, scaled and written out. Only
+   the page cache holds the record, not the heap. */
+void twopass(gen *g, sink *out, double *z, double *ipeak, rtpace *pace)
+{
+   FILE *fp;
+   double *raw,zmin,zmax;
+   long nout,i,page,done,upto;
+   int n,j;
+
+   fp = tmpfile();
+   if(!fp) {
+     fprintf(stderr,"Cannot create a temporary file\n");
+     exit(1);}
+   nout = 0;
+   zmin = zmax = 0.0;
+   while((n = gen_raw(g, z, ipeak, blocksize)) > 0)
+   {
+      if(nout == 0) zmin = zmax = z[0];
+      for(j=0;j<n;j++)
+      {
+         if(z[j] < zmin)       zmin = z[j];
+         else if(z[j] > zmax)  zmax = z[j];
+      }
+      if(fwrite(z,sizeof(double),n,fp) != (size_t)n 
+         || fwrite(ipeak,sizeof(double),n,fp) != (size_t)n) {
+        fprintf(stderr,"Error writing the temporary file\n");
+        exit(1);}
+      nout += n;
+   }
+   if(fflush(fp) != 0) {
+     fprintf(stderr,"Error writing the temporary file\n");
+     exit(1);}
+   g->zmin = zmin;
+   g->zrange = zmax-zmin;
+   if(nout == 0) {
+     fclose(fp);
+     return;}
+
+   /* block i holds n raw z followed by their n labels */
+   raw = (double *)mmap(NULL, 2*nout*sizeof(double), PROT_READ, MAP_PRIVATE,
+                        fileno(fp), 0);
+   if(raw == MAP_FAILED) {
+     fprintf(stderr,"Cannot map the temporary file\n");
+     exit(1);}
+   madvise(raw, 2*nout*sizeof(double), MADV_SEQUENTIAL);
+   page = sysconf(_SC_PAGESIZE);
+   done = 0;
+   if(realtime) rtpace_start(pace, blocksize, g->p.sfecg);
+   for(i=0;i<nout;i+=blocksize)
+   {
+      n = MIN(blocksize,nout-i);
+      memcpy(z, raw+2*i, n*sizeof(double));
+      memcpy(ipeak, raw+2*i+n, n*sizeof(double));
+      gen_scale(g, z, n);
+      if(realtime) rtpace_wait(pace);
+      if(sink_write(out, z, ipeak, n) != 0) {
+        fprintf(stderr,"Error writing ECG output\n");
+        exit(1);}
+
+      /* drop the pages read from the mapping, to keep them out of the
+         resident memory (they stay in the page cache) */
+      upto = (2*(i+n)*(long)sizeof(double))/page*page;
+      if(upto-done >= 256*page)
+      {
+         madvise((char *)raw+done, upto-done, MADV_DONTNEED);
+         done = upto;
+      }
+   }
+   munmap(raw, 2*nout*sizeof(double));
+   fclose(fp);
+}
 
-   printf("Approximate number of heart beats: %d\n",N);
-   printf("ECG sampling frequency: %d Hertz\n",sfecg);
-   printf("Internal sampling frequency: %d Hertz\n",sf);
-   printf("Amplitude of additive uniformly distributed noise: %g mV\n",Anoise);
-   printf("Heart rate mean: %g beats per minute\n",hrmean);
-   printf("Heart rate std: %g beats per minute\n",hrstd);
-   printf("Low frequency: %g Hertz\n",flo);
-   printf("High frequency std: %g Hertz\n",fhistd);
-   printf("Low frequency std: %g Hertz\n",flostd);
-   printf("High frequency: %g Hertz\n",fhi);
-   printf("LF/HF ratio: %g\n",lfhfratio);
+/* The record is produced by gen_block(), as a stream, without keeping it in
+   memory. Its range comes from -N; with -K the generator is saved after 
+   every block, and -c continues such a run bit for bit. */
+void dostream()
+{
+   int n,fmt,norm;
+   double *z,*ipeak;
+   const char *msg;
+   genparams p;
+   gen g;
+   sink out;
+   rtpace pace;
+
+   if(blocksize < 1 || leads12 || shmname[0] != '\0' || resampled 
+      || nthreads > 1) {
+     fprintf(stderr,"Streamed runs need a block size and no -l, -M, -x or -j\n");
+     exit(1);}
+   norm = normof(normmode);
+   if(norm < 0) {
+     fprintf(stderr,"Unknown range: %s (use exact, twopass, template or bound)\n",
+             normmode);
+     exit(1);}
+   if(norm == NORM_TWOPASS && (ckptfile[0] != '\0' || restorefile[0] != '\0')) {
+     fprintf(stderr,"Checkpoints do not combine with -N twopass\n");
+     exit(1);}
 
-   /* initialise seed */
-   rseed = -seed;  
+   if(restorefile[0] != '\0') loadcheckpoint(&g, &out);
+   else
+   {
+      getparams(&p);
+      if((msg = gen_check(&p)) != NULL) {
+        fprintf(stderr,"%s!\n",msg);
+        exit(1);}
+      fmt = sink_format(outformat);
+      if(fmt < 0) {
+        fprintf(stderr,"Unknown output format: %s (use txt, f32 or i16)\n",
+                outformat);
+        exit(1);}
+      banner();
+      if(gen_init(&g, &p) != 0) {
+        fprintf(stderr,"Cannot initialise the ECG generator\n");
+        exit(1);}
+      vecfile("rr.dat",g.rr,g.Nrr);
+
+      /* the amplitude range comes first, except in two passes */
+      if(norm != NORM_TWOPASS) gen_range(&g, norm);
+      if(sink_open(&out, outfile, fmt, 1.0/sfecg, blocksize) != 0) {
+        fprintf(stderr,"Cannot open output file: %s\n",outfile);
+        exit(1);}
+   }
+   if(ckptfile[0] != '\0')
+     fprintf(stderr,"Saving checkpoints to %s\n",ckptfile);
 
+   z = (double *)malloc(blocksize*sizeof(double));
+   ipeak = (double *)malloc(blocksize*sizeof(double));
+   if(!z || !ipeak) {
+     fprintf(stderr,"Out of memory\n");
+     exit(1);}
+   if(norm == NORM_TWOPASS) twopass(&g, &out, z, ipeak, &pace);
+   else
+   {
+      if(realtime) rtpace_start(&pace, blocksize, g.p.sfecg);
+      while((n = gen_block(&g, z, ipeak, blocksize)) > 0)
+      {
+         if(realtime) rtpace_wait(&pace);
+         if(sink_write(&out, z, ipeak, n) != 0 
+            || (ckptfile[0] != '\0' && fflush(out.fp) != 0)) {
+           fprintf(stderr,"Error writing ECG output\n");
+           exit(1);}
+         if(ckptfile[0] != '\0') savecheckpoint(&g, &out);
+      }
+   }
+   sink_close(&out);
+   if(realtime) rtpace_report(&pace, stderr);
+   fprintf(stderr,"Finished ECG output\n");
 
-   /* select the derivs to use */
-   derivs = derivspqrst;
+free(z);
+free(ipeak);
+gen_free(&g);
 
-   /* calculate length of RR time series */
-   rrmean = (60/hrmean);
-   Nrr = (int)pow(2.0, ceil(log10(N*rrmean*sf)/log10(2.0)));	 
-   printf("Using %d = 2^%d samples for calculating RR intervals\n",
-           Nrr,(int)(log10(1.0*Nrr)/log10(2.0))); 
+/* END OF DOSTREAM */
+}
 
+/*--------------------------------------------------------------------------*/
+/*    MEMORY PLAN                                                           */
+/*--------------------------------------------------------------------------*/
 
-   /* create rrprocess with required spectrum */
-   rr = mallocVect(1,Nrr);
-   rrprocess(rr, flo, fhi, flostd, fhistd, lfhfratio, hrmean, hrstd, sf, Nrr); 
-   vecfile("rr.dat",rr,Nrr);
+/* Resident memory besides the buffers of the record (code, libc, stdio) */
+#define PLAN_BASE_MB 3.0
+#define PLAN_MAXDIV  256
+
+/* A way to produce the single-lead record, with its estimated peak memory
+   and run time. The whole-record run keeps x, y for the peak detection; the
+   streamed ones label on the fly and keep nothing. */
+typedef struct plan {
+  const char *name;    // description
+  const char *norm;    // -N of the streamed run, "" for the whole record
+  int rrdiv;           // RR process at sf/rrdiv
+  int exact;           // output identical to the default run
+  double mb;           // peak resident memory [MB]
+  double sec;          // run time [s]
+} plan;
+
+/* Cost of the parts of a run, measured on a short record with the same
+   parameters: an integration step, the RR synthesis per n log2 n, the 
+   streaming labeller and the output of a sample and a line of text (rr.dat,
+   rrpc.dat) [s]. */
+void calibrate(const genparams *p0, int fmt, double *tstep, double *tfft,
+               double *tout, double *ttxt, double *tlab)
+{
+   int i,n,m;
+   double *z;
+   char *buf;
+   clock_t c0;
+   genparams p;
+   gen g;
+
+   p = *p0;
+   p.N = 16;
+   c0 = clock();
+   if(gen_init(&g, &p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   *tfft = (double)(clock()-c0)/CLOCKS_PER_SEC/(g.Nrr*log2(g.Nrr));
+   n = MIN(g.Nt,20000);
+   c0 = clock();
+   for(i=0;i<n;i++) gen_step(&g);
+   *tstep = (double)(clock()-c0)/CLOCKS_PER_SEC/n;
+
+   z = arena_vect(g.mem,0,1023);
+   buf = (char *)arena_alloc(g.mem, 1024*SINK_MAXREC);
+   for(i=0;i<1024;i++) z[i] = 0.001*i;
+   c0 = clock();
+   for(i=0;i<16;i++) sink_pack(fmt, 1.0/p.sfecg, 0, z, z, 1024, buf);
+   *tout = (double)(clock()-c0)/CLOCKS_PER_SEC/(16*1024);
+   c0 = clock();
+   for(i=0;i<16;i++) sink_pack(SINK_TXT, 1.0/p.sfecg, 0, z, z, 1024, buf);
+   *ttxt = (double)(clock()-c0)/CLOCKS_PER_SEC/(16*1024);
+   gen_free(&g);
+
+   /* the streamed run of the whole short record, less its steps */
+   gen_init(&g, &p);
+   z = arena_vect(g.mem,0,2*1024-1);
+   m = 0;
+   c0 = clock();
+   while((n = gen_raw(&g, z, z+1024, 1024)) > 0) m += n;
+   *tlab = (double)(clock()-c0)/CLOCKS_PER_SEC;
+   *tlab = MAX(0.0, *tlab - g.Nt**tstep)/MAX(m,1);
+   gen_free(&g);
+}
 
-   /* create piecewise constant rr */
-   rrpc = mallocVect(1,2*Nrr);
-   tecg = 0.0;
-   i = 1;
-   j = 1;
-   while(i <= Nrr)
-   {  
-      tecg += rr[j];
-      j = (int)rint(tecg/h);
-      for(k=i;k<=j;k++) rrpc[k] = rr[i];
-      i = j+1;
+/* peak memory [MB] and run time [s] of pl for the parameters p */
+void planfor(plan *pl, const genparams *p, double tstep, double tfft,
+             double tout, double ttxt, double tlab)
+{
+   double n,nr,nt,nts,syn,run,blk;
+
+   n = gen_nrr(p);
+   nr = n/pl->rrdiv;
+   nt = MIN(n, p->N*60.0/p->hrmean*p->sf);
+   nts = nt/(p->sf/p->sfecg);
+   blk = (double)blocksize*(SINK_MAXREC+3*sizeof(double));
+
+   /* RR synthesis: the process, its FFT scratch space (six vectors, 52 
+      bytes per sample) and, at a lower rate, the process before the 
+      interpolation */
+   syn = 8*n + 52*nr + (pl->rrdiv > 1 ? 8*nr : 0);
+#ifdef ECGSYN_FIXED
+   n += n;                              /* rrq */
+#endif
+   if(pl->norm[0] == '\0')
+   {
+      /* then rrpc, then x, y, z and labels of the whole record */
+      run = MAX(8*n + 16*n, 8*n + 32*nts + blk);
+      pl->sec = tfft*n*log2(n) + tstep*nt + tout*nts + ttxt*(n+nt);
    }
-   Nt = j;
-   vecfile("rrpc.dat",rrpc,Nt);
+   else
+   {
+      run = 8*n + blk;
+      pl->sec = tfft*nr*log2(nr) + tstep*nt + (tout+tlab)*nts + ttxt*n;
+      if(strcmp(pl->norm,"exact") == 0) pl->sec += tstep*nt;
+   }
+   pl->mb = PLAN_BASE_MB + MAX(syn,run)/1048576.0 + ARENA_HUGE/1048576.0;
+}
 
-   printf("Printing ECG signal to file: %s\n",outfile);
+/* -m: pick the first way of producing the record that fits into maxmem MB,
+   preferring the ones with the output of the default run, and run it */
+void doplan()
+{
+   plan cand[3+16];
+   genparams p;
+   struct rusage ru;
+   double tstep,tfft,tout,ttxt,tlab;
+   const char *msg;
+   int i,nc,best,div,fmt;
+
+   if(leads12 || sweepfile[0] != '\0' || ratelist[0] != '\0' || resampled
+      || nthreads > 1 || accuracy || steperror || normmode[0] != '\0'
+      || ckptfile[0] != '\0' || restorefile[0] != '\0') {
+     fprintf(stderr,"-m plans the plain single-lead run only\n");
+     exit(1);}
+   getparams(&p);
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     exit(1);}
+   fmt = sink_format(outformat);
+   if(fmt < 0 || blocksize < 1) {
+     fprintf(stderr,"Invalid output format or block size\n");
+     exit(1);}
 
-   /* integrate dynamical system using fourth order Runge-Kutta*/
-   xt = mallocVect(1,Nt);
-   yt = mallocVect(1,Nt);
-   zt = mallocVect(1,Nt);
+   nc = 0;
+   cand[nc].name = "whole record, x/y kept";
+   cand[nc].norm = "";          cand[nc].rrdiv = 1; cand[nc++].exact = 1;
+   cand[nc].name = "streamed, two passes over a temporary file";
+   cand[nc].norm = "twopass";   cand[nc].rrdiv = 1; cand[nc++].exact = 1;
+   cand[nc].name = "streamed, integrated twice";
+   cand[nc].norm = "exact";     cand[nc].rrdiv = 1; cand[nc++].exact = 1;
+   for(div=2;div<=PLAN_MAXDIV;div*=2)
+   {
+      cand[nc].name = "streamed, two passes, RR synthesised at sf/";
+      cand[nc].norm = "twopass"; cand[nc].rrdiv = div; cand[nc++].exact = 0;
+   }
 
-   timev = 0.0;
-   for(i=1;i<=Nt;i++)
+   calibrate(&p, fmt, &tstep, &tfft, &tout, &ttxt, &tlab);
+   best = -1;
+   for(i=0;i<nc;i++)
    {
-      xt[i] = x[1];
-      yt[i] = x[2];
-      zt[i] = x[3];
-      drk4(x, mstate, timev, h, x, derivs);
-      timev += h;
+      planfor(&cand[i], &p, tstep, tfft, tout, ttxt, tlab);
+      if(best < 0 && cand[i].mb <= maxmem) best = i;
    }
 
+   fprintf(stderr,"Memory plan for %g MB (estimated peak resident memory "
+           "and run time):\n",maxmem);
+   for(i=0;i<nc;i++)
+   {
+      if(i > 3 && i != best) continue;
+      fprintf(stderr,"  %c %8.1f MB %8.1f s  %s",i == best ? '*' : ' ',
+              cand[i].mb,cand[i].sec,cand[i].name);
+      if(cand[i].rrdiv > 1) fprintf(stderr,"%d",cand[i].rrdiv);
+      fprintf(stderr,"%s\n",cand[i].exact ? "" : " (another RR realisation)");
+   }
+   if(best < 0) {
+     fprintf(stderr,"The record does not fit into %g MB: it needs at least "
+             "%.1f MB (-n %d at -s %d)\n",maxmem,cand[nc-1].mb,N,sf);
+     exit(1);}
+
+   strcpy(normmode, cand[best].norm);
+   rrdiv = cand[best].rrdiv;
+   if(normmode[0] == '\0') dorun();
+   else                     dostream();
+
+   getrusage(RUSAGE_SELF, &ru);
+   fprintf(stderr,"Peak resident memory: %.1f MB (planned %.1f MB)\n",
+           ru.ru_maxrss/1024.0,cand[best].mb);
+
+/* END OF DOPLAN */
+}
+
+/*--------------------------------------------------------------------------*/
+/*    ACCURACY PART OF PROGRAM                                              */
+/*--------------------------------------------------------------------------*/
+
+/* Budget of the float path: one step of the i16 output (1 uV) and no moved
+   peak labels. */
+#define BUDGET_MV    0.001
+#define BUDGET_SHIFT 0
+
+/* scaled noise-free ECG and peak labels of the record at precision prec */
+long record(genparams *p, int prec, double **zts, double **ipeak)
+{
+   long i,j,Nts;
+   double *xts,*yts,zmin,zmax,zrange;
+   gen g;
 
-   /* downsample to ECG sampling frequency */
-   xts = mallocVect(1,Nt);
-   yts = mallocVect(1,Nt);
-   zts = mallocVect(1,Nt);
+   p->prec = prec;
+   if(gen_init(&g, p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   Nts = (g.Nt+g.q-1)/g.q;
+   xts = mallocVect(1,Nts);
+   yts = mallocVect(1,Nts);
+   *zts = mallocVect(1,Nts);
+   *ipeak = mallocVect(1,Nts);
 
    j=0;
-   for(i=1;i<=Nt;i+=q)
-   { 
-      j++;
-      xts[j] = xt[i];
-      yts[j] = yt[i];
-      zts[j] = zt[i];
+   for(i=1;i<=g.Nt;i++)
+   {
+      if((i-1)%g.q == 0)
+      {
+         j++;
+         xts[j] = g.x[1];
+         yts[j] = g.x[2];
+         (*zts)[j] = g.x[3];
+      }
+      gen_step(&g);
    }
-   Nts = j;
-
+   detectpeaks(&g, *ipeak, xts, yts, *zts, Nts);
 
-   /* do peak detection using angle */
-   ipeak = mallocVect(1,Nts);
-   detectpeaks(ipeak, xts, yts, zts, Nts);
- 
-   /* scale signal to lie between -0.4 and 1.2 mV */
-   zmin = zts[1];
-   zmax = zts[1];
+   zmin = zmax = (*zts)[1];
    for(i=2;i<=Nts;i++)
    {
-     if(zts[i] < zmin)       zmin = zts[i];
-     else if(zts[i] > zmax)  zmax = zts[i];
+     if((*zts)[i] < zmin)       zmin = (*zts)[i];
+     else if((*zts)[i] > zmax)  zmax = (*zts)[i];
    }
    zrange = zmax-zmin;
-   for(i=1;i<=Nts;i++) zts[i] = (zts[i]-zmin)*(1.6)/zrange - 0.4;
+   for(i=1;i<=Nts;i++) (*zts)[i] = ((*zts)[i]-zmin)*(1.6)/zrange - 0.4;
 
-   /* include additive uniformly distributed measurement noise */
-   for(i=1;i<=Nts;i++) zts[i] += Anoise*(2.0*ran1(&rseed) - 1.0);    
+   freeVect(xts,1,Nts);
+   freeVect(yts,1,Nts);
+   gen_free(&g);
+   return Nts;
+}
 
-   /* output ECG file */
-   fp = fopen(outfile,"w");
-   for(i=1;i<=Nts;i++) fprintf(fp,"%f %f %d\n",(i-1)*tstep,zts[i],(int)ipeak[i]);
-   fclose(fp);
+void doaccuracy()
+{
+   long i,n,nd,nf,nlab,nmoved,nlost;
+   int j,d,found,maxshift;
+   double *zd,*zf,*ld,*lf,dev,maxdev,sumsq;
+   const char *msg;
+   genparams p;
+
+   getparams(&p);
+   p.prec = GEN_FLOAT;
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     exit(1);}
+   banner();
+   fprintf(stderr,"Comparing float with double integration\n");
+
+   nd = record(&p, GEN_DOUBLE, &zd, &ld);
+   nf = record(&p, GEN_FLOAT, &zf, &lf);
+   n = MIN(nd,nf);
+
+   /* voltage deviation */
+   maxdev = 0.0;
+   sumsq = 0.0;
+   for(i=1;i<=n;i++)
+   {
+      dev = fabs(zf[i]-zd[i]);
+      if(dev > maxdev) maxdev = dev;
+      sumsq += dev*dev;
+   }
+
+   /* peak labels: the same label within the correction window */
+   d = (int)ceil(sfecg/64);
+   nlab = nmoved = nlost = maxshift = 0;
+   for(i=1;i<=n;i++)
+   {
+      if(ld[i] == 0.0) continue;
+      nlab++;
+      found = 0;
+      for(j=0;j<=d && !found;j++)
+      {
+         if(i+j <= n && lf[i+j] == ld[i])      found = 1;
+         else if(i-j >= 1 && lf[i-j] == ld[i]) found = 1;
+      }
+      if(!found)       nlost++;
+      else if(j-1 > 0) nmoved++;
+      if(found && j-1 > maxshift) maxshift = j-1;
+   }
 
+   printf("samples            %ld (float %ld)\n",nd,nf);
+   printf("max deviation      %.6f mV (budget %.6f mV)\n",maxdev,BUDGET_MV);
+   printf("rms deviation      %.6f mV\n",n > 0 ? sqrt(sumsq/n) : 0.0);
+   printf("peak labels        %ld\n",nlab);
+   printf("labels moved       %ld (max %d samples, budget %d)\n",
+          nmoved,maxshift,BUDGET_SHIFT);
+   printf("labels lost        %ld\n",nlost);
+
+   freeVect(zd,1,nd);
+   freeVect(ld,1,nd);
+   freeVect(zf,1,nf);
+   freeVect(lf,1,nf);
+
+   if(nd != nf || maxdev > BUDGET_MV || maxshift > BUDGET_SHIFT || nlost > 0) {
+     printf("float precision EXCEEDS the budget\n");
+     exit(1);}
+   printf("float precision within budget\n");
+   exit(0);
+}
 
-   printf("Finished ECG output\n");
+/*--------------------------------------------------------------------------*/
+/*    STEP SIZE PART OF PROGRAM                                             */
+/*--------------------------------------------------------------------------*/
 
-freeVect(x,1,mstate);
-freeVect(rr,1,Nrr);
-freeVect(rrpc,1,2*Nrr);
-freeVect(ti,1,5);
-freeVect(ai,1,5);
-freeVect(bi,1,5);
-freeVect(xt,1,Nt);
-freeVect(yt,1,Nt);
-freeVect(zt,1,Nt);
-freeVect(xts,1,Nt);
-freeVect(yts,1,Nt);
-freeVect(zts,1,Nt);
-freeVect(ipeak,1,Nts);
+/* The reference is rk4 at SF_REF, kept on the grid of the finest step size
+   under test. All runs share a constant heart rate, so that their RR process
+   does not depend on the sampling frequency. */
+#define SF_REF  16384
+#define SF_MIN  32
+#define SF_MAX  1024
+
+/* z[1..n] of the record at sampling frequency sf, every (sf/sfout)th step;
+   returns n and the cpu time per step [ns] */
+long steprun(genparams *p, int sf, int integ, int sfout, double **z, 
+             double *ns)
+{
+   long i,j;
+   int q;
+   clock_t c0;
+   gen g;
+
+   p->sf = sf;
+   p->sfecg = sf;
+   p->integ = integ;
+   if(gen_init(&g, p) != 0) {
+     fprintf(stderr,"Cannot initialise the ECG generator\n");
+     exit(1);}
+   q = sf/sfout;
+   *z = mallocVect(1,(g.Nt+q-1)/q);
 
-/* END OF DORUN */
+   j = 0;
+   c0 = clock();
+   for(i=1;i<=g.Nt;i++)
+   {
+      if((i-1)%q == 0) (*z)[++j] = g.x[3];
+      gen_step(&g);
+   }
+   *ns = 1e9*(clock()-c0)/CLOCKS_PER_SEC/g.Nt;
+   gen_free(&g);
+   return j;
 }
 
+void dosteperror()
+{
+   long i,j,n,nref;
+   int sfs,integ,r;
+   double *zref,*z,zmin,zmax,zrange,dev,maxdev[2],ns[2],nsref;
+   const char *msg;
+   genparams p;
+
+   getparams(&p);
+   p.hrstd = 0.0;
+   p.Anoise = 0.0;
+   p.prec = GEN_DOUBLE;
+   p.integ = GEN_RK4;
+   if((msg = gen_check(&p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     exit(1);}
+   banner();
+   fprintf(stderr,"Comparing rk4 and etd with rk4 at %d Hz, constant heart rate\n",
+           SF_REF);
+
+   nref = steprun(&p, SF_REF, GEN_RK4, SF_MAX, &zref, &nsref);
+   zmin = zmax = zref[1];
+   for(i=2;i<=nref;i++)
+   {
+      if(zref[i] < zmin) zmin = zref[i];
+      if(zref[i] > zmax) zmax = zref[i];
+   }
+   zrange = zmax-zmin;
+
+   /* deviation of the output scaled to -0.4..1.2 mV like dorun() */
+   printf("    sf   rk4 max [mV]   etd max [mV]   rk4 [ns/step]   etd [ns/step]\n");
+   for(sfs=SF_MIN;sfs<=SF_MAX;sfs*=2)
+   {
+      for(integ=0;integ<2;integ++)
+      {
+         n = steprun(&p, sfs, integ == 0 ? GEN_RK4 : GEN_ETD, sfs, &z, 
+                     &ns[integ]);
+         r = SF_MAX/sfs;
+         maxdev[integ] = 0.0;
+         for(i=1;i<=n;i++)
+         {
+            j = (i-1)*r+1;
+            if(j > nref) break;
+            dev = 1.6*fabs(z[i]-zref[j])/zrange;
+            if(!(dev <= maxdev[integ])) maxdev[integ] = dev;
+         }
+         freeVect(z,1,n);
+      }
+      printf("%6d   %12.6f   %12.6f   %13.1f   %13.1f\n",
+             sfs,maxdev[0],maxdev[1],ns[0],ns[1]);
+   }
+
+   freeVect(zref,1,nref);
+   exit(0);
+}
@@ -0,0 +1,1498 @@
+// "gen.c" - ECGSYN generator context.
+//
+// The dynamical model of McSharry et al. (2003) with its state gathered in a
+// `gen` context instead of global variables. The RR process is walked by a
+// cursor, so the piecewise constant rrpc series never has to be stored, and
+// gen_block() produces the final (scaled, noisy, labelled) ECG incrementally
+// in blocks of any size. The output of gen_block() is identical to the 
+// whole-record pipeline of dorun().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <complex.h>
+#include "gen.h"
+#include "gen_tpl.h"
+
+#define OFFSET 1
+#define ARG1 char*
+
+#define LOAD_ACQ(p)     __atomic_load_n(p,__ATOMIC_ACQUIRE)
+#define STORE_REL(p,v)  __atomic_store_n(p,v,__ATOMIC_RELEASE)
+
+static void gen_update(gen *g);
+
+/* RR interval at sample i, after any live change of hrmean or hrstd */
+#define RRAT(g,i) ((g)->rrscaled ? (g)->rra*(g)->rr[i] + (g)->rrb : (g)->rr[i])
+
+/*---------------------------------------------------------------------------*/
+/*      ALLOCATE MEMORY FOR VECTOR                                           */
+/*---------------------------------------------------------------------------*/
+
+double *mallocVect(long n0, long nx)
+{
+        double *vect;
+ 
+        vect=NULL;
+        if (nx >= n0-1 && (size_t)(nx-n0+1+OFFSET) <= SIZE_MAX/sizeof(double))
+          vect=(double *)malloc((size_t)(nx-n0+1+OFFSET)*sizeof(double));
+        if (!vect){
+	  fprintf(stderr,"Memory allocation failure in mallocVect");
+	  return NULL;
+	}
+        return vect-n0+OFFSET;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      FREE MEMORY FOR MALLOCVECT                                           */
+/*---------------------------------------------------------------------------*/
+ 
+void freeVect(double *vect, long n0, long nx)
+{
+        free((ARG1) (vect+n0-OFFSET));
+}
+
+/*---------------------------------------------------------------------------*/
+/*      MEAN CALCULATOR                                                      */
+/*---------------------------------------------------------------------------*/
+ 
+double mean(double *x, long n)
+/* n-by-1 vector, calculate mean */
+{
+        long j;
+        double add;
+ 
+        add = 0.0;
+        for(j=1;j<=n;j++)  add += x[j];
+ 
+        return (add/n);
+}
+
+
+/*---------------------------------------------------------------------------*/
+/*      STANDARD DEVIATION CALCULATOR                                        */
+/*---------------------------------------------------------------------------*/
+
+double stdev(double *x, long n)
+/* n-by-1 vector, calculate standard deviation */
+{
+        long j;
+        double add,mean,diff,total;
+
+        add = 0.0;
+        for(j=1;j<=n;j++)  add += x[j];
+        mean = add/n;
+
+        total = 0.0;
+        for(j=1;j<=n;j++)  
+        {
+           diff = x[j] - mean;
+           total += diff*diff;
+        } 
+  
+        return (sqrt(total/(n-1)));
+}
+
+/*--------------------------------------------------------------------------*/
+/*    INTERP                                                                */
+/*--------------------------------------------------------------------------*/
+
+void interp(double *y, double *x, long n, int r)
+{
+   long i;
+   int j;
+   double a;
+
+   for(i=1;i<=n-1;i++)
+   {
+      for(j=1;j<=r;j++) 
+      {
+         a = (j-1)*1.0/r;
+         y[(i-1)*r+j] = (1.0-a)*x[i] + a*x[i+1];
+      }
+   }
+}
+
+
+/*--------------------------------------------------------------------------*/
+/*    GENERATE RR PROCESS                                                   */
+/*--------------------------------------------------------------------------*/
+
+void rrprocess(gen *g, double *rr, double flo, double fhi, 
+double flostd, double fhistd, double lfhfratio,  
+double hrmean, double hrstd, double sf, long n)
+{
+   long i;
+   double c1,c2,w1,w2,sig1,sig2,rrmean,rrstd,xstd,ratio;
+   double df,dw1,dw2,*w,*Hw,*Sw,*ph0,*ph,*SwC;
+   arenamark mark;
+
+   /* FFT scratch space on top of the arena, released at the end */
+   mark = arena_mark(g->mem);
+   w = arena_vect(g->mem,1,n);
+   Hw = arena_vect(g->mem,1,n);
+   Sw = arena_vect(g->mem,1,n);
+   ph0 = arena_vect(g->mem,1,n/2-1);
+   ph = arena_vect(g->mem,1,n);
+   SwC = arena_vect(g->mem,1,2*n);
+
+
+   w1 = 2.0*PI*flo;
+   w2 = 2.0*PI*fhi;
+   c1 = 2.0*PI*flostd;
+   c2 = 2.0*PI*fhistd;
+   sig2 = 1.0;
+   sig1 = lfhfratio;
+   rrmean = 60.0/hrmean;
+   rrstd = 60.0*hrstd/(hrmean*hrmean);
+
+   df = sf/n;
+   for(i=1;i<=n;i++) w[i] = (i-1)*2.0*PI*df;
+   for(i=1;i<=n;i++) 
+   {
+      dw1 = w[i]-w1;
+      dw2 = w[i]-w2;
+      Hw[i] = sig1*exp(-dw1*dw1/(2.0*c1*c1))/sqrt(2*PI*c1*c1) 
+            + sig2*exp(-dw2*dw2/(2.0*c2*c2))/sqrt(2*PI*c2*c2); 
+   }
+   for(i=1;i<=n/2;i++) Sw[i] = (sf/2.0)*sqrt(Hw[i]);
+   for(i=n/2+1;i<=n;i++) Sw[i] = (sf/2.0)*sqrt(Hw[n-i+1]);
+
+
+   /* randomise the phases */
+   for(i=1;i<=n/2-1;i++) ph0[i] = 2.0*PI*ran1_r(&g->rseed,&g->rng);
+   ph[1] = 0.0;
+   for(i=1;i<=n/2-1;i++) ph[i+1] = ph0[i];
+   ph[n/2+1] = 0.0;
+   for(i=1;i<=n/2-1;i++) ph[n-i+1] = - ph0[i]; 
+
+
+   /* make complex spectrum */
+   for(i=1;i<=n;i++) SwC[2*i-1] = Sw[i]*cos(ph[i]);
+   for(i=1;i<=n;i++) SwC[2*i] = Sw[i]*sin(ph[i]);
+
+   /* calculate inverse fft */
+   dfour1(SwC,n,-1);
+
+   /* extract real part */
+   for(i=1;i<=n;i++) rr[i] = (1.0/n)*SwC[2*i-1];
+
+   xstd = stdev(rr,n);
+   ratio = rrstd/xstd; 
+
+   for(i=1;i<=n;i++) rr[i] *= ratio;
+   for(i=1;i<=n;i++) rr[i] += rrmean;
+
+   arena_release(g->mem, mark);
+}
+
+/*--------------------------------------------------------------------------*/
+/*    THE ANGULAR FREQUENCY                                                 */
+/*--------------------------------------------------------------------------*/
+
+double angfreq(gen *g, double t)
+{
+   long i;
+  
+   i = 1 + (long)floor(t/g->h);
+
+   /* advance the RR cursor to the beat holding sample i */
+   while(i > g->rrend && g->rrend < g->Nrr)
+   {
+      /* parameter updates take effect at the start of a beat */
+      if(LOAD_ACQ(&g->chan.head) != g->chan.tail) gen_update(g);
+
+      g->tecg += RRAT(g,g->rrend);
+      g->rrbeg = g->rrend+1;
+      g->rrend = lrint(g->tecg/g->h);
+      g->rrval = RRAT(g,g->rrbeg);
+   }
+  
+   return 2.0*PI/g->rrval;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    THE EXACT NONLINEAR DERIVATIVES                                       */
+/*--------------------------------------------------------------------------*/
+
+void derivspqrst(gen *g, double t0, double x[], double dxdt[])
+{
+   int i,k;
+   double a0,w0,r0,x0,y0,z0;
+   double t,dt,dt2,zbase;
+ 
+   k = g->k; 
+  
+   w0 = angfreq(g,t0);
+   r0 = 1.0; x0 = 0.0;  y0 = 0.0;  z0 = 0.0;
+   a0 = 1.0 - sqrt((x[1]-x0)*(x[1]-x0) + (x[2]-y0)*(x[2]-y0))/r0;
+
+   zbase = 0.005*sin(2.0*PI*g->p.fhi*t0);
+
+   t = atan2(x[2],x[1]);
+   dxdt[1] = a0*(x[1] - x0) - w0*(x[2] - y0);
+   dxdt[2] = a0*(x[2] - y0) + w0*(x[1] - x0); 
+   dxdt[3] = 0.0;  
+   for(i=1;i<=k;i++)  
+   {
+      dt = fmod(t-g->ti[i],2.0*PI);
+      dt2 = dt*dt;
+      dxdt[3] += -g->ai[i]*dt*exp(-0.5*dt2/(g->bi[i]*g->bi[i])); 
+   }
+   dxdt[3] += -1.0*(x[3] - zbase);
+}
+
+/*--------------------------------------------------------------------------*/
+/*    RUNGA-KUTTA FOURTH ORDER INTEGRATION                                  */
+/*--------------------------------------------------------------------------*/
+
+void drk4(gen *g, double y[], int n, double x, double h, double yout[], 
+          void (*derivs)(gen *, double, double [], double []))
+{
+        int i;
+        double xh,hh,h6,dydx[GEN_MAXN+1],dym[GEN_MAXN+1],dyt[GEN_MAXN+1];
+        double yt[GEN_MAXN+1];
+
+        hh=h*0.5;
+        h6=h/6.0;
+        xh=x+hh;
+        (*derivs)(g,x,y,dydx);
+        for (i=1;i<=n;i++) yt[i]=y[i]+hh*dydx[i];
+        (*derivs)(g,xh,yt,dyt);
+        for (i=1;i<=n;i++) yt[i]=y[i]+hh*dyt[i];
+        (*derivs)(g,xh,yt,dym);
+        for (i=1;i<=n;i++) {
+                yt[i]=y[i]+h*dym[i];
+                dym[i] += dyt[i];
+        }
+        (*derivs)(g,x+h,yt,dyt);
+        for (i=1;i<=n;i++)
+                yout[i]=y[i]+h6*(dydx[i]+dyt[i]+2.0*dym[i]);
+}
+
+/*--------------------------------------------------------------------------*/
+/*    EXPONENTIAL TIME DIFFERENCING                                         */
+/*--------------------------------------------------------------------------*/
+
+/* The model is split into a linear part L, integrated exactly, and the rest 
+   N: on the limit cycle x+iy rotates with L = i*w0 of the current beat and z
+   relaxes with L = -1; the limit cycle attraction, the change of w0 within a
+   step, the Gaussian forcing and the baseline wander are N. The scheme is
+   ETDRK4 of Cox & Matthews (2002). */
+
+#define ETD_M 32       // contour points of the phi functions
+
+/* E, E/2, Q, f1, f2, f3 of ETDRK4 for the linear part L and the step h */
+static void etd_coef(double complex L, double h, double complex c[6])
+{
+   int j;
+   double complex r,er,q,f1,f2,f3;
+
+   c[0] = cexp(L*h);
+   c[1] = cexp(L*h/2.0);
+   r = L*h;
+   if(cabs(r) >= 0.5)
+   {
+      /* closed forms, no cancellation away from zero */
+      er = c[0];
+      q  = (c[1]-1.0)/r;
+      f1 = (-4.0-r+er*(4.0-3.0*r+r*r))/(r*r*r);
+      f2 = (2.0+r+er*(r-2.0))/(r*r*r);
+      f3 = (-4.0-3.0*r-r*r+er*(4.0-r))/(r*r*r);
+   }
+   else
+   {
+      /* mean over a unit circle around Lh (Kassam & Trefethen, 2005) */
+      q = f1 = f2 = f3 = 0.0;
+      for(j=1;j<=ETD_M;j++)
+      {
+         r = L*h + cexp(2.0*PI*I*(j-0.5)/ETD_M);
+         er = cexp(r);
+         q  += (cexp(r/2.0)-1.0)/r;
+         f1 += (-4.0-r+er*(4.0-3.0*r+r*r))/(r*r*r);
+         f2 += (2.0+r+er*(r-2.0))/(r*r*r);
+         f3 += (-4.0-3.0*r-r*r+er*(4.0-r))/(r*r*r);
+      }
+      q /= ETD_M; f1 /= ETD_M; f2 /= ETD_M; f3 /= ETD_M;
+   }
+   c[2] = h*q;
+   c[3] = h*f1;
+   c[4] = h*f2;
+   c[5] = h*f3;
+}
+
+/* nonlinear part of the model at time t and state (u,z) */
+static void etd_nl(gen *g, double t, double complex u, double z, 
+                   double complex *nu, double *nz)
+{
+   double x[4],dxdt[4];
+
+   x[1] = creal(u);
+   x[2] = cimag(u);
+   x[3] = z;
+   derivspqrst(g,t,x,dxdt);
+   *nu = dxdt[1] + I*dxdt[2] - I*g->etdw*u;
+   *nz = dxdt[3] + z;
+}
+
+/* one ETDRK4 step of the state x[1..3] from t to t+h */
+void detdrk4(gen *g, double x[], double t, double h)
+{
+   int j;
+   double w,z,az,bz,cz,nz,naz,nbz,ncz;
+   double complex c[6],cu[6],u,a,b,cc,nu,na,nb,nc;
+
+   /* the rotation follows the beat at the start of the step */
+   w = angfreq(g,t);
+   if(w != g->etdw)
+   {
+      g->etdw = w;
+      etd_coef(I*w, h, cu);
+      for(j=0;j<6;j++)
+      {
+         g->etdu[j][0] = creal(cu[j]);
+         g->etdu[j][1] = cimag(cu[j]);
+      }
+      etd_coef(-1.0, h, c);
+      for(j=0;j<6;j++) g->etdz[j] = creal(c[j]);
+   }
+   for(j=0;j<6;j++) cu[j] = g->etdu[j][0] + I*g->etdu[j][1];
+
+   u = x[1] + I*x[2];
+   z = x[3];
+   etd_nl(g, t, u, z, &nu, &nz);
+   a  = cu[1]*u + cu[2]*nu;
+   az = g->etdz[1]*z + g->etdz[2]*nz;
+   etd_nl(g, t+h/2.0, a, az, &na, &naz);
+   b  = cu[1]*u + cu[2]*na;
+   bz = g->etdz[1]*z + g->etdz[2]*naz;
+   etd_nl(g, t+h/2.0, b, bz, &nb, &nbz);
+   cc = cu[1]*a + cu[2]*(2.0*nb-nu);
+   cz = g->etdz[1]*az + g->etdz[2]*(2.0*nbz-nz);
+   etd_nl(g, t+h, cc, cz, &nc, &ncz);
+
+   u = cu[0]*u + cu[3]*nu + 2.0*cu[4]*(na+nb) + cu[5]*nc;
+   x[1] = creal(u);
+   x[2] = cimag(u);
+   x[3] = g->etdz[0]*z + g->etdz[3]*nz + 2.0*g->etdz[4]*(naz+nbz) 
+        + g->etdz[5]*ncz;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    DETECT PEAKS                                                          */
+/*--------------------------------------------------------------------------*/
+
+void detectpeaks(gen *g, double *ipeak, double *x, double *y, double *z, 
+                 long n)
+{
+   long i,j,j1,j2,jext;
+   int m,d;
+   double theta1,theta2,d1,d2,zext;
+   
+   /* label the sample nearest to where the phase crosses each kernel angle */
+   for(i=1;i<=n;i++) ipeak[i] = 0.0;
+   theta1 = atan2(y[1],x[1]);
+   for(i=1;i<n;i++)
+   {
+      theta2 = atan2(y[i+1],x[i+1]);
+      for(m=1;m<=g->k;m++)
+      {
+         if( (theta1 <= g->ti[m]) && (g->ti[m] <= theta2) )  
+         {
+           d1 = g->ti[m] - theta1;
+           d2 = theta2 - g->ti[m];
+           if(d1 < d2)  ipeak[i] = m;
+           else         ipeak[i+1] = m;
+           break;
+         }
+      }
+      theta1 = theta2; 
+   }
+
+   /* correct the peaks: move each label to the maximum (ai > 0) or minimum
+      (ai < 0) of z within +/-d samples */
+   d = (int)ceil(g->p.sfecg/64);
+   for(i=1;i<=n;i++)
+   { 
+     if(ipeak[i] == 0.0) continue;
+     m = (int)ipeak[i];
+     j1 = MAX(1,i-d);
+     j2 = MIN(n,i+d);
+     jext = j1;
+     zext = z[j1];
+     for(j=j1+1;j<=j2;j++)
+     { 
+        if( (g->ai[m] < 0.0) ? (z[j] < zext) : (z[j] > zext) ) 
+        {
+           jext = j;
+           zext = z[j];
+        }
+     }
+     if(jext != i)
+     {
+        ipeak[jext] = ipeak[i];
+        ipeak[i] = 0;
+     }
+   }
+
+}
+
+
+/*--------------------------------------------------------------------------*/
+/*    CHECK PARAMETERS                                                      */
+/*--------------------------------------------------------------------------*/
+
+static int morph_check(const genmorph *m)
+{
+   int i;
+
+   if(m->k < 1) return -1;
+   for(i=1;i<=m->k;i++) if(!(m->bi[i] > 0.0)) return -1;
+   return 0;
+}
+
+const char *gen_check(const genparams *p)
+{
+   if(p->N < 1 || p->sfecg < 1 || p->sf < 1 || p->hrmean <= 0.0)
+     return "Number of beats, sampling frequencies and heart rate must be positive";
+   if(p->sf % p->sfecg != 0)
+     return "Internal sampling frequency must be an integer multiple of the \n"
+            "ECG sampling frequency";
+   if(p->morph && morph_check(p->morph) != 0)
+     return "The morphology needs at least one kernel, all of positive width";
+   if(p->prec != GEN_DOUBLE && p->prec != GEN_FLOAT)
+     return "Precision must be double or float";
+   if(p->prec == GEN_FLOAT && p->morph && p->morph->k > GEN_TPL_MAXK)
+     return "Float precision supports at most 8 kernels";
+   if(p->integ != GEN_RK4 && p->integ != GEN_ETD)
+     return "Integrator must be rk4 or etd";
+   if(p->integ == GEN_ETD && p->prec != GEN_DOUBLE)
+     return "The ETD integrator runs in double precision only";
+   if(p->rrdiv < 0 || (p->rrdiv & (p->rrdiv-1)) != 0)
+     return "The RR rate divisor must be a power of two";
+   if(gen_nrr(p) < 0)
+     return "The record is too long: its RR process exceeds the largest FFT";
+#ifdef ECGSYN_FIXED
+   if(p->integ != GEN_RK4)
+     return "The fixed-point build integrates with rk4 only";
+   if(p->morph && p->morph->k > GENQ_MAXK)
+     return "The fixed-point build supports at most 8 kernels";
+   if(p->hrmean < 20.0 || p->sf > 1000000)
+     return "The fixed-point build needs hrmean >= 20 bpm and sf <= 1 MHz";
+#endif
+   return NULL;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    STREAMING PEAK LABELLER                                               */
+/*--------------------------------------------------------------------------*/
+
+#define PL(a,m) (pl->a[(m) & pl->mask])
+
+static int peaklab_init(peaklab *pl, int sfecg, arena *a)
+{
+   int size;
+
+   memset(pl,0,sizeof(*pl));
+   pl->d = (int)ceil(sfecg/64);
+   for(size=1;size < 2*pl->d+4;size <<= 1) ;
+   pl->mask = size-1;
+   pl->theta = (double *)arena_alloc(a, 3*size*sizeof(double));
+   if(!pl->theta) return -1;
+   pl->z = pl->theta + size;
+   pl->lab = pl->z + size;
+   return 0;
+}
+
+/* label the crossing of a PQRST angle between samples i and i+1 */
+static void peaklab_cross(gen *g, peaklab *pl, long i)
+{
+   int m;
+   double theta1,theta2,d1,d2;
+
+   theta1 = PL(theta,i);
+   theta2 = PL(theta,i+1);
+   for(m=1;m<=g->k;m++)
+   {
+      if( (theta1 <= g->ti[m]) && (g->ti[m] <= theta2) )  
+      {
+        d1 = g->ti[m] - theta1;
+        d2 = theta2 - g->ti[m];
+        if(d1 < d2)  PL(lab,i) = m;
+        else         PL(lab,i+1) = m;
+        break;
+      }
+   }
+}
+
+/* move the label of sample i to the extremum of z within +/-d samples */
+static void peaklab_correct(gen *g, peaklab *pl, long i, long n)
+{
+   long j,j1,j2,jext;
+   double lab,zext;
+
+   lab = PL(lab,i);
+   if(lab != 0.0)
+   {
+      j1 = MAX(1,i-pl->d);
+      j2 = MIN(n,i+pl->d);
+      jext = j1;
+      zext = PL(z,j1);
+      for(j=j1+1;j<=j2;j++)
+      { 
+         if( (g->ai[(int)lab] < 0.0) ? (PL(z,j) < zext) : (PL(z,j) > zext) )
+         {
+            jext = j;
+            zext = PL(z,j);
+         }
+      }
+      if(jext != i)
+      {
+         PL(lab,jext) = lab;
+         PL(lab,i) = 0;
+      }
+   }
+}
+
+static void peaklab_push(gen *g, peaklab *pl, double x, double y, double z)
+{
+   long m;
+
+   m = ++pl->n;
+   PL(theta,m) = atan2(y,x);
+   PL(z,m) = z;
+   PL(lab,m) = 0.0;
+   if(m >= 2) peaklab_cross(g,pl,m-1);
+   if(m-1-pl->d >= 1) peaklab_correct(g,pl,++pl->ncorr,m);
+}
+
+static void peaklab_finish(gen *g, peaklab *pl)
+{
+   while(pl->ncorr < pl->n) peaklab_correct(g,pl,++pl->ncorr,pl->n);
+   pl->done = 1;
+}
+
+/* number of samples whose label can no longer change */
+static long peaklab_ready(peaklab *pl)
+{
+   long last;
+
+   last = pl->done ? pl->n : pl->ncorr - pl->d;
+   return (last > pl->nout) ? last - pl->nout : 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    HEART RATE ADJUSTED MORPHOLOGY                                        */
+/*--------------------------------------------------------------------------*/
+
+/* PQRST default:        P      Q      R     S     T   */
+static double pqrst_ti[] = {0, -60.0, -15.0, 0.0,  15.0, 90.0};
+static double pqrst_ai[] = {0,   1.2,  -5.0, 30.0, -7.5, 0.75};
+static double pqrst_bi[] = {0,  0.25,   0.1, 0.1,   0.1, 0.4};
+static double pqrst_tx[] = {0,   0.5,   1.0, 0.0,   1.0, 0.0};
+const genmorph gen_pqrst = {5, pqrst_ti, pqrst_ai, pqrst_bi, pqrst_tx};
+
+#ifdef ECGSYN_FIXED
+/* hand the adjusted morphology and the (rescaled) RR process to the 
+   fixed-point integrator */
+static void gen_qmorph(gen *g)
+{
+   long i;
+   q_t ti[GENQ_MAXK],ai[GENQ_MAXK],bi[GENQ_MAXK];
+
+   for(i=1;i<=g->k;i++)
+   {
+      ti[i-1] = GENQ_Q(g->ti[i]);
+      ai[i-1] = GENQ_Q(g->ai[i]);
+      bi[i-1] = GENQ_Q(g->bi[i]);
+   }
+   genq_setmorph(&g->fx, g->k, ti, ai, bi);
+   if(g->rrq) for(i=1;i<=g->Nrr;i++) g->rrq[i] = GENQ_Q(RRAT(g,i));
+}
+#endif
+
+/* adjust the extrema parameters ti0, bi0 for the mean heart rate */
+static void gen_morph(gen *g)
+{
+   int i;
+   double hrfact,hrfact2;
+
+   hrfact = sqrt(g->p.hrmean/60.0);
+   hrfact2 = sqrt(hrfact);
+   for(i=1;i<=g->k;i++)
+   {
+      g->bi[i] = g->bi0[i]*hrfact;
+      if(g->tx[i] == 0.0)      g->ti[i] = g->ti0[i]*1.0;
+      else if(g->tx[i] == 0.5) g->ti[i] = g->ti0[i]*hrfact2;
+      else if(g->tx[i] == 1.0) g->ti[i] = g->ti0[i]*hrfact;
+      else                     g->ti[i] = g->ti0[i]*pow(hrfact,g->tx[i]);
+   }
+
+   /* the amplitudes may have changed too: pick the matching integration step */
+   g->step = gen_tpl_step(g, g->p.prec);
+#ifdef ECGSYN_FIXED
+   gen_qmorph(g);
+#endif
+}
+
+//! @brief Replaces the morphology of g by m, adjusted for the heart rate.
+//!
+//! @return non-zero if memory runs out
+int gen_setmorph(gen *g, const genmorph *m)
+{
+   int i;
+
+   /* a new number of kernels leaves the old vectors to the arena's reset */
+   if(m->k != g->k || !g->ti)
+   {
+      g->k = m->k;
+      g->ti=arena_vect(g->mem,1,g->k);
+      g->ai=arena_vect(g->mem,1,g->k);
+      g->bi=arena_vect(g->mem,1,g->k);
+      g->ti0=arena_vect(g->mem,1,g->k);
+      g->bi0=arena_vect(g->mem,1,g->k);
+      g->tx=arena_vect(g->mem,1,g->k);
+      if(!g->ti || !g->ai || !g->bi || !g->ti0 || !g->bi0 || !g->tx) return -1;
+   }
+
+   /* convert angles from degrees to radians */
+   for(i=1;i<=g->k;i++)
+   {
+      g->ti0[i] = m->ti[i];
+      g->ti0[i] *= PI/180.0;
+      g->ai[i] = m->ai[i];
+      g->bi0[i] = m->bi[i];
+      g->tx[i] = m->tx[i];
+   }
+
+   /* adjust extrema parameters for mean heart rate */
+   gen_morph(g);
+   return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    LENGTH OF THE RECORD                                                  */
+/*--------------------------------------------------------------------------*/
+
+/* the record ends with the last beat that starts within the RR process */
+static void gen_length(gen *g)
+{
+   long j;
+   double tecg;
+
+   tecg = g->tecg;
+   j = g->rrend;
+   while(j < g->Nrr)
+   {
+      tecg += RRAT(g,j);
+      j = lrint(tecg/g->h);
+   }
+   g->Nt = j;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    INITIALISE GENERATOR CONTEXT                                          */
+/*--------------------------------------------------------------------------*/
+
+//! @brief Length of the RR process of a record: N beats at sf, rounded up to
+//! a power of two.
+//!
+//! @return the length, or -1 if it exceeds 2^GEN_MAXLOG2NRR samples (or the
+//! parameters give no finite length)
+long gen_nrr(const genparams *p)
+{
+   double e;
+
+   /* the exponent is bounded before it becomes a size, so a week at kHz 
+      rates fails here instead of wrapping around in an int */
+   e = ceil(log10(p->N*(60/p->hrmean)*p->sf)/log10(2.0));
+   if(!(e <= GEN_MAXLOG2NRR)) return -1;
+   if(e < 0.0) e = 0.0;
+   return 1L << (int)e;
+}
+
+int gen_init(gen *g, const genparams *p)
+{
+   return gen_initmem(g, p, NULL);
+}
+
+//! @brief Sets up a generator whose memory comes from the arena a, which the
+//! caller resets between records, or from an arena of its own if a is NULL.
+//!
+//! @return non-zero if the parameters are invalid or memory runs out
+int gen_initmem(gen *g, const genparams *p, arena *a)
+{
+   long i,n;
+   double rrmean,*rrs;
+   arenamark mark;
+
+   memset(g,0,sizeof(*g));
+   if(gen_check(p) != NULL) return -1;
+   g->p = *p;
+   g->p0 = *p;
+   g->p0.morph = NULL;
+   g->q = p->sf/p->sfecg;
+
+   /* calculate length of RR time series */
+   rrmean = (60/p->hrmean);
+   g->Nrr = gen_nrr(p);
+
+   /* room for the RR process, its FFT scratch space and the trajectories */
+   g->mem = a;
+   if(!a)
+   {
+      g->mem = &g->own;
+      if(arena_init(g->mem, GEN_ARENA(g->Nrr)) != 0) return -1;
+   }
+
+   /* define the ECG morphology vectors (PQRST extrema parameters) */
+   if(gen_setmorph(g, p->morph ? p->morph : &gen_pqrst) != 0) return -1;
+
+   /* calculate time scales */
+   g->h = 1.0/p->sf;
+
+   /* initialise seed */
+   g->rseed = -p->seed;
+
+   /* create rrprocess with required spectrum */
+   g->rr = arena_vect(g->mem,1,g->Nrr);
+   if(!g->rr) return -1;
+   n = p->rrdiv > 1 ? g->Nrr/p->rrdiv : 0;
+   if(n < 4)
+     rrprocess(g, g->rr, p->flo, p->fhi, p->flostd, p->fhistd, p->lfhfratio,
+               p->hrmean, p->hrstd, p->sf, g->Nrr);
+   else
+   {
+      /* at sf/rrdiv, with rrdiv times less FFT scratch space, then linearly
+         interpolated to sf */
+      mark = arena_mark(g->mem);
+      rrs = arena_vect(g->mem,1,n);
+      if(!rrs) return -1;
+      rrprocess(g, rrs, p->flo, p->fhi, p->flostd, p->fhistd, p->lfhfratio,
+                p->hrmean, p->hrstd, p->sf/(double)p->rrdiv, n);
+      interp(g->rr, rrs, n, p->rrdiv);
+      for(i=(n-1)*p->rrdiv+1;i<=g->Nrr;i++) g->rr[i] = rrs[n];
+      arena_release(g->mem, mark);
+   }
+
+   g->rrmean0 = rrmean;
+   g->rrstd0 = 60.0*p->hrstd/(p->hrmean*p->hrmean);
+
+   /* place the RR cursor on the first beat */
+   g->rrbeg = 1;
+   g->tecg = g->rr[1];
+   g->rrend = lrint(g->tecg/g->h);
+   g->rrval = g->rr[1];
+   gen_length(g);
+
+#ifdef ECGSYN_FIXED
+   /* the fixed-point integrator walks its own cursor over rrq */
+   g->rrq = (q_t *)arena_array(g->mem, g->Nrr+1, sizeof(q_t));
+   if(!g->rrq) return -1;
+   for(i=1;i<=g->Nrr;i++) g->rrq[i] = GENQ_Q(RRAT(g,i));
+   if(genq_init(&g->fx, g->rrq, g->Nrr, p->sf, GENQ_Q(p->fhi)) != 0) 
+      return -1;
+   gen_qmorph(g);
+#endif
+
+   /* declare and initialise the state vector */
+   g->x[1] = 1.0;
+   g->x[2] = 0.0;
+   g->x[3] = 0.04;
+   g->timev = 0.0;
+   g->it = 0;
+
+   g->zmin = 0.0;
+   g->zrange = 1.0;
+   if(peaklab_init(&g->pl, p->sfecg, g->mem) != 0) return -1;
+
+   return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    FREE GENERATOR CONTEXT                                                */
+/*--------------------------------------------------------------------------*/
+
+/* all memory of the record is in the arena: unmapped if it is g's own */
+void gen_free(gen *g)
+{
+   if(g->mem == &g->own) arena_free(&g->own);
+   memset(g,0,sizeof(*g));
+}
+
+/*--------------------------------------------------------------------------*/
+/*    PIECEWISE CONSTANT RR                                                 */
+/*--------------------------------------------------------------------------*/
+
+/* expand the RR process to rrpc[1..Nt], the RR interval at every sample */
+void gen_rrpc(gen *g, double *rrpc)
+{
+   long i,j,k;
+   double tecg;
+
+   tecg = 0.0;
+   i = 1;
+   j = 1;
+   while(i <= g->Nrr)
+   {  
+      tecg += g->rr[j];
+      j = lrint(tecg/g->h);
+      for(k=i;k<=j;k++) rrpc[k] = g->rr[i];
+      i = j+1;
+   }
+}
+
+/*--------------------------------------------------------------------------*/
+/*    ONE INTEGRATION STEP                                                  */
+/*--------------------------------------------------------------------------*/
+
+void gen_step(gen *g)
+{
+   if(g->morphdue)
+   {
+      gen_morph(g);
+      g->morphdue = 0;
+   }
+#ifdef ECGSYN_FIXED
+   /* the double RR cursor still applies the live updates at beat starts */
+   angfreq(g, g->timev);
+   genq_step(&g->fx);
+   g->x[1] = GENQ_D(g->fx.x);
+   g->x[2] = GENQ_D(g->fx.y);
+   g->x[3] = GENQ_D(g->fx.z);
+   g->timev += g->h;
+   g->it++;
+   return;
+#endif
+   if(g->p.integ == GEN_ETD)
+   {
+      detdrk4(g, g->x, g->timev, g->h);
+      g->timev += g->h;
+      g->it++;
+      return;
+   }
+   if(g->step) 
+   {
+      (*g->step)(g);
+      return;
+   }
+   drk4(g, g->x, 3, g->timev, g->h, g->x, derivspqrst);
+   g->timev += g->h;
+   g->it++;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    PHASE OSCILLATOR ONLY                                                 */
+/*--------------------------------------------------------------------------*/
+
+/* x and y do not depend on z, so the phase oscillator can be run ahead on
+   its own at a fraction of the cost of a full step (no kernels). This is the
+   x, y part of drk4() on derivspqrst() with the same operations, so x, y 
+   follow the full integration bit for bit; z is left as it is. Returns 
+   non-zero for the float, ETD and fixed-point integrators, whose x, y this
+   does not reproduce. */
+int gen_phase(gen *g)
+{
+   int i;
+   double y[3],yt[3],dydx[3],dym[3],dyt[3],hh,h6,t,w0,a0;
+
+#ifdef ECGSYN_FIXED
+   return -1;
+#endif
+   if(g->p.prec != GEN_DOUBLE || g->p.integ != GEN_RK4) return -1;
+
+   hh = g->h*0.5;
+   h6 = g->h/6.0;
+   t = g->timev;
+   y[1] = g->x[1];
+   y[2] = g->x[2];
+
+#define DXY(t_,u,d) w0 = angfreq(g,t_);                           \
+                    a0 = 1.0 - sqrt(u[1]*u[1] + u[2]*u[2]);       \
+                    d[1] = a0*u[1] - w0*u[2];                     \
+                    d[2] = a0*u[2] + w0*u[1]
+   DXY(t,y,dydx);
+   for(i=1;i<=2;i++) yt[i] = y[i]+hh*dydx[i];
+   DXY(t+hh,yt,dyt);
+   for(i=1;i<=2;i++) yt[i] = y[i]+hh*dyt[i];
+   DXY(t+hh,yt,dym);
+   for(i=1;i<=2;i++)
+   {
+      yt[i] = y[i]+g->h*dym[i];
+      dym[i] += dyt[i];
+   }
+   DXY(t+g->h,yt,dyt);
+#undef DXY
+   for(i=1;i<=2;i++) g->x[i] = y[i]+h6*(dydx[i]+dyt[i]+2.0*dym[i]);
+
+   g->timev += g->h;
+   g->it++;
+   return 0;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    AMPLITUDE RANGE OF THE RECORD                                         */
+/*--------------------------------------------------------------------------*/
+
+/* Integrate the whole record once without storing it, to find the range of
+   the downsampled z that dorun() uses to scale the signal to -0.4..1.2 mV.
+   The context itself is left untouched, so gen_block() can start from the 
+   beginning with the exact scaling of the whole-record pipeline. Updates 
+   already queued are left to it as well: the copy must not apply them. */
+void gen_prescan(gen *g)
+{
+   gen s;
+   double zmin,zmax;
+
+   s = *g;
+   s.chan.tail = s.chan.head;
+   s.morphdue = 0;
+   zmin = zmax = s.x[3];
+   while(s.it < s.Nt)
+   {
+      if(s.it % s.q == 0)
+      {
+         if(s.x[3] < zmin)       zmin = s.x[3];
+         else if(s.x[3] > zmax)  zmax = s.x[3];
+      }
+      gen_step(&s);
+   }
+   g->zmin = zmin;
+   g->zrange = zmax-zmin;
+}
+
+/* Estimate the range from one noise-free template beat at the mean heart 
+   rate instead: the record's morphology is integrated with a constant RR 
+   (and the double rk4 of drk4() in every build) for TPL_WARM seconds, for z
+   to forget its initial value, and then over one beat and at least one
+   period of the baseline wander. Costs a few seconds of signal whatever the
+   length of the record; with the heart rate variability the extremes of
+   the record lie up to about 10% of the range outside the estimate. */
+#define TPL_WARM 5.0
+
+void gen_template(gen *g)
+{
+   gen s;
+   double zmin,zmax,span;
+   int nwarm,nspan,i;
+
+   s = *g;
+   s.chan.tail = s.chan.head;
+   s.morphdue = 0;
+   s.rrscaled = 1;
+   s.rra = 0.0;
+   s.rrb = 60.0/s.p.hrmean;
+   s.rrbeg = 1;
+   s.tecg = s.rrb;
+   s.rrend = lrint(s.tecg/s.h);
+   s.rrval = s.rrb;
+   s.timev = 0.0;
+   span = MAX(s.rrb, 1.0/s.p.fhi);
+   nwarm = (int)ceil(TPL_WARM/s.h);
+   nspan = (int)ceil(span/s.h);
+
+   zmin = 0.0;
+   zmax = 0.0;
+   for(i=0;i<nwarm+nspan;i++)
+   {
+      if(i == nwarm) zmin = zmax = s.x[3];
+      else if(i > nwarm && i % s.q == 0)
+      {
+         if(s.x[3] < zmin)       zmin = s.x[3];
+         else if(s.x[3] > zmax)  zmax = s.x[3];
+      }
+      drk4(&s, s.x, 3, s.timev, s.h, s.x, derivspqrst);
+      s.timev += s.h;
+   }
+   g->zmin = zmin;
+   g->zrange = zmax-zmin;
+}
+
+/* Or bound it without integrating anything. On the limit cycle the phase
+   turns at w = 2 pi/RR, so one passage of kernel i drives z by the integral
+   of -ai dt exp(-dt^2/2bi^2) dt/w, at most ai bi^2/w at the kernel centre and
+   back to zero after it; the relaxation of z only shrinks this. The bound
+   adds the positive kernels up for the maximum and the negative ones for 
+   the minimum, at the longest RR of the record, plus the 0.005 of the 
+   baseline wander. It is about 1.7 times the actual range and needs only
+   the morphology and the RR process (live updates can exceed it). */
+void gen_bound(gen *g)
+{
+   long i;
+   double rrmax,up,down;
+
+   rrmax = 0.0;
+   for(i=1;i<=g->Nrr;i++) if(RRAT(g,i) > rrmax) rrmax = RRAT(g,i);
+   up = down = 0.005;
+   for(i=1;i<=g->k;i++)
+   {
+      if(g->ai[i] > 0.0) up += g->ai[i]*g->bi[i]*g->bi[i]*rrmax/(2.0*PI);
+      else             down -= g->ai[i]*g->bi[i]*g->bi[i]*rrmax/(2.0*PI);
+   }
+   g->zmin = MIN(-down, g->x[3]);
+   g->zrange = MAX(up, g->x[3]) - g->zmin;
+}
+
+/* set the range of the streamed output by one of the methods above */
+void gen_range(gen *g, int norm)
+{
+   if(norm == GEN_NORM_TEMPLATE)    gen_template(g);
+   else if(norm == GEN_NORM_BOUND)  gen_bound(g);
+   else                             gen_prescan(g);
+}
+
+/*--------------------------------------------------------------------------*/
+/*    GENERATE A BLOCK OF OUTPUT                                            */
+/*--------------------------------------------------------------------------*/
+
+/* Produce the next n output samples at sfecg as the model gives them: the
+   downsampled z before scaling and noise, with PQRST labels. Returns the
+   number of samples produced, less than n at the end of the record. */
+int gen_raw(gen *g, double *z, double *ipeak, int n)
+{
+   int m,j;
+   long i;
+   peaklab *pl = &g->pl;
+
+   m = 0;
+   while(m < n)
+   {
+      if(peaklab_ready(pl) > 0)
+      {
+         i = ++pl->nout;
+         z[m] = PL(z,i);
+         ipeak[m] = PL(lab,i);
+         m++;
+      }
+      else if(g->it < g->Nt)
+      {
+         peaklab_push(g, pl, g->x[1], g->x[2], g->x[3]);
+         for(j=0;j<g->q && g->it < g->Nt;j++) gen_step(g);
+      }
+      else if(!pl->done) peaklab_finish(g,pl);
+      else break;
+   }
+   return m;
+}
+
+/* Scale n raw samples in place to -0.4..1.2 mV with the range in zmin, 
+   zrange and add the uniform noise. */
+void gen_scale(gen *g, double *z, int n)
+{
+   int m;
+
+   for(m=0;m<n;m++)
+   {
+      z[m] = (z[m]-g->zmin)*(1.6)/g->zrange - 0.4;
+      z[m] += g->p.Anoise*(2.0*ran1_r(&g->rseed,&g->rng) - 1.0);
+   }
+}
+
+/* Produce the next n output samples at sfecg: scaled to -0.4..1.2 mV with 
+   the range set by gen_prescan() (or gen_range()), with additive noise and
+   PQRST labels. Returns the number of samples produced, less than n at the
+   end of the record. */
+int gen_block(gen *g, double *z, double *ipeak, int n)
+{
+   int m;
+
+   m = gen_raw(g, z, ipeak, n);
+   gen_scale(g, z, m);
+   return m;
+}
+
+/*--------------------------------------------------------------------------*/
+/*    LIVE PARAMETER UPDATES                                                */
+/*--------------------------------------------------------------------------*/
+
+/* Queue n changes of parameters; they are applied together when the next
+   beat starts. Lock-free, for one posting thread at a time while another
+   thread runs the generator. Returns -1 if an update is invalid or the queue
+   has no room for all of them. */
+int gen_post(gen *g, const genupdate *u, int n)
+{
+   unsigned head;
+   int i;
+
+   for(i=0;i<n;i++)
+   {
+      if((u[i].mask & GEN_SET_HRMEAN) && !(u[i].hrmean > 0.0)) return -1;
+      if((u[i].mask & GEN_SET_HRSTD) && !(u[i].hrstd >= 0.0)) return -1;
+      if((u[i].mask & (GEN_SET_TI|GEN_SET_AI|GEN_SET_BI))
+         && (u[i].wave < 1 || u[i].wave > g->k)) return -1;
+      if((u[i].mask & GEN_SET_BI) && !(u[i].bi > 0.0)) return -1;
+   }
+
+   head = g->chan.head;
+   if(n < 0 || head + n - LOAD_ACQ(&g->chan.tail) > GEN_NUPDATES) return -1;
+   for(i=0;i<n;i++) g->chan.u[(head+i) % GEN_NUPDATES] = u[i];
+   STORE_REL(&g->chan.head, head+n);
+   return 0;
+}
+
+/* Apply all queued updates. Called by the RR cursor at a beat boundary, so
+   the new beat already has the new RR interval. A new hrmean or hrstd only
+   rescales the existing RR process (no new spectrum or FFT) and re-adjusts
+   ti and bi; the morphology switches at the next integration step. */
+static void gen_update(gen *g)
+{
+   unsigned head,tail;
+   genupdate *u;
+   double rrmean,rrstd;
+
+   head = LOAD_ACQ(&g->chan.head);
+   for(tail=g->chan.tail;tail != head;tail++)
+   {
+      u = &g->chan.u[tail % GEN_NUPDATES];
+      if(u->mask & GEN_SET_HRMEAN) g->p.hrmean = u->hrmean;
+      if(u->mask & GEN_SET_HRSTD)  g->p.hrstd = u->hrstd;
+      if(u->mask & GEN_SET_ANOISE) g->p.Anoise = u->Anoise;
+      if(u->mask & GEN_SET_TI)     g->ti0[u->wave] = u->ti*PI/180.0;
+      if(u->mask & GEN_SET_AI)     g->ai[u->wave] = u->ai;
+      if(u->mask & GEN_SET_BI)     g->bi0[u->wave] = u->bi;
+   }
+   STORE_REL(&g->chan.tail, tail);
+
+   /* map the process from (rrmean0, rrstd0) to the new mean and std */
+   rrmean = 60.0/g->p.hrmean;
+   rrstd = 60.0*g->p.hrstd/(g->p.hrmean*g->p.hrmean);
+   g->rra = (g->rrstd0 > 0.0) ? rrstd/g->rrstd0 : 0.0;
+   g->rrb = rrmean - g->rra*g->rrmean0;
+   g->rrscaled = 1;
+
+   g->morphdue = 1;
+   gen_length(g);
+}
+
+/*--------------------------------------------------------------------------*/
+/*    CHECKPOINT AND RESTORE                                                */
+/*--------------------------------------------------------------------------*/
+
+/* a blob being written (buf may be NULL to measure) or read */
+typedef struct ckbuf {
+  unsigned char *w;    // output buffer, NULL to only count
+  const unsigned char *r; // input buffer
+  long n;              // bytes written or read so far
+  long size;           // capacity of the buffer
+  int err;             // read past the end
+} ckbuf;
+
+static void ck_put64(ckbuf *b, unsigned long long v)
+{
+   int i;
+
+   if(b->w && b->n+8 <= b->size)
+     for(i=0;i<8;i++) b->w[b->n+i] = (unsigned char)(v >> 8*i);
+   b->n += 8;
+}
+
+static unsigned long long ck_get64(ckbuf *b)
+{
+   int i;
+   unsigned long long v;
+
+   if(b->n+8 > b->size)
+   {
+      b->err = 1;
+      return 0;
+   }
+   v = 0;
+   for(i=0;i<8;i++) v |= (unsigned long long)b->r[b->n+i] << 8*i;
+   b->n += 8;
+   return v;
+}
+
+static void ck_putd(ckbuf *b, double x)
+{
+   unsigned long long v;
+
+   memcpy(&v,&x,sizeof(v));
+   ck_put64(b,v);
+}
+
+static double ck_getd(ckbuf *b)
+{
+   unsigned long long v;
+   double x;
+
+   v = ck_get64(b);
+   memcpy(&x,&v,sizeof(x));
+   return x;
+}
+
+#define ck_puti(b,v) ck_put64(b,(unsigned long long)(long long)(v))
+#define ck_geti(b)   ((long long)ck_get64(b))
+
+/* the state every build has in common, in both directions */
+static void ck_params(ckbuf *b, genparams *p, int save)
+{
+   int i;
+   int *iv[7];
+   double *dv[8];
+
+   iv[0] = &p->N; iv[1] = &p->sfecg; iv[2] = &p->sf; iv[3] = &p->seed;
+   iv[4] = &p->prec; iv[5] = &p->integ; iv[6] = &p->rrdiv;
+   dv[0] = &p->Anoise; dv[1] = &p->hrmean; dv[2] = &p->hrstd; 
+   dv[3] = &p->flo; dv[4] = &p->fhi; dv[5] = &p->flostd; 
+   dv[6] = &p->fhistd; dv[7] = &p->lfhfratio;
+   for(i=0;i<7;i++) 
+     if(save) ck_puti(b,*iv[i]); else *iv[i] = (int)ck_geti(b);
+   for(i=0;i<8;i++) 
+     if(save) ck_putd(b,*dv[i]); else *dv[i] = ck_getd(b);
+}
+
+//! @brief Writes the state of g to buf[0..size-1].
+//!
+//! @return size of the checkpoint [bytes]; nothing is written if it is 
+//! larger than size (buf may then be NULL)
+long gen_save(const gen *g, unsigned char *buf, long size)
+{
+   ckbuf b;
+   genparams p0;
+   const peaklab *pl = &g->pl;
+   const genupdate *u;
+   unsigned head,tail;
+   long i,ring,need;
+   int pass,flags;
+
+   /* once, so that both passes see the same updates */
+   head = LOAD_ACQ(&g->chan.head);
+   ring = pl->mask+1;
+   flags = 0;
+#ifdef ECGSYN_FIXED
+   flags |= GEN_CKPT_FIXED;
+#endif
+   need = 0;
+   for(pass=0;pass<2;pass++)
+   {
+      memset(&b,0,sizeof(b));
+      if(pass == 1)
+      {
+         if(need > size || !buf) return need;
+         b.w = buf;
+         b.size = size;
+      }
+      ck_puti(&b,GEN_CKPT_MAGIC);
+      ck_puti(&b,GEN_CKPT_VERSION);
+      ck_puti(&b,need);
+      ck_puti(&b,flags);
+
+      p0 = g->p0;
+      ck_params(&b,&p0,1);
+      ck_putd(&b,g->p.Anoise);
+      ck_putd(&b,g->p.hrmean);
+      ck_putd(&b,g->p.hrstd);
+
+      ck_puti(&b,g->k);
+      for(i=1;i<=g->k;i++)
+      {
+         ck_putd(&b,g->ti0[i]);
+         ck_putd(&b,g->ai[i]);
+         ck_putd(&b,g->bi0[i]);
+         ck_putd(&b,g->tx[i]);
+      }
+
+      ck_puti(&b,g->rrscaled);
+      ck_putd(&b,g->rra);
+      ck_putd(&b,g->rrb);
+      ck_puti(&b,g->Nt);
+      ck_puti(&b,g->rrbeg);
+      ck_puti(&b,g->rrend);
+      ck_putd(&b,g->tecg);
+      ck_putd(&b,g->rrval);
+
+      for(i=1;i<=3;i++) ck_putd(&b,g->x[i]);
+      ck_putd(&b,g->timev);
+      ck_puti(&b,g->it);
+
+      ck_puti(&b,g->rseed);
+      ck_puti(&b,g->rng.iy);
+      for(i=0;i<RAN1_NTAB;i++) ck_puti(&b,g->rng.iv[i]);
+
+      ck_putd(&b,g->zmin);
+      ck_putd(&b,g->zrange);
+
+      ck_puti(&b,ring);
+      ck_puti(&b,pl->n);
+      ck_puti(&b,pl->ncorr);
+      ck_puti(&b,pl->nout);
+      ck_puti(&b,pl->done);
+      for(i=0;i<ring;i++)
+      {
+         ck_putd(&b,pl->theta[i]);
+         ck_putd(&b,pl->z[i]);
+         ck_putd(&b,pl->lab[i]);
+      }
+
+      ck_puti(&b,g->morphdue);
+      ck_puti(&b,head-g->chan.tail);
+      for(tail=g->chan.tail;tail != head;tail++)
+      {
+         u = &g->chan.u[tail % GEN_NUPDATES];
+         ck_puti(&b,u->mask);
+         ck_putd(&b,u->hrmean);
+         ck_putd(&b,u->hrstd);
+         ck_putd(&b,u->Anoise);
+         ck_puti(&b,u->wave);
+         ck_putd(&b,u->ti);
+         ck_putd(&b,u->ai);
+         ck_putd(&b,u->bi);
+      }
+
+#ifdef ECGSYN_FIXED
+      ck_puti(&b,g->fx.x);
+      ck_puti(&b,g->fx.y);
+      ck_puti(&b,g->fx.z);
+      ck_puti(&b,g->fx.it);
+      ck_puti(&b,g->fx.rrbeg);
+      ck_puti(&b,g->fx.rrend);
+      ck_puti(&b,g->fx.tecg);
+      ck_puti(&b,g->fx.w0);
+      ck_put64(&b,g->fx.zbphase);
+#endif
+      need = b.n;
+   }
+   return need;
+}
+
+//! @brief Initialises g from a checkpoint of gen_save(); the RR process is
+//! regenerated from the saved parameters.
+//!
+//! @return non-zero if the checkpoint is damaged, of another version or 
+//! build, or memory runs out
+int gen_restore(gen *g, const unsigned char *buf, long size)
+{
+   ckbuf b;
+   genparams p0;
+   genmorph m;
+   peaklab *pl;
+   genupdate *u;
+   double *mv;
+   long i,ring;
+   int k,n,flags;
+
+   memset(g,0,sizeof(*g));
+   memset(&b,0,sizeof(b));
+   b.r = buf;
+   b.size = size;
+   if(ck_geti(&b) != GEN_CKPT_MAGIC || ck_geti(&b) != GEN_CKPT_VERSION
+      || ck_geti(&b) != size) return -1;
+   flags = (int)ck_geti(&b);
+#ifdef ECGSYN_FIXED
+   if(!(flags & GEN_CKPT_FIXED)) return -1;
+#else
+   if(flags & GEN_CKPT_FIXED) return -1;
+#endif
+
+   /* the record as it was created: RR process, seed, labeller */
+   memset(&p0,0,sizeof(p0));
+   ck_params(&b,&p0,0);
+   if(b.err || gen_check(&p0) != NULL || gen_init(g,&p0) != 0) return -1;
+   g->p.Anoise = ck_getd(&b);
+   g->p.hrmean = ck_getd(&b);
+   g->p.hrstd = ck_getd(&b);
+
+   /* the morphology as it is now, in radians: no round trip via degrees */
+   k = (int)ck_geti(&b);
+   if(b.err || k < 1 || k > 1024) goto fail;
+   mv = (double *)calloc(4*(size_t)k+4, sizeof(double));
+   if(!mv) goto fail;
+   m.k = k;
+   m.ti = mv; m.ai = mv+k+1; m.bi = mv+2*k+2; m.tx = mv+3*k+3;
+   for(i=1;i<=k;i++) m.bi[i] = 1.0;
+   n = gen_setmorph(g,&m);
+   free(mv);
+   if(n != 0) goto fail;
+   for(i=1;i<=k;i++)
+   {
+      g->ti0[i] = ck_getd(&b);
+      g->ai[i] = ck_getd(&b);
+      g->bi0[i] = ck_getd(&b);
+      g->tx[i] = ck_getd(&b);
+      if(!(g->bi0[i] > 0.0)) goto fail;
+   }
+
+   g->rrscaled = (int)ck_geti(&b);
+   g->rra = ck_getd(&b);
+   g->rrb = ck_getd(&b);
+   g->Nt = (long)ck_geti(&b);
+   g->rrbeg = (long)ck_geti(&b);
+   g->rrend = (long)ck_geti(&b);
+   g->tecg = ck_getd(&b);
+   g->rrval = ck_getd(&b);
+   if(b.err || g->rrbeg < 1 || g->rrbeg > g->Nrr || g->rrend < g->rrbeg)
+     goto fail;
+   gen_morph(g);
+
+   for(i=1;i<=3;i++) g->x[i] = ck_getd(&b);
+   g->timev = ck_getd(&b);
+   g->it = (long)ck_geti(&b);
+
+   g->rseed = (long)ck_geti(&b);
+   g->rng.iy = (long)ck_geti(&b);
+   for(i=0;i<RAN1_NTAB;i++) g->rng.iv[i] = (long)ck_geti(&b);
+
+   g->zmin = ck_getd(&b);
+   g->zrange = ck_getd(&b);
+
+   pl = &g->pl;
+   ring = (long)ck_geti(&b);
+   if(b.err || ring != pl->mask+1) goto fail;
+   pl->n = (long)ck_geti(&b);
+   pl->ncorr = (long)ck_geti(&b);
+   pl->nout = (long)ck_geti(&b);
+   pl->done = (int)ck_geti(&b);
+   if(b.err || pl->nout < 0 || pl->ncorr < pl->nout || pl->n < pl->ncorr
+      || pl->n - pl->nout > ring) goto fail;
+   for(i=0;i<ring;i++)
+   {
+      pl->theta[i] = ck_getd(&b);
+      pl->z[i] = ck_getd(&b);
+      pl->lab[i] = ck_getd(&b);
+      if(!(pl->lab[i] >= 0.0 && pl->lab[i] <= k) 
+         || pl->lab[i] != (int)pl->lab[i]) goto fail;
+   }
+
+   g->morphdue = (int)ck_geti(&b);
+   n = (int)ck_geti(&b);
+   if(b.err || n < 0 || n > GEN_NUPDATES) goto fail;
+   for(i=0;i<n;i++)
+   {
+      u = &g->chan.u[i];
+      u->mask = (int)ck_geti(&b);
+      u->hrmean = ck_getd(&b);
+      u->hrstd = ck_getd(&b);
+      u->Anoise = ck_getd(&b);
+      u->wave = (int)ck_geti(&b);
+      u->ti = ck_getd(&b);
+      u->ai = ck_getd(&b);
+      u->bi = ck_getd(&b);
+      if((u->mask & (GEN_SET_TI|GEN_SET_AI|GEN_SET_BI))
+         && (u->wave < 1 || u->wave > k)) goto fail;
+   }
+   g->chan.head = n;
+   g->chan.tail = 0;
+
+#ifdef ECGSYN_FIXED
+   g->fx.x = (q_t)ck_geti(&b);
+   g->fx.y = (q_t)ck_geti(&b);
+   g->fx.z = (q_t)ck_geti(&b);
+   g->fx.it = (long)ck_geti(&b);
+   g->fx.rrbeg = (long)ck_geti(&b);
+   g->fx.rrend = (long)ck_geti(&b);
+   g->fx.tecg = (int64_t)ck_geti(&b);
+   g->fx.w0 = (q_t)ck_geti(&b);
+   g->fx.zbphase = ck_get64(&b);
+   if(g->fx.rrbeg < 1 || g->fx.rrbeg > g->fx.nrr || g->fx.rrend < g->fx.rrbeg)
+     goto fail;
+#endif
+
+   if(b.err || b.n != size || g->it < 0 || g->it > g->Nt) goto fail;
+   return 0;
+
+fail:
+   gen_free(g);
+   return -1;
+}
@@ -0,0 +1,240 @@
+// "gen.h" - ECGSYN generator context.
+//
+// All state of one synthetic ECG record lives in a `gen` context: the model
+// parameters, the PQRST morphology, the RR process with its cursor, the
+// integrator state and the random number generator. Several contexts can run
+// side by side in one process (e.g. one per client of the streaming server).
+
+#ifndef _GEN_H
+#define _GEN_H
+
+#include "ran1.h"
+#include "arena.h"
+#ifdef ECGSYN_FIXED
+#include "genq.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PI (2.0*asin(1.0))
+#define MIN(a,b) (a < b ? a : b)
+#define MAX(a,b) (a > b ? a : b)
+
+/*---------------------------------------------------------------------------*/
+/*      MODEL PARAMETERS                                                     */
+/*---------------------------------------------------------------------------*/
+
+// Morphology: k Gaussian kernels (the PQRST waves by default). The kernel
+// angles are scaled with the heart rate by hrfact^tx, hrfact = sqrt(hr/60).
+typedef struct genmorph {
+  int k;               // number of kernels
+  double *ti;          // angle ti[1..k] [degrees]
+  double *ai;          // amplitude ai[1..k]
+  double *bi;          // width bi[1..k], before the heart rate adjustment
+  double *tx;          // heart rate exponent of the angle tx[1..k]
+} genmorph;
+
+extern const genmorph gen_pqrst;
+
+typedef struct genparams {
+  int N;               // Approximate number of heart beats
+  int sfecg;           // ECG sampling frequency [Hz]
+  int sf;              // Internal sampling frequency [Hz]
+  double Anoise;       // Amplitude of additive uniform noise [mV]
+  double hrmean;       // Heart rate mean [bpm]
+  double hrstd;        // Heart rate std [bpm]
+  double flo;          // Low frequency [Hz]
+  double fhi;          // High frequency [Hz]
+  double flostd;       // Low frequency std [Hz]
+  double fhistd;       // High frequency std [Hz]
+  double lfhfratio;    // LF/HF ratio
+  int seed;            // Seed
+  const genmorph *morph; // morphology, NULL for the PQRST default
+  int prec;            // integration precision, GEN_DOUBLE or GEN_FLOAT
+  int integ;           // integrator, GEN_RK4 or GEN_ETD
+  int rrdiv;           // RR process synthesised at sf/rrdiv and interpolated
+                       // (a power of two; 0 or 1: at sf)
+} genparams;
+
+#define GEN_RK4 0      // classical fourth order Runge-Kutta
+#define GEN_ETD 1      // exponential time differencing (ETDRK4)
+
+#define GEN_MAXN 8     // largest system drk4() integrates
+
+// First mapping of a generator's own arena for an RR process of n samples:
+// the process, its FFT scratch space and four decimated trajectories.
+#define GEN_ARENA(n) ((size_t)(n)*12*sizeof(double) + ARENA_HUGE)
+
+// Longest RR process, a power of two. Sample indices and counts are long
+// throughout; the limit keeps GEN_ARENA() and the n*log2(n) FFT in range
+// and is lowered to what a 32-bit long holds where long is 32 bits.
+#define GEN_MAXLOG2NRR (sizeof(long) > 4 ? 40 : 24)
+
+// Range of z that the streamed output is scaled to -0.4..1.2 mV from.
+#define GEN_NORM_PRESCAN  0  // exact: integrate the whole record beforehand
+#define GEN_NORM_TEMPLATE 1  // estimate from a template beat at the mean rate
+#define GEN_NORM_BOUND    2  // analytic bound of z, no integration
+
+/*---------------------------------------------------------------------------*/
+/*      STREAMING PEAK LABELLER                                              */
+/*---------------------------------------------------------------------------*/
+
+// Incremental version of detectpeaks(): keeps the last 2d+2 samples in a ring
+// so that labels can be corrected within +/-d samples before they are final.
+typedef struct peaklab {
+  int d;               // half width of the correction window [samples]
+  int mask;            // ring size - 1 (ring size is a power of two)
+  long n;              // number of samples pushed
+  long ncorr;          // number of samples whose label was corrected
+  long nout;           // number of samples released
+  int done;            // end of record reached, all labels corrected
+  double *theta;       // phase angle atan2(y,x) of each sample
+  double *z;           // raw z of each sample
+  double *lab;         // PQRST label of each sample
+} peaklab;
+
+/*---------------------------------------------------------------------------*/
+/*      LIVE PARAMETER UPDATES                                               */
+/*---------------------------------------------------------------------------*/
+
+#define GEN_SET_HRMEAN 0x01
+#define GEN_SET_HRSTD  0x02
+#define GEN_SET_ANOISE 0x04
+#define GEN_SET_TI     0x08
+#define GEN_SET_AI     0x10
+#define GEN_SET_BI     0x20
+
+// A change of parameters of a running generator, applied at the next beat.
+typedef struct genupdate {
+  int mask;            // which fields are set, GEN_SET_*
+  double hrmean;       // Heart rate mean [bpm]
+  double hrstd;        // Heart rate std [bpm]
+  double Anoise;       // Amplitude of additive uniform noise [mV]
+  int wave;            // kernel 1..k that ti, ai, bi refer to
+  double ti;           // angle [degrees]
+  double ai;           // amplitude
+  double bi;           // width, before the heart rate adjustment
+} genupdate;
+
+// Single-producer single-consumer queue of updates. The producer (any thread
+// but one at a time) only writes head, the generator only writes tail.
+#define GEN_NUPDATES 16
+typedef struct genchan {
+  genupdate u[GEN_NUPDATES];
+  unsigned head;       // number of updates posted
+  unsigned tail;       // number of updates applied
+} genchan;
+
+/*---------------------------------------------------------------------------*/
+/*      CHECKPOINTS                                                          */
+/*---------------------------------------------------------------------------*/
+
+// gen_save() writes the complete state of a running generator to a compact
+// little-endian blob: the parameters the RR process is regenerated from,
+// the morphology, the RR cursor and rescale, the state vector, ran1's state,
+// the output normalisation, the streaming labeller and pending updates.
+// gen_restore() continues bit for bit where gen_save() left off.
+#define GEN_CKPT_MAGIC   0x4b434745u  // "EGCK"
+#define GEN_CKPT_VERSION 2
+#define GEN_CKPT_FIXED   0x01         // flag: saved by the fixed-point build
+
+/*---------------------------------------------------------------------------*/
+/*      GENERATOR CONTEXT                                                    */
+/*---------------------------------------------------------------------------*/
+
+typedef struct gen {
+  arena own;           // memory of the record, unless the caller shares one
+  arena *mem;          // arena all buffers of the record come from
+  genparams p;         // model parameters
+  genparams p0;        // parameters the record was created with (no morph)
+  int q;               // decimation factor sf/sfecg
+  double h;            // internal time step 1/sf [s]
+  int k;               // number of Gaussian kernels
+  double *ti,*ai,*bi;  // morphology ti[1..k], ai[1..k], bi[1..k]
+  double *ti0,*bi0;    // ti [rad] and bi before the heart rate adjustment
+  double *tx;          // heart rate exponent of ti
+  void (*step)(struct gen *g); // specialised integration step, see gen_tpl.h
+  double etdw;         // ETD: angular frequency of the coefficients below
+  double etdu[6][2];   // ETD: E, E/2, Q, f1, f2, f3 of the x+iy rotation
+  double etdz[6];      // ETD: E, E/2, Q, f1, f2, f3 of the z relaxation
+
+  long rseed;          // seed of ran1
+  ran1state rng;       // shuffle table of ran1
+
+  long Nrr;            // length of the RR process
+  double *rr;          // RR process rr[1..Nrr] sampled at sf
+  long Nt;             // number of internal samples in the record
+
+  long rrbeg,rrend;    // RR cursor: current beat covers samples rrbeg..rrend
+  double tecg;         // RR cursor: end time of current beat [s]
+  double rrval;        // RR cursor: RR interval of current beat [s]
+  double rrmean0;      // mean RR the process was generated with [s]
+  double rrstd0;       // RR std the process was generated with [s]
+  int rrscaled;        // rr is rescaled to a new hrmean/hrstd by rra, rrb
+  double rra,rrb;      // RR interval of sample i is rra*rr[i] + rrb
+
+  genchan chan;        // pending parameter updates
+  int morphdue;        // updated morphology takes effect at the next step
+
+  double x[4];         // state vector x[1..3]
+  double timev;        // time of the state vector [s]
+  long it;             // number of internal samples taken so far
+
+  double zmin,zrange;  // amplitude normalisation of the streamed output
+  peaklab pl;          // labeller of the streamed output
+
+#ifdef ECGSYN_FIXED
+  genq fx;             // fixed-point integrator that gen_step() runs on
+  q_t *rrq;            // RR process rrq[1..Nrr] in Q26, after any rescale
+#endif
+} gen;
+
+/*---------------------------------------------------------------------------*/
+/*      FUNCTIONS                                                            */
+/*---------------------------------------------------------------------------*/
+
+double *mallocVect(long n0, long nx);
+void freeVect(double *vect, long n0, long nx);
+double mean(double *x, long n);
+double stdev(double *x, long n);
+void interp(double *y, double *x, long n, int r);
+void dfour1(double data[], long nn, int isign);
+
+void rrprocess(gen *g, double *rr, double flo, double fhi,
+double flostd, double fhistd, double lfhfratio,
+double hrmean, double hrstd, double sf, long n);
+double angfreq(gen *g, double t);
+void derivspqrst(gen *g, double t0, double x[], double dxdt[]);
+void drk4(gen *g, double y[], int n, double x, double h, double yout[],
+          void (*derivs)(gen *, double, double [], double []));
+void detdrk4(gen *g, double x[], double t, double h);
+void detectpeaks(gen *g, double *ipeak, double *x, double *y, double *z,
+                 long n);
+
+const char *gen_check(const genparams *p);
+long gen_nrr(const genparams *p);
+int  gen_init(gen *g, const genparams *p);
+int  gen_initmem(gen *g, const genparams *p, arena *a);
+int  gen_setmorph(gen *g, const genmorph *m);
+void gen_free(gen *g);
+void gen_rrpc(gen *g, double *rrpc);
+void gen_step(gen *g);
+int  gen_phase(gen *g);
+void gen_prescan(gen *g);
+void gen_template(gen *g);
+void gen_bound(gen *g);
+void gen_range(gen *g, int norm);
+int  gen_raw(gen *g, double *z, double *ipeak, int n);
+void gen_scale(gen *g, double *z, int n);
+int  gen_block(gen *g, double *z, double *ipeak, int n);
+int  gen_post(gen *g, const genupdate *u, int n);
+long gen_save(const gen *g, unsigned char *buf, long size);
+int  gen_restore(gen *g, const unsigned char *buf, long size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GEN_H */
@@ -0,0 +1,130 @@
+// "gen_tpl.cpp" - compile-time specialised integration steps.
+//
+// step<T,K,PQRST> performs the same fourth order Runge-Kutta step as
+// drk4(g, g->x, 3, ..., derivspqrst) in the same order of operations, so the
+// double instances reproduce the generic path bit for bit. The differences
+// are all at compile time: no scratch arrays, the K kernels unrolled into
+// straight-line code, and for the PQRST default the amplitudes folded in as
+// constants.
+
+#include <cmath>
+#include <type_traits>
+#include "gen_tpl.h"
+
+namespace {
+
+// amplitudes of the PQRST default (gen_pqrst.ai[1..5])
+constexpr double pqrst_ai[5] = {1.2, -5.0, 30.0, -7.5, 0.75};
+
+// morphology of one step in the working precision, 0-based
+template<typename T, int K>
+struct kernels {
+  T ti[K], ai[K], bi[K];
+};
+
+// sum of the kernel forcing terms I..K-1, added to s in order
+template<typename T, int K, bool PQRST, int I = 0>
+inline T zsum(const kernels<T,K> &m, T t, T s)
+{
+   if constexpr (I == K) return s;
+   else
+   {
+      constexpr T twopi = T(2.0*M_PI);
+      constexpr T emin = std::is_same<T,float>::value ? T(-87.0) : T(-746.0);
+      T ai = PQRST ? T(pqrst_ai[I]) : m.ai[I];
+      T dt = t-m.ti[I];
+      if(dt >= twopi || dt <= -twopi) dt = std::fmod(dt,twopi);
+      T dt2 = dt*dt;
+      T e = T(-0.5)*dt2/(m.bi[I]*m.bi[I]);
+      // exp() takes a slow path when it underflows, which is most of the
+      // cycle for narrow kernels. In double the skipped terms are exactly
+      // zero; in float they are below 1e-38.
+      if(e > emin) s += -ai*dt*std::exp(e);
+      return zsum<T,K,PQRST,I+1>(m,t,s);
+   }
+}
+
+// derivspqrst() for state x[0..2] in precision T
+template<typename T, int K, bool PQRST>
+inline void deriv(gen *g, const kernels<T,K> &m, double t0, const T x[3],
+                  T dxdt[3])
+{
+   T a0,w0,t,zbase;
+
+   w0 = T(angfreq(g,t0));
+   a0 = T(1.0) - std::sqrt(x[0]*x[0] + x[1]*x[1]);
+   zbase = T(0.005*sin(2.0*PI*g->p.fhi*t0));
+
+   t = std::atan2(x[1],x[0]);
+   dxdt[0] = a0*x[0] - w0*x[1];
+   dxdt[1] = a0*x[1] + w0*x[0];
+   dxdt[2] = zsum<T,K,PQRST>(m,t,T(0.0));
+   dxdt[2] += T(-1.0)*(x[2] - zbase);
+}
+
+template<typename T, int K, bool PQRST>
+void step(gen *g)
+{
+   kernels<T,K> m;
+   T y[3],yt[3],dydx[3],dym[3],dyt[3],hh,h6,h;
+   double x;
+   int i;
+
+   for(i=0;i<K;i++)
+   {
+      m.ti[i] = T(g->ti[i+1]);
+      m.ai[i] = T(g->ai[i+1]);
+      m.bi[i] = T(g->bi[i+1]);
+   }
+   for(i=0;i<3;i++) y[i] = T(g->x[i+1]);
+
+   x = g->timev;
+   h = T(g->h);
+   hh = T(g->h*0.5);
+   h6 = T(g->h/6.0);
+   deriv<T,K,PQRST>(g,m,x,y,dydx);
+   for(i=0;i<3;i++) yt[i] = y[i]+hh*dydx[i];
+   deriv<T,K,PQRST>(g,m,x+g->h*0.5,yt,dyt);
+   for(i=0;i<3;i++) yt[i] = y[i]+hh*dyt[i];
+   deriv<T,K,PQRST>(g,m,x+g->h*0.5,yt,dym);
+   for(i=0;i<3;i++)
+   {
+      yt[i] = y[i]+h*dym[i];
+      dym[i] += dyt[i];
+   }
+   deriv<T,K,PQRST>(g,m,x+g->h,yt,dyt);
+   for(i=0;i<3;i++) g->x[i+1] = double(y[i]+h6*(dydx[i]+dyt[i]+T(2.0)*dym[i]));
+
+   g->timev += g->h;
+   g->it++;
+}
+
+// dispatch table: one instance per precision and kernel count
+#define STEPS(T) { nullptr, step<T,1,false>, step<T,2,false>, step<T,3,false>, \
+                   step<T,4,false>, step<T,5,false>, step<T,6,false>,          \
+                   step<T,7,false>, step<T,8,false> }
+
+const gen_stepfn steps[2][GEN_TPL_MAXK+1] = { STEPS(double), STEPS(float) };
+const gen_stepfn pqrst[2] = { step<double,5,true>, step<float,5,true> };
+
+static_assert(GEN_TPL_MAXK == 8, "STEPS lists 8 kernel counts");
+
+} // namespace
+
+//! @brief Returns the specialised step for the morphology of g, or NULL if
+//! there is no instance for its number of kernels.
+//!
+//! @param prec  GEN_DOUBLE or GEN_FLOAT
+extern "C" gen_stepfn gen_tpl_step(const gen *g, int prec)
+{
+   int i;
+
+   if(prec != GEN_DOUBLE && prec != GEN_FLOAT) return nullptr;
+   if(g->k < 1 || g->k > GEN_TPL_MAXK) return nullptr;
+   if(g->k == 5)
+   {
+      for(i=0;i<5 && g->ai[i+1] == pqrst_ai[i];i++) ;
+      if(i == 5) return pqrst[prec];
+   }
+   return steps[prec][g->k];
+}
@@ -0,0 +1,29 @@
+// "gen_tpl.h" - compile-time specialised integration steps (C interface).
+//
+// The Runge-Kutta step of the model is a C++ template over the floating
+// point type and the number of Gaussian kernels, with the kernel loop fully
+// unrolled; the PQRST default has its own instance with the amplitudes as
+// compile-time constants. gen_tpl_step() picks the instance for a context.
+
+#ifndef _GEN_TPL_H
+#define _GEN_TPL_H
+
+#include "gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GEN_DOUBLE 0         // arithmetic in double
+#define GEN_FLOAT  1         // arithmetic in float
+#define GEN_TPL_MAXK 8       // instances exist for 1..GEN_TPL_MAXK kernels
+
+typedef void (*gen_stepfn)(gen *g);
+
+gen_stepfn gen_tpl_step(const gen *g, int prec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GEN_TPL_H */
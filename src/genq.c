@@ -0,0 +1,245 @@
+// "genq.c" - fixed-point (Q-format) integrator of the ECGSYN model.
+
+#include "genq.h"
+#include "genq_lut.h"
+
+#define ONE     ((q_t)1 << GENQ_FRAC)
+#define QPI     ((q_t)210828714)        // pi in Q26
+#define QTWOPI  ((q_t)421657428)        // 2 pi in Q26
+
+/*---------------------------------------------------------------------------*/
+/*      ARITHMETIC                                                           */
+/*---------------------------------------------------------------------------*/
+
+static inline q_t qmul(q_t a, q_t b)
+{
+   return (q_t)(((int64_t)a*b + (1 << (GENQ_FRAC-1))) >> GENQ_FRAC);
+}
+
+static inline q_t qdiv(q_t a, q_t b)
+{
+   return (q_t)(((int64_t)a << GENQ_FRAC)/b);
+}
+
+/* a*h for the Q34 time step */
+static inline q_t hmul(int64_t h, q_t a)
+{
+   return (q_t)((a*h + ((int64_t)1 << (GENQ_HFRAC-1))) >> GENQ_HFRAC);
+}
+
+/* integer square root of a 64-bit value */
+static uint32_t isqrt64(uint64_t v)
+{
+   uint64_t r,bit;
+
+   r = 0;
+   bit = (uint64_t)1 << 62;
+   while(bit > v) bit >>= 2;
+   while(bit)
+   {
+      if(v >= r+bit)
+      {
+         v -= r+bit;
+         r = (r >> 1) + bit;
+      }
+      else r >>= 1;
+      bit >>= 2;
+   }
+   return (uint32_t)r;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      LOOKUP TABLES                                                        */
+/*---------------------------------------------------------------------------*/
+
+//! @brief exp(-u) for u >= 0, Q26; zero beyond u = 16.
+q_t genq_qexp(q_t u)
+{
+   int j;
+   q_t f;
+
+   if(u <= 0) return ONE;
+   j = u >> (GENQ_FRAC-5);
+   if(j >= 512) return 0;
+   f = u & ((1 << (GENQ_FRAC-5))-1);
+   return genq_exp[j] + (q_t)(((int64_t)(genq_exp[j+1]-genq_exp[j])*f)
+                              >> (GENQ_FRAC-5));
+}
+
+/* atan(r) for 0 <= r <= 1 */
+static q_t qatan(q_t r)
+{
+   int j;
+   q_t f;
+
+   j = r >> (GENQ_FRAC-8);
+   if(j >= 256) return genq_atan[256];
+   f = r & ((1 << (GENQ_FRAC-8))-1);
+   return genq_atan[j] + (q_t)(((int64_t)(genq_atan[j+1]-genq_atan[j])*f)
+                               >> (GENQ_FRAC-8));
+}
+
+//! @brief atan2(y,x) in (-pi, pi], Q26.
+q_t genq_qatan2(q_t y, q_t x)
+{
+   q_t ax,ay,a;
+
+   ax = x < 0 ? -x : x;
+   ay = y < 0 ? -y : y;
+   if(ax == 0 && ay == 0) return 0;
+   if(ay <= ax) a = qatan(qdiv(ay,ax));
+   else         a = QPI/2 - qatan(qdiv(ax,ay));
+   if(x < 0) a = QPI - a;
+   return y < 0 ? -a : a;
+}
+
+/* sin of a phase in turns (2^-64), from the quarter wave table */
+static q_t qsin(uint64_t phase)
+{
+   uint32_t p,j,f;
+   q_t s;
+
+   p = (uint32_t)(phase >> 32);
+   j = (p >> 22) & 255;                 // position within the quadrant
+   f = (p >> 6) & 0xffff;               // 16 bits between table entries
+   if(p & 0x40000000u)                  // second and fourth quadrant: mirror
+   {
+      j = 255-j;
+      f = 0xffff-f;
+   }
+   s = genq_sin[j] + (q_t)(((int64_t)(genq_sin[j+1]-genq_sin[j])*f) >> 16);
+   return (p & 0x80000000u) ? -s : s;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      MODEL                                                                */
+/*---------------------------------------------------------------------------*/
+
+/* RR cursor: angular frequency at internal sample i */
+static q_t qangfreq(genq *q, long i)
+{
+   while(i > q->rrend && q->rrend < q->nrr)
+   {
+      q->tecg += q->rr[q->rrend];
+      q->rrbeg = q->rrend+1;
+      q->rrend = (long)((q->tecg*q->sf + (1 << (GENQ_FRAC-1))) >> GENQ_FRAC);
+      q->w0 = qdiv(QTWOPI, q->rr[q->rrbeg]);
+   }
+   return q->w0;
+}
+
+/* derivspqrst() at sample i and baseline phase ph */
+static void qderiv(genq *q, long i, uint64_t ph, const q_t s[3], q_t d[3])
+{
+   int m;
+   q_t a0,w0,t,dt,zbase;
+   int64_t r2,dz,e;
+
+   w0 = qangfreq(q,i);
+   r2 = (int64_t)s[0]*s[0] + (int64_t)s[1]*s[1];     // Q52
+   a0 = ONE - (q_t)isqrt64((uint64_t)r2);
+   zbase = qmul(q->zbamp, qsin(ph));
+
+   t = genq_qatan2(s[1],s[0]);
+   d[0] = qmul(a0,s[0]) - qmul(w0,s[1]);
+   d[1] = qmul(a0,s[1]) + qmul(w0,s[0]);
+   dz = 0;
+   for(m=0;m<q->k;m++)
+   {
+      dt = t-q->ti[m];
+      if(dt >= QTWOPI || dt <= -QTWOPI) dt %= QTWOPI;
+      e = ((int64_t)dt*dt >> GENQ_FRAC)*q->ib[m] >> GENQ_IFRAC;
+      if(e >= (int64_t)16 << GENQ_FRAC) continue;
+      dz -= ((int64_t)q->ai[m]*dt >> GENQ_FRAC)*genq_qexp((q_t)e) >> GENQ_FRAC;
+   }
+   d[2] = (q_t)dz - (s[2] - zbase);
+}
+
+//! @brief Sets up the integrator on the RR process rr[1..nrr] (Q26 seconds).
+//!
+//! @param sf   internal sampling frequency [Hz]
+//! @param fhi  frequency of the baseline wander [Hz], Q26
+//!
+//! @return non-zero if the arguments are out of range
+int genq_init(genq *q, const q_t *rr, long nrr, int32_t sf, q_t fhi)
+{
+   long i;
+
+   if(nrr < 1 || sf < 1 || fhi < 0) return -1;
+   for(i=1;i<=nrr;i++) if(rr[i] <= 0) return -1;
+   q->k = 0;
+   q->sf = sf;
+   q->h = ((int64_t)1 << GENQ_HFRAC)/sf;
+   q->it = 0;
+
+   q->rr = rr;
+   q->nrr = nrr;
+   q->rrbeg = 1;
+   q->tecg = rr[1];
+   q->rrend = (long)((q->tecg*sf + (1 << (GENQ_FRAC-1))) >> GENQ_FRAC);
+   q->w0 = qdiv(QTWOPI, rr[1]);
+
+   q->zbamp = (q_t)((5*(int64_t)ONE + 500)/1000);    // 0.005
+   q->zbphase = 0;
+   q->zbinc = (((uint64_t)fhi << (64-GENQ_FRAC-8))/(uint64_t)sf) << 8;
+
+   q->x = ONE;
+   q->y = 0;
+   q->z = (q_t)((4*(int64_t)ONE + 50)/100);          // 0.04
+   return 0;
+}
+
+//! @brief Sets the kernels (ti [rad], ai, bi already adjusted for the heart
+//! rate) of the integrator.
+//!
+//! @return non-zero if k is out of range or a width is not positive
+int genq_setmorph(genq *q, int k, const q_t *ti, const q_t *ai, const q_t *bi)
+{
+   int m;
+   int64_t b2;
+
+   if(k < 1 || k > GENQ_MAXK) return -1;
+   for(m=0;m<k;m++)
+   {
+      if(bi[m] <= 0) return -1;
+      q->ti[m] = ti[m];
+      q->ai[m] = ai[m];
+      q->bi[m] = bi[m];
+      b2 = ((int64_t)bi[m]*bi[m]) >> 4;               // Q48
+      q->ib[m] = (int32_t)((((uint64_t)1 << (2*GENQ_FRAC+GENQ_IFRAC-5))
+                            + (uint64_t)b2/2)/(uint64_t)b2);
+   }
+   q->k = k;
+   return 0;
+}
+
+//! @brief One fourth order Runge-Kutta step, as drk4() on derivspqrst().
+void genq_step(genq *q)
+{
+   q_t s[3],st[3],k1[3],k2[3],k3[3],k4[3];
+   int64_t hh;
+   uint64_t ph,phh;
+   long i;
+   int n;
+
+   s[0] = q->x; s[1] = q->y; s[2] = q->z;
+   hh = q->h/2;
+   i = q->it+1;                         // sample of the step's start
+   ph = q->zbphase;
+   phh = ph + q->zbinc/2;
+
+   qderiv(q,i,ph,s,k1);
+   for(n=0;n<3;n++) st[n] = s[n] + hmul(hh,k1[n]);
+   qderiv(q,i,phh,st,k2);
+   for(n=0;n<3;n++) st[n] = s[n] + hmul(hh,k2[n]);
+   qderiv(q,i,phh,st,k3);
+   for(n=0;n<3;n++) st[n] = s[n] + hmul(q->h,k3[n]);
+   qderiv(q,i+1,ph+q->zbinc,st,k4);
+   for(n=0;n<3;n++)
+      s[n] += (q_t)(((int64_t)k1[n] + k4[n] + 2*((int64_t)k2[n] + k3[n]))
+                    *q->h/6 >> GENQ_HFRAC);
+
+   q->x = s[0]; q->y = s[1]; q->z = s[2];
+   q->zbphase += q->zbinc;
+   q->it++;
+}
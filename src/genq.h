@@ -0,0 +1,68 @@
+// "genq.h" - fixed-point (Q-format) integrator of the ECGSYN model.
+//
+// Integer-only version of the Runge-Kutta step, the derivspqrst() forcing
+// and the RR cursor, for targets without a floating point unit. The state,
+// angles and amplitudes are Q26 (26 fractional bits, range +/-32), the time
+// step is Q34 and the baseline wander is a 64-bit phase accumulator. exp()
+// and atan2() come from lookup tables with linear interpolation (genq_lut.h),
+// and sqrt() is an integer square root. Products use 64-bit intermediates.
+//
+// Build ecgsyn with `make DEFS=-DECGSYN_FIXED` to run gen_step() on this
+// integrator; bench/qbench measures its speed and error on the host.
+
+#ifndef _GENQ_H
+#define _GENQ_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GENQ_FRAC  26        // fractional bits of state, angles, amplitudes
+#define GENQ_HFRAC 34        // fractional bits of the time step
+#define GENQ_IFRAC 16        // fractional bits of the inverse widths
+#define GENQ_MAXK  8         // maximum number of kernels
+
+typedef int32_t q_t;
+
+// conversions for the host side (the integrator itself never uses them)
+#define GENQ_Q(x)  ((q_t)lrint((x)*(double)(1L<<GENQ_FRAC)))
+#define GENQ_D(q)  ((double)(q)/(double)(1L<<GENQ_FRAC))
+
+typedef struct genq {
+  int k;               // number of kernels
+  q_t ti[GENQ_MAXK];   // angles [rad]
+  q_t ai[GENQ_MAXK];   // amplitudes
+  q_t bi[GENQ_MAXK];   // widths
+  int32_t ib[GENQ_MAXK]; // 0.5/bi^2, GENQ_IFRAC fractional bits
+
+  q_t x,y,z;           // state vector
+  int32_t sf;          // internal sampling frequency [Hz]
+  int64_t h;           // time step 1/sf, GENQ_HFRAC fractional bits
+  long it;             // number of steps taken
+
+  const q_t *rr;       // RR process rr[1..nrr] [s]
+  long nrr;            // length of the RR process
+  long rrbeg,rrend;    // RR cursor: current beat covers samples rrbeg..rrend
+  int64_t tecg;        // RR cursor: end time of current beat [s, Q26]
+  q_t w0;              // angular frequency of the current beat [rad/s]
+
+  q_t zbamp;           // amplitude of the baseline wander
+  uint64_t zbphase;    // phase of the baseline wander at step it [2^-64 turns]
+  uint64_t zbinc;      // phase increment per step
+} genq;
+
+int  genq_init(genq *q, const q_t *rr, long nrr, int32_t sf, q_t fhi);
+int  genq_setmorph(genq *q, int k, const q_t *ti, const q_t *ai,
+                   const q_t *bi);
+void genq_step(genq *q);
+
+q_t  genq_qexp(q_t u);
+q_t  genq_qatan2(q_t y, q_t x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GENQ_H */
@@ -0,0 +1,196 @@
+// "genq_lut.h" - lookup tables of the fixed-point integrator, Q26.
+//
+// Generated with
+//   genq_exp[j]  = exp(-j/32),            j = 0..512
+//   genq_atan[j] = atan(j/256),           j = 0..256
+//   genq_sin[j]  = sin(pi/2 * j/256),     j = 0..256
+// each rounded to the nearest multiple of 2^-26.
+
+#ifndef _GENQ_LUT_H
+#define _GENQ_LUT_H
+
+/* exp(-u), u = 0 .. 16 in steps of 1/32 */
+static const int32_t genq_exp[513] = {
+  67108864, 65044141, 63042943, 61103316, 59223365, 57401253,
+  55635202, 53923487, 52264436, 50656428, 49097894, 47587310,
+  46123203, 44704141, 43328739, 41995654, 40703584, 39451266,
+  38237478, 37061035, 35920786, 34815620, 33744456, 32706248,
+  31699983, 30724677, 29779378, 28863163, 27975137, 27114432,
+  26280209, 25471652, 24687971, 23928402, 23192203, 22478654,
+  21787058, 21116741, 20467047, 19837342, 19227011, 18635458,
+  18062106, 17506393, 16967778, 16445734, 15939752, 15449338,
+  14974012, 14513310, 14066782, 13633993, 13214519, 12807951,
+  12413892, 12031956, 11661772, 11302977, 10955221, 10618164,
+  10291478, 9974842, 9667949, 9370497, 9082197, 8802767,
+  8531935, 8269435, 8015011, 7768415, 7529406, 7297750,
+  7073222, 6855602, 6644677, 6440242, 6242097, 6050048,
+  5863907, 5683494, 5508631, 5339148, 5174880, 5015666,
+  4861350, 4711782, 4566816, 4426309, 4290126, 4158133,
+  4030201, 3906204, 3786023, 3669539, 3556639, 3447213,
+  3341154, 3238357, 3138723, 3042155, 2948558, 2857840,
+  2769914, 2684692, 2602093, 2522035, 2444440, 2369233,
+  2296339, 2225688, 2157211, 2090840, 2026512, 1964163,
+  1903732, 1845160, 1788391, 1733368, 1680038, 1628348,
+  1578249, 1529692, 1482628, 1437012, 1392800, 1349948,
+  1308415, 1268159, 1229142, 1191325, 1154672, 1119146,
+  1084714, 1051341, 1018994, 987643, 957257, 927805,
+  899259, 871592, 844776, 818785, 793594, 769177,
+  745512, 722575, 700344, 678797, 657912, 637670,
+  618051, 599036, 580605, 562742, 545428, 528647,
+  512382, 496618, 481339, 466530, 452176, 438264,
+  424780, 411711, 399044, 386767, 374867, 363334,
+  352155, 341320, 330819, 320641, 310776, 301214,
+  291947, 282964, 274259, 265821, 257642, 249715,
+  242032, 234586, 227368, 220373, 213593, 207021,
+  200652, 194478, 188495, 182696, 177075, 171627,
+  166346, 161228, 156268, 151460, 146800, 142283,
+  137906, 133663, 129551, 125565, 121702, 117957,
+  114328, 110810, 107401, 104097, 100894, 97790,
+  94781, 91865, 89039, 86299, 83644, 81071,
+  78576, 76159, 73816, 71545, 69343, 67210,
+  65142, 63138, 61195, 59313, 57488, 55719,
+  54005, 52343, 50733, 49172, 47659, 46193,
+  44771, 43394, 42059, 40765, 39511, 38295,
+  37117, 35975, 34868, 33795, 32756, 31748,
+  30771, 29824, 28907, 28017, 27155, 26320,
+  25510, 24725, 23964, 23227, 22513, 21820,
+  21149, 20498, 19867, 19256, 18664, 18089,
+  17533, 16993, 16471, 15964, 15473, 14997,
+  14535, 14088, 13655, 13234, 12827, 12433,
+  12050, 11679, 11320, 10972, 10634, 10307,
+  9990, 9683, 9385, 9096, 8816, 8545,
+  8282, 8027, 7780, 7541, 7309, 7084,
+  6866, 6655, 6450, 6251, 6059, 5873,
+  5692, 5517, 5347, 5183, 5023, 4869,
+  4719, 4574, 4433, 4297, 4164, 4036,
+  3912, 3792, 3675, 3562, 3452, 3346,
+  3243, 3143, 3047, 2953, 2862, 2774,
+  2689, 2606, 2526, 2448, 2373, 2300,
+  2229, 2160, 2094, 2030, 1967, 1907,
+  1848, 1791, 1736, 1683, 1631, 1581,
+  1532, 1485, 1439, 1395, 1352, 1310,
+  1270, 1231, 1193, 1156, 1121, 1086,
+  1053, 1021, 989, 959, 929, 901,
+  873, 846, 820, 795, 770, 747,
+  724, 701, 680, 659, 639, 619,
+  600, 581, 564, 546, 529, 513,
+  497, 482, 467, 453, 439, 425,
+  412, 400, 387, 375, 364, 353,
+  342, 331, 321, 311, 302, 292,
+  283, 275, 266, 258, 250, 242,
+  235, 228, 221, 214, 207, 201,
+  195, 189, 183, 177, 172, 167,
+  161, 157, 152, 147, 142, 138,
+  134, 130, 126, 122, 118, 115,
+  111, 108, 104, 101, 98, 95,
+  92, 89, 86, 84, 81, 79,
+  76, 74, 72, 69, 67, 65,
+  63, 61, 59, 58, 56, 54,
+  52, 51, 49, 48, 46, 45,
+  43, 42, 41, 40, 38, 37,
+  36, 35, 34, 33, 32, 31,
+  30, 29, 28, 27, 26, 26,
+  25, 24, 23, 23, 22, 21,
+  21, 20, 19, 19, 18, 18,
+  17, 16, 16, 15, 15, 15,
+  14, 14, 13, 13, 12, 12,
+  12, 11, 11, 11, 10, 10,
+  10, 9, 9, 9, 9, 8,
+  8, 8, 8
+};
+
+/* atan(r), r = 0 .. 1 in steps of 1/256 */
+static const int32_t genq_atan[257] = {
+  0, 262143, 524277, 786396, 1048491, 1310553,
+  1572576, 1834551, 2096470, 2358325, 2620108, 2881811,
+  3143427, 3404947, 3666364, 3927669, 4188855, 4449915,
+  4710839, 4971621, 5232252, 5492726, 5753033, 6013167,
+  6273121, 6532885, 6792453, 7051818, 7310971, 7569905,
+  7828614, 8087089, 8345322, 8603308, 8861038, 9118506,
+  9375704, 9632625, 9889262, 10145607, 10401655, 10657398,
+  10912829, 11167942, 11422729, 11677184, 11931300, 12185071,
+  12438490, 12691551, 12944247, 13196572, 13448519, 13700083,
+  13951257, 14202035, 14452411, 14702378, 14951932, 15201066,
+  15449775, 15698052, 15945892, 16193290, 16440240, 16686736,
+  16932773, 17178346, 17423449, 17668078, 17912227, 18155892,
+  18399066, 18641746, 18883926, 19125603, 19366770, 19607424,
+  19847560, 20087173, 20326259, 20564815, 20802835, 21040315,
+  21277251, 21513640, 21749478, 21984759, 22219482, 22453641,
+  22687233, 22920256, 23152704, 23384575, 23615866, 23846573,
+  24076692, 24306221, 24535157, 24763497, 24991237, 25218375,
+  25444908, 25670833, 25896148, 26120849, 26344936, 26568404,
+  26791252, 27013478, 27235078, 27456052, 27676396, 27896109,
+  28115189, 28333634, 28551442, 28768611, 28985139, 29201026,
+  29416269, 29630866, 29844817, 30058119, 30270772, 30482774,
+  30694125, 30904822, 31114864, 31324252, 31532983, 31741056,
+  31948472, 32155228, 32361325, 32566762, 32771537, 32975650,
+  33179101, 33381889, 33584014, 33785476, 33986273, 34186406,
+  34385875, 34584678, 34782817, 34980291, 35177099, 35373243,
+  35568721, 35763535, 35957683, 36151167, 36343987, 36536142,
+  36727633, 36918461, 37108625, 37298126, 37486965, 37675143,
+  37862658, 38049514, 38235708, 38421244, 38606120, 38790338,
+  38973899, 39156803, 39339052, 39520645, 39701585, 39881871,
+  40061505, 40240487, 40418820, 40596503, 40773538, 40949926,
+  41125668, 41300765, 41475218, 41649029, 41822199, 41994729,
+  42166620, 42337874, 42508491, 42678474, 42847824, 43016541,
+  43184628, 43352086, 43518916, 43685120, 43850699, 44015655,
+  44179990, 44343704, 44506799, 44669278, 44831141, 44992391,
+  45153028, 45313055, 45472473, 45631284, 45789489, 45947091,
+  46104090, 46260489, 46416290, 46571494, 46726103, 46880119,
+  47033543, 47186378, 47338625, 47490286, 47641362, 47791857,
+  47941771, 48091106, 48239865, 48388049, 48535659, 48682699,
+  48829170, 48975073, 49120412, 49265186, 49409400, 49553053,
+  49696150, 49838690, 49980677, 50122112, 50262998, 50403335,
+  50543127, 50682375, 50821081, 50959247, 51096875, 51233967,
+  51370525, 51506552, 51642048, 51777016, 51911459, 52045377,
+  52178773, 52311650, 52444008, 52575850, 52707179
+};
+
+/* sin(a), a = 0 .. pi/2 in steps of pi/512 */
+static const int32_t genq_sin[257] = {
+  0, 411772, 823529, 1235255, 1646934, 2058551,
+  2470091, 2881538, 3292876, 3704090, 4115165, 4526085,
+  4936834, 5347398, 5757760, 6167906, 6577819, 6987485,
+  7396887, 7806011, 8214841, 8623362, 9031558, 9439415,
+  9846915, 10254046, 10660790, 11067132, 11473058, 11878552,
+  12283599, 12688183, 13092290, 13495904, 13899009, 14301591,
+  14703635, 15105126, 15506047, 15906385, 16306124, 16705249,
+  17103745, 17501597, 17898790, 18295309, 18691140, 19086267,
+  19480675, 19874350, 20267276, 20659440, 21050825, 21441418,
+  21831204, 22220168, 22608295, 22995571, 23381982, 23767512,
+  24152147, 24535873, 24918675, 25300539, 25681450, 26061395,
+  26440358, 26818326, 27195284, 27571218, 27946115, 28319959,
+  28692737, 29064434, 29435038, 29804533, 30172906, 30540143,
+  30906230, 31271153, 31634900, 31997455, 32358805, 32718937,
+  33077838, 33435493, 33791889, 34147013, 34500851, 34853391,
+  35204618, 35554519, 35903083, 36250294, 36596140, 36940609,
+  37283687, 37625361, 37965619, 38304447, 38641834, 38977765,
+  39312229, 39645212, 39976704, 40306690, 40635158, 40962097,
+  41287493, 41611335, 41933610, 42254307, 42573413, 42890915,
+  43206803, 43521065, 43833687, 44144660, 44453970, 44761607,
+  45067559, 45371813, 45674360, 45975187, 46274283, 46571636,
+  46867237, 47161073, 47453133, 47743406, 48031883, 48318550,
+  48603399, 48886418, 49167596, 49446923, 49724388, 49999982,
+  50273692, 50545510, 50815425, 51083427, 51349506, 51613651,
+  51875853, 52136102, 52394388, 52650702, 52905033, 53157373,
+  53407711, 53656038, 53902345, 54146623, 54388862, 54629053,
+  54867188, 55103257, 55337251, 55569162, 55798981, 56026699,
+  56252308, 56475799, 56697163, 56916393, 57133480, 57348416,
+  57561193, 57771802, 57980237, 58186489, 58390550, 58592412,
+  58792069, 58989512, 59184734, 59377728, 59568487, 59757002,
+  59943268, 60127277, 60309022, 60488497, 60665695, 60840608,
+  61013231, 61183556, 61351578, 61517290, 61680686, 61841760,
+  62000506, 62156917, 62310988, 62462713, 62612087, 62759103,
+  62903756, 63046041, 63185953, 63323485, 63458633, 63591393,
+  63721758, 63849723, 63975285, 64098439, 64219179, 64337501,
+  64453401, 64566874, 64677917, 64786524, 64892692, 64996418,
+  65097695, 65196522, 65292895, 65386809, 65478262, 65567249,
+  65653767, 65737814, 65819386, 65898480, 65975092, 66049221,
+  66120863, 66190016, 66256677, 66320843, 66382512, 66441682,
+  66498350, 66552515, 66604174, 66653326, 66699968, 66744099,
+  66785716, 66824820, 66861408, 66895478, 66927030, 66956062,
+  66982573, 67006562, 67028028, 67046971, 67063390, 67077284,
+  67088652, 67097495, 67103811, 67107601, 67108864
+};
+
+#endif /* _GENQ_LUT_H */
@@ -0,0 +1,205 @@
+// "morph.c" - morphology tables from files and option lists.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "morph.h"
+
+#define MAXLINE 256
+
+/*---------------------------------------------------------------------------*/
+/*      STORAGE                                                              */
+/*---------------------------------------------------------------------------*/
+
+/* make room for k kernels; new kernels are zero with tx = 0 */
+static int morph_resize(genmorph *m, int k)
+{
+   double *v[4];
+   int c,i,n;
+
+   n = MIN(m->k,k);
+   for(c=0;c<4;c++)
+   {
+      v[c] = (double *)calloc(k+1,sizeof(double));
+      if(!v[c])
+      {
+         while(c-- > 0) free(v[c]);
+         return -1;
+      }
+   }
+   for(i=1;i<=n;i++)
+   {
+      v[0][i] = m->ti[i];
+      v[1][i] = m->ai[i];
+      v[2][i] = m->bi[i];
+      v[3][i] = m->tx[i];
+   }
+   morph_free(m);
+   m->k = k;
+   m->ti = v[0];
+   m->ai = v[1];
+   m->bi = v[2];
+   m->tx = v[3];
+   return 0;
+}
+
+//! @brief Makes m an independent copy of src (e.g. of gen_pqrst).
+int morph_copy(genmorph *m, const genmorph *src)
+{
+   int i;
+
+   memset(m,0,sizeof(*m));
+   if(morph_resize(m, src->k) != 0) return -1;
+   for(i=1;i<=src->k;i++)
+   {
+      m->ti[i] = src->ti[i];
+      m->ai[i] = src->ai[i];
+      m->bi[i] = src->bi[i];
+      m->tx[i] = src->tx[i];
+   }
+   return 0;
+}
+
+void morph_free(genmorph *m)
+{
+   free(m->ti);
+   free(m->ai);
+   free(m->bi);
+   free(m->tx);
+   memset(m,0,sizeof(*m));
+}
+
+/*---------------------------------------------------------------------------*/
+/*      MORPHOLOGY FILE                                                      */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Reads a morphology file into m (see morph.h for the format).
+//!
+//! @return 0 on success, -1 if the file cannot be read or has no kernels,
+//!         or the number of the first invalid line
+int morph_read(genmorph *m, const char *filename)
+{
+   char line[MAXLINE],*hash;
+   double ti,ai,bi,tx;
+   int n,lineno;
+   FILE *fp;
+
+   memset(m,0,sizeof(*m));
+   fp = fopen(filename,"r");
+   if(!fp) return -1;
+   for(lineno=1;fgets(line,sizeof(line),fp);lineno++)
+   {
+      if((hash = strchr(line,'#')) != NULL) *hash = '\0';
+      tx = 0.0;
+      n = sscanf(line,"%lf %lf %lf %lf",&ti,&ai,&bi,&tx);
+      if(n <= 0) continue;
+      if(n < 3 || morph_resize(m, m->k+1) != 0)
+      {
+         fclose(fp);
+         morph_free(m);
+         return lineno;
+      }
+      morph_set(m, m->k, 't', ti);
+      morph_set(m, m->k, 'a', ai);
+      morph_set(m, m->k, 'b', bi);
+      m->tx[m->k] = tx;
+   }
+   fclose(fp);
+   if(m->k < 1) return -1;
+   return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      OPTION LISTS                                                         */
+/*---------------------------------------------------------------------------*/
+
+/* number of comma separated values in list, -1 if one is not a number */
+static int list_count(const char *list)
+{
+   const char *s;
+   char *end;
+   int n;
+
+   for(s=list,n=0;;n++)
+   {
+      strtod(s,&end);
+      if(end == s) return -1;
+      while(*end == ' ') end++;
+      if(*end == '\0') return n+1;
+      if(*end != ',') return -1;
+      s = end+1;
+   }
+}
+
+static void list_parse(const char *list, double *v)
+{
+   char *end;
+   int i;
+
+   for(i=1;;i++)
+   {
+      v[i] = strtod(list,&end);
+      while(*end == ' ') end++;
+      if(*end != ',') break;
+      list = end+1;
+   }
+}
+
+//! @brief Replaces the angles, amplitudes and/or widths of m by the comma
+//! separated lists ti, ai and bi (empty string: keep). All lists given must
+//! have the same length; a length other than m->k changes the number of
+//! kernels and then needs all three lists.
+//!
+//! @return non-zero if a list is malformed or the lengths do not agree
+int morph_lists(genmorph *m, const char *ti, const char *ai, const char *bi)
+{
+   const char *list[3];
+   int c,n,k,given;
+
+   list[0] = ti; list[1] = ai; list[2] = bi;
+   k = 0;
+   given = 0;
+   for(c=0;c<3;c++)
+   {
+      if(list[c][0] == '\0') continue;
+      n = list_count(list[c]);
+      if(n < 1 || (k > 0 && n != k)) return -1;
+      k = n;
+      given++;
+   }
+   if(given == 0) return 0;
+   if(k != m->k)
+   {
+      if(given < 3 || morph_resize(m, k) != 0) return -1;
+   }
+   if(ti[0] != '\0') list_parse(ti, m->ti);
+   if(ai[0] != '\0') list_parse(ai, m->ai);
+   if(bi[0] != '\0') list_parse(bi, m->bi);
+   return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      SINGLE PARAMETERS                                                    */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Parses a parameter name "ti<i>", "ai<i>" or "bi<i>", 1 <= i <= k.
+//!
+//! @return non-zero if name is not a parameter of kernels 1..k
+int morph_param(const char *name, int k, int *wave, char *which)
+{
+   char *end;
+
+   if(strlen(name) < 3 || name[1] != 'i'
+      || (name[0] != 't' && name[0] != 'a' && name[0] != 'b')) return -1;
+   *wave = (int)strtol(name+2,&end,10);
+   if(*end != '\0' || *wave < 1 || *wave > k) return -1;
+   *which = name[0];
+   return 0;
+}
+
+void morph_set(genmorph *m, int wave, char which, double v)
+{
+   if(which == 't')      m->ti[wave] = v;
+   else if(which == 'a') m->ai[wave] = v;
+   else if(which == 'b') m->bi[wave] = v;
+}
@@ -0,0 +1,23 @@
+// "morph.h" - morphology tables from files and option lists.
+//
+// A morphology file has one Gaussian kernel per line:
+//
+//     ti ai bi [tx]
+//
+// the angle ti [degrees], the amplitude ai, the width bi and optionally the
+// heart rate exponent tx of the angle (default 0, i.e. a fixed angle). Blank
+// lines and text after '#' are ignored.
+
+#ifndef _MORPH_H
+#define _MORPH_H
+
+#include "gen.h"
+
+int  morph_copy(genmorph *m, const genmorph *src);
+int  morph_read(genmorph *m, const char *filename);
+int  morph_lists(genmorph *m, const char *ti, const char *ai, const char *bi);
+int  morph_param(const char *name, int k, int *wave, char *which);
+void morph_set(genmorph *m, int wave, char which, double v);
+void morph_free(genmorph *m);
+
+#endif /* _MORPH_H */
@@ -0,0 +1,122 @@
+// "partime.c" - parallel-in-time integration of one record.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "partime.h"
+#include "trace.h"
+
+#define ZGUESS 0.0   // z at the start of a warm-up
+
+//! @brief Splits the record of g (not yet stepped) into nseg segments of 
+//! about equal length that start on beats, and places a copy of g at the 
+//! start of the warm-up of each, `warmup` seconds before the segment.
+//!
+//! @return the number of segments, fewer than nseg if the record has fewer
+//! beats, or -1 if the integrator of g cannot be run ahead by gen_phase()
+int partime_plan(const gen *g, int nseg, double warmup, ptseg *seg)
+{
+   int s,n;
+   long j,target,nw;
+   double tecg;
+   gen ph;
+
+   if(nseg < 1) return -1;
+   nseg = MIN(nseg,PARTIME_MAXSEG);
+   nw = (long)(warmup*g->p.sf + 0.5);
+
+   /* segment starts: the first beat start at or after s*Nt/nseg, walking
+      the beats as the RR cursor of angfreq() does */
+   n = 0;
+   seg[0].beg = 1;
+   tecg = g->tecg;
+   j = g->rrend;
+   for(s=1;s<nseg;s++)
+   {
+      target = s*(g->Nt/nseg) + s*(g->Nt%nseg)/nseg + 1;
+      while(j+1 < target && j < g->Nrr)
+      {
+         tecg += g->rr[j];
+         j = lrint(tecg/g->h);
+      }
+      if(j+1 > g->Nt) break;
+      if(j+1 > seg[n].beg) seg[++n].beg = j+1;
+   }
+   n++;
+   for(s=0;s<n;s++)
+   {
+      seg[s].warm = s == 0 ? 1 : MAX(1,seg[s].beg-nw);
+      seg[s].end = s+1 < n ? seg[s+1].beg-1 : g->Nt;
+   }
+
+   /* run the phase oscillator ahead to the start of every warm-up */
+   ph = *g;
+   for(s=0;s<n;s++)
+   {
+      while(ph.it+1 < seg[s].warm)
+        if(gen_phase(&ph) != 0) return -1;
+      seg[s].g = ph;
+      if(seg[s].warm > 1) seg[s].g.x[3] = ZGUESS;
+   }
+   return n;
+}
+
+/* integrate one segment, keep the decimated output from its start on */
+static void *partime_worker(void *arg)
+{
+   ptseg *sg = (ptseg *)arg;
+   gen *g = &sg->g;
+   long i,j;
+
+   if(sg->s > 0) trace_thread("segment", sg->s);
+   trace_begin("warm-up");
+   for(i=sg->warm;i<sg->beg;i++) gen_step(g);
+   trace_end(sg->beg-sg->warm);
+   trace_begin("segment");
+   for(i=sg->beg;i<=sg->end;i++)
+   {
+      if((i-1)%sg->q == 0)
+      {
+         j = (i-1)/sg->q+1;
+         sg->x[j] = g->x[1];
+         sg->y[j] = g->x[2];
+         sg->z[j] = g->x[3];
+      }
+      gen_step(g);
+   }
+   trace_end(sg->end-sg->beg+1);
+   return NULL;
+}
+
+//! @brief Integrates the planned segments on one thread each and writes the
+//! output, decimated by q, to x, y, z [1..(Nt+q-1)/q].
+//!
+//! @return non-zero if a thread cannot be started
+int partime_run(ptseg *seg, int nseg, int q, double *x, double *y, double *z)
+{
+   int s,err;
+   pthread_t th[PARTIME_MAXSEG];
+
+   err = 0;
+   for(s=0;s<nseg;s++)
+   {
+      seg[s].q = q;
+      seg[s].s = s;
+      seg[s].x = x;
+      seg[s].y = y;
+      seg[s].z = z;
+   }
+   for(s=1;s<nseg;s++)
+      if(pthread_create(&th[s], NULL, partime_worker, &seg[s]) != 0) 
+      {
+         err = -1;
+         break;
+      }
+   partime_worker(&seg[0]);
+   trace_begin("join");
+   while(--s > 0) pthread_join(th[s], NULL);
+   trace_end(-1);
+   return err;
+}
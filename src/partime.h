@@ -0,0 +1,31 @@
+// "partime.h" - parallel-in-time integration of one record.
+//
+// The record is split at beat boundaries into segments that are integrated
+// on separate threads. x and y do not depend on z, so a cheap serial pass of
+// the phase oscillator alone (gen_phase) places every segment on the exact
+// phase, cursor and time of the serial integration. Only z is unknown at the
+// start of a segment; it relaxes with a time constant of 1 s, so each
+// segment starts a warm-up of some seconds early from a guess and its 
+// output is kept from the segment start on.
+
+#ifndef _PARTIME_H
+#define _PARTIME_H
+
+#include "gen.h"
+
+#define PARTIME_MAXSEG 256
+
+typedef struct ptseg {
+  gen g;               // context at the start of the warm-up
+  long warm;           // first internal sample of the warm-up
+  long beg;            // first internal sample of the segment (a beat start)
+  long end;            // last internal sample of the segment
+  int q;               // decimation factor of the output
+  int s;               // number of the segment
+  double *x,*y,*z;     // decimated output x[1..], y[1..], z[1..] (shared)
+} ptseg;
+
+int partime_plan(const gen *g, int nseg, double warmup, ptseg *seg);
+int partime_run(ptseg *seg, int nseg, int q, double *x, double *y, double *z);
+
+#endif /* _PARTIME_H */
@@ -4,6 +4,8 @@
 // http://numerical.recipes/routines/instc.html
 // C routines in Numerical Recipes Second Edition, by chapter and section.
 
+#include "ran1.h"
+
 /*---------------------------------------------------------------------------*/
 /*      DEFINITIONS FOR CONSTANTS                                            */
 /*---------------------------------------------------------------------------*/
@@ -19,7 +21,7 @@
 #define IQ 127773
 #define IR 2836
 
-#define NTAB 32
+#define NTAB RAN1_NTAB
 #define NDIV (1+(IM-1)/NTAB)
 
 // Random value maxiumum (RNMX), based on interval machine epsilon for binary32
@@ -39,33 +41,47 @@
 //! "Minimal Standard" generator proposed by Park and Miller (1969), with 
 //! Bays-Durham shuffle and added safeguards.
 //!
+//! Reentrant version: the shuffle table lives in `st` instead of in static
+//! storage, so each generator context can own an independent sequence.
+//!
 //! @param idum
+//! @param st     shuffle state, zero-initialised before first use
 //!
 //! @return a uniform deviate between 0.0 and 1.0
-float ran1(long *idum){
+float ran1_r(long *idum, ran1state *st){
 	int j;
 	long k;
-	static long iy=0;
-	static long iv[NTAB];
 	float temp;
 
-	if (*idum <= 0 || !iy) {
+	if (*idum <= 0 || !st->iy) {
 		if (-(*idum) < 1) *idum=1;
 		else *idum = -(*idum);
 		for (j=NTAB+7;j>=0;j--) {
 			k=(*idum)/IQ;
 			*idum=IA*(*idum-k*IQ)-IR*k;
 			if (*idum < 0) *idum += IM;
-			if (j < NTAB) iv[j] = *idum;
+			if (j < NTAB) st->iv[j] = *idum;
 		}
-		iy=iv[0];
+		st->iy=st->iv[0];
 	}
 	k=(*idum)/IQ;
 	*idum=IA*(*idum-k*IQ)-IR*k;
 	if (*idum < 0) *idum += IM;
-	j=iy/NDIV;
-	iy=iv[j];
-	iv[j] = *idum;
-	if ((temp=AM*iy) > RNMX) return RNMX;
+	j=st->iy/NDIV;
+	st->iy=st->iv[j];
+	st->iv[j] = *idum;
+	if ((temp=AM*st->iy) > RNMX) return RNMX;
 	else return temp;
 }
+
+//! @brief Generates a uniform deviate (random number) within range of 0 to 1,
+//! using a single shuffle table shared by the whole process.
+//!
+//! @param idum
+//!
+//! @return a uniform deviate between 0.0 and 1.0
+float ran1(long *idum){
+	static ran1state st;
+
+	return ran1_r(idum,&st);
+}
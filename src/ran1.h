@@ -0,0 +1,19 @@
+// "ran1.h" - random deviate, minimal standard plus shuffle.
+
+#ifndef _RAN1_H
+#define _RAN1_H
+
+// Length of the Bays-Durham shuffle table.
+#define RAN1_NTAB 32
+
+//! State of the shuffle of one ran1 generator, so that several independent
+//! generators can run in one process. A zeroed state is "not yet seeded".
+typedef struct ran1state {
+  long iy;
+  long iv[RAN1_NTAB];
+} ran1state;
+
+float ran1(long *idum);
+float ran1_r(long *idum, ran1state *st);
+
+#endif /* _RAN1_H */
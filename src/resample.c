@@ -0,0 +1,151 @@
+// "resample.c" - polyphase FIR resampler for any rational rate ratio.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "resample.h"
+
+#define PI (2.0*asin(1.0))
+
+static long gcd(long a, long b)
+{
+   long t;
+
+   while(b != 0)
+   {
+      t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+}
+
+/* modified Bessel function of the first kind, order 0 */
+static double bessi0(double x)
+{
+   int k;
+   double term,sum;
+
+   term = sum = 1.0;
+   for(k=1;k<100 && term > 1e-17*sum;k++)
+   {
+      term *= (x/(2.0*k))*(x/(2.0*k));
+      sum += term;
+   }
+   return sum;
+}
+
+//! @brief Designs the filter from fsin to fsout.
+//!
+//! @return non-zero if a rate is not positive, the filter would be 
+//! unreasonably large (up*ntaps > 2^22) or memory runs out
+int resample_init(resampler *r, int fsin, int fsout)
+{
+   int p,k,j,m,c;
+   double fc,t,w,sum,*hp;
+
+   memset(r,0,sizeof(*r));
+   if(fsin < 1 || fsout < 1) return -1;
+   m = (int)gcd(fsin,fsout);
+   r->up = fsout/m;
+   r->down = fsin/m;
+
+   /* cutoff in cycles per upsampled sample, RESAMPLE_ZEROS crossings a side */
+   m = r->up > r->down ? r->up : r->down;
+   fc = 0.5*RESAMPLE_CUTOFF/m;
+   c = RESAMPLE_ZEROS*m;
+   r->centre = c;
+   r->ntaps = 2*c/r->up + 1;
+   if((double)r->up*r->ntaps > 4194304.0) return -1;
+
+   r->h = (double *)calloc((size_t)r->up*r->ntaps, sizeof(double));
+   r->buf = (double *)calloc((size_t)2*r->ntaps*RESAMPLE_NCH, sizeof(double));
+   if(!r->h || !r->buf)
+   {
+      resample_free(r);
+      return -1;
+   }
+
+   /* split the prototype h(j), j = 0..2c, into the phases: tap k of phase p
+      weighs input frame ntaps-1-k frames before the newest */
+   for(p=0;p<r->up;p++)
+   {
+      hp = r->h + (long)p*r->ntaps;
+      sum = 0.0;
+      for(k=0;k<r->ntaps;k++)
+      {
+         j = p + (r->ntaps-1-k)*r->up;
+         if(j > 2*c) continue;
+         t = j-c;
+         w = bessi0(RESAMPLE_BETA*sqrt(1.0 - (t/c)*(t/c)))/bessi0(RESAMPLE_BETA);
+         hp[k] = (t == 0.0 ? 2.0*fc : sin(2.0*PI*fc*t)/(PI*t))*w;
+         sum += hp[k];
+      }
+      /* unit gain of every phase, so constants pass exactly */
+      for(k=0;k<r->ntaps;k++) hp[k] /= sum;
+   }
+   return 0;
+}
+
+//! @brief Number of output frames of an input of nin frames: all output
+//! times up to the time of the last input frame.
+long resample_count(const resampler *r, long nin)
+{
+   if(nin < 1) return 0;
+   return (nin-1)*r->up/r->down + 1;
+}
+
+//! @brief Pushes one input frame in[0..RESAMPLE_NCH-1] and writes the 
+//! output frames it completes to out (RESAMPLE_NCH values each), until nmax
+//! output frames have been produced in total.
+//!
+//! Output frame n needs the input up to frame (n*down+centre)/up; to end a 
+//! stream, push the last frame again until nmax frames are out.
+//!
+//! @return number of output frames written
+int resample_push(resampler *r, const double *in, double *out, long nmax)
+{
+   int k,c,n,K;
+   long top;
+   double acc[RESAMPLE_NCH];
+   const double *restrict hp,*restrict w;
+
+   K = r->ntaps;
+   if(r->nin == 0)
+   {
+      /* extend the stream backwards by its first frame */
+      for(k=0;k<2*K;k++) memcpy(r->buf+k*RESAMPLE_NCH, in, 
+                                RESAMPLE_NCH*sizeof(double));
+      r->pos = K-1;
+   }
+   else
+   {
+      r->pos = r->pos+1 == K ? 0 : r->pos+1;
+      memcpy(r->buf+r->pos*RESAMPLE_NCH, in, RESAMPLE_NCH*sizeof(double));
+      memcpy(r->buf+(r->pos+K)*RESAMPLE_NCH, in, RESAMPLE_NCH*sizeof(double));
+   }
+   r->nin++;
+
+   n = 0;
+   w = r->buf + (r->pos+1)*RESAMPLE_NCH;          // oldest frame of the window
+   while(r->nout < nmax)
+   {
+      top = r->nout*r->down + r->centre;
+      if(top/r->up > r->nin-1) break;
+      hp = r->h + (top % r->up)*K;
+      for(c=0;c<RESAMPLE_NCH;c++) acc[c] = 0.0;
+      for(k=0;k<K;k++)
+         for(c=0;c<RESAMPLE_NCH;c++) acc[c] += hp[k]*w[k*RESAMPLE_NCH+c];
+      memcpy(out+n*RESAMPLE_NCH, acc, RESAMPLE_NCH*sizeof(double));
+      r->nout++;
+      n++;
+   }
+   return n;
+}
+
+void resample_free(resampler *r)
+{
+   free(r->h);
+   free(r->buf);
+   memset(r,0,sizeof(*r));
+}
@@ -0,0 +1,38 @@
+// "resample.h" - polyphase FIR resampler for any rational rate ratio.
+//
+// Converts a stream sampled at fsin to fsout = fsin*up/down without the 
+// integer ratio that plain decimation needs. The prototype is a Kaiser 
+// windowed sinc at the upsampled rate fsin*up, cut off below the lower of the
+// two Nyquist frequencies, and split into `up` phases of ntaps taps each, so
+// every output costs one short dot product. The filter is applied centred
+// (zero delay): output sample n lands exactly on time n/fsout, input sample i
+// sits at i/fsin, and the stream is extended by its first and last sample at
+// the ends. Up to RESAMPLE_NCH channels share the filter and the timing; 
+// their samples are interleaved in the delay line, so the inner loop runs 
+// across channels in SIMD registers.
+
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+#define RESAMPLE_NCH    4    // channels per resampler (interleave width)
+#define RESAMPLE_ZEROS  16   // zero crossings of the sinc on each side
+#define RESAMPLE_CUTOFF 0.9  // cutoff as a fraction of the lower Nyquist
+#define RESAMPLE_BETA   8.0  // Kaiser window shape (about 80 dB stop band)
+
+typedef struct resampler {
+  int up,down;         // fsout/fsin = up/down, reduced
+  int ntaps;           // taps per phase
+  int centre;          // centre of the prototype [samples at fsin*up]
+  double *h;           // h[phase*ntaps + k], oldest input first
+  double *buf;         // delay line, 2*ntaps interleaved frames
+  int pos;             // newest frame of the delay line
+  long nin;            // number of input frames pushed
+  long nout;           // number of output frames produced
+} resampler;
+
+int  resample_init(resampler *r, int fsin, int fsout);
+long resample_count(const resampler *r, long nin);
+int  resample_push(resampler *r, const double *in, double *out, long nmax);
+void resample_free(resampler *r);
+
+#endif /* _RESAMPLE_H */
@@ -0,0 +1,107 @@
+// "rtpace.c" - real-time pacing of sample blocks against CLOCK_MONOTONIC.
+//
+// Block k of the output holds the samples measured during
+// [k*B, (k+1)*B)/fs on the sample clock, so it is released at the absolute
+// deadline t0 + (k+1)*B/fs. Deadlines are derived from the block count in
+// integer nanoseconds rather than by accumulating a period, so the output
+// rate never drifts from fs. The pacer does no allocation.
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "rtpace.h"
+
+/*---------------------------------------------------------------------------*/
+/*      MONOTONIC CLOCK IN NANOSECONDS                                       */
+/*---------------------------------------------------------------------------*/
+
+static long long now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      START SAMPLE CLOCK                                                   */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Starts the sample clock at the current time.
+//!
+//! @param p           pacer to initialise
+//! @param blocksize   number of samples per released block
+//! @param samplerate  output sampling frequency [Hz]
+void rtpace_start(rtpace *p, int blocksize, int samplerate){
+  memset(p,0,sizeof(*p));
+  p->blockns_num = (long long)blocksize*1000000000LL;
+  p->blockns_den = samplerate;
+  p->t0 = now_ns();
+}
+
+/*---------------------------------------------------------------------------*/
+/*      WAIT FOR NEXT DEADLINE                                               */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Sleeps until the deadline of the next block and records how late
+//! the wake-up was.
+//!
+//! @return 1 if the deadline had already passed when called (the block is
+//! released immediately), 0 otherwise
+int rtpace_wait(rtpace *p){
+
+  long long deadline,late;
+  struct timespec ts;
+  int missed,b;
+
+  p->nblocks++;
+  deadline = p->t0 + (p->nblocks*p->blockns_num)/p->blockns_den;
+
+  missed = (now_ns() > deadline);
+  if(!missed){
+    ts.tv_sec = deadline/1000000000LL;
+    ts.tv_nsec = deadline%1000000000LL;
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR)
+      ;
+  }
+  else p->nmissed++;
+
+  late = now_ns() - deadline;
+  if(late < 0) late = 0;
+  if(late > p->maxlate) p->maxlate = late;
+  p->sumlate += (double)late;
+
+  late /= 1000;
+  for(b=0;late > 0 && b < RTPACE_NBINS-1;b++) late >>= 1;
+  p->hist[b]++;
+
+  return missed;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      REPORT JITTER STATISTICS                                             */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Prints deadline misses and the wake-up jitter histogram.
+void rtpace_report(const rtpace *p, FILE *fp){
+
+  int b;
+
+  fprintf(fp,"Real-time blocks released: %ld\n",p->nblocks);
+  fprintf(fp,"Deadline misses: %ld\n",p->nmissed);
+  if(p->nblocks == 0) return;
+  fprintf(fp,"Wake-up latency: mean %.1f us, max %.1f us\n",
+          p->sumlate/p->nblocks/1000.0,p->maxlate/1000.0);
+  fprintf(fp,"Latency histogram [us]:\n");
+  for(b=0;b<RTPACE_NBINS;b++)
+  {
+    if(p->hist[b] == 0) continue;
+    if(b == 0)
+      fprintf(fp,"  %8s < %-8d %ld\n","",1,p->hist[b]);
+    else if(b == RTPACE_NBINS-1)
+      fprintf(fp,"  %8ld+ %8s %ld\n",1L<<(b-1),"",p->hist[b]);
+    else
+      fprintf(fp,"  %8ld - %-8ld %ld\n",1L<<(b-1),1L<<b,p->hist[b]);
+  }
+}
@@ -0,0 +1,28 @@
+// "rtpace.h" - real-time pacing of sample blocks against CLOCK_MONOTONIC.
+
+#ifndef _RTPACE_H
+#define _RTPACE_H
+
+#include <stdio.h>
+
+// Number of bins of the wake-up jitter histogram. Bin 0 counts wake-ups less
+// than 1 us after their deadline, bin b counts [2^(b-1), 2^b) us and the last
+// bin everything beyond.
+#define RTPACE_NBINS 20
+
+typedef struct rtpace {
+  long long t0;                 // start of the sample clock [ns]
+  long long blockns_num;        // block period numerator: blocksize*1e9
+  long long blockns_den;        // block period denominator: sampling rate
+  long nblocks;                 // number of blocks released so far
+  long nmissed;                 // blocks whose deadline had already passed
+  long long maxlate;            // largest lateness seen [ns]
+  double sumlate;               // sum of lateness [ns], for the mean
+  long hist[RTPACE_NBINS];      // lateness histogram, see RTPACE_NBINS
+} rtpace;
+
+void rtpace_start(rtpace *p, int blocksize, int samplerate);
+int  rtpace_wait(rtpace *p);
+void rtpace_report(const rtpace *p, FILE *fp);
+
+#endif /* _RTPACE_H */
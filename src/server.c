@@ -0,0 +1,703 @@
+// "server.c" - multi-client ECG streaming server.
+//
+// Every connection is a virtual patient: it gets its own generator context
+// (seeded with the server seed plus the patient number) and receives that
+// patient's ECG as a real-time stream of blocks in the selected output
+// format, until the record ends.
+//
+// One thread runs an epoll loop over the listening socket, all client
+// sockets, a timerfd ticking once per block period and an eventfd through
+// which the workers report finished blocks. At every tick each idle client
+// gets a job queued for the worker pool, which runs gen_block() and formats
+// the samples; the event loop then writes them with non-blocking sends.
+// A client that has not drained its previous block by the next tick skips
+// that tick (an overrun) instead of buffering without bound.
+//
+// A client may change its patient while streaming by sending text lines of
+// name=value pairs, e.g. "hrmean=140 hrstd=4" or "ai3=20 bi3=0.15 Anoise=0.1".
+// The generator applies each line as a whole at the next beat boundary.
+//
+// With tracing on (trace.h) the workers record their waits, jobs and the
+// length of the job queue, the event loop its waits, ticks and sends, and
+// SIGINT or SIGTERM stops the server so that the trace can be written.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include "gen.h"
+#include "sink.h"
+#include "server.h"
+#include "trace.h"
+
+#define MAXEVENTS 256
+#define MAXCMD 256
+#define MAXSPARE 64           // clients kept, with their memory, for reuse
+
+/*---------------------------------------------------------------------------*/
+/*      CLIENT AND SERVER STATE                                              */
+/*---------------------------------------------------------------------------*/
+
+typedef struct client {
+  int fd;                     // connected socket
+  int id;                     // patient number
+  arena mem;                  // memory of the patient, kept for the next one
+  gen g;                      // generator context of this patient
+  int ready;                  // generator initialised (by a worker)
+  int busy;                   // job queued or running; set by the event loop
+  int closing;                // peer gone or error: free once not busy
+  int eof;                    // record finished
+  int wantout;                // EPOLLOUT registered
+  int started;                // ready seen by the event loop
+  char cmd[MAXCMD];           // received command text not yet parsed
+  int ncmd;                   // bytes in cmd
+  long n0;                    // number of samples generated so far
+  double *z,*ipeak;           // samples of the current block
+  char *out;                  // formatted block
+  long outlen,outoff;         // bytes in out, bytes already sent
+  long overruns;              // ticks skipped because out was not drained
+  struct client *next;        // link in the job queue or the done list
+  struct client *prev,*succ;  // link in the list of all clients
+} client;
+
+typedef struct server {
+  genparams p;                // model parameters of every patient
+  int blocksize;              // samples per block
+  int format;                 // output format, see sink.h
+  int norm;                   // range of every stream, GEN_NORM_*
+  int lfd,tfd,efd,epfd;       // listening socket, timer, eventfd, epoll
+  int nextid;                 // number of the next patient
+  int nclients;               // number of connected clients
+  client *all;                // all clients
+  client *spare;              // disconnected clients kept for reuse
+  int nspare;                 // number of spare clients
+
+  pthread_mutex_t mu;         // protects the job queue and the done list
+  pthread_cond_t cv;          // signals jobs to the workers
+  client *jobhead,*jobtail;   // clients waiting for a worker
+  int njobs;                  // number of clients waiting for a worker
+  client *done;               // clients whose job has finished
+  int stop;                   // tells the workers to exit
+} server;
+
+/* distinct epoll tags for the non-client descriptors */
+static char tag_listen, tag_timer, tag_event;
+
+/* set by SIGINT or SIGTERM while tracing */
+static volatile sig_atomic_t quit;
+
+static void onquit(int sig)
+{
+   quit = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      WORKER POOL                                                          */
+/*---------------------------------------------------------------------------*/
+
+/* generate (or, for a new client, set up) one block for client c */
+static void client_job(server *sv, client *c)
+{
+   genparams p;
+   int n;
+
+   if(!c->ready)
+   {
+      p = sv->p;
+      p.seed = sv->p.seed + c->id;
+      trace_begin("init");
+      if(gen_initmem(&c->g, &p, &c->mem) != 0)
+      {
+         trace_end(-1);
+         c->closing = 1;
+         return;
+      }
+      gen_range(&c->g, sv->norm);
+      trace_end(c->g.Nt);
+      c->ready = 1;
+      return;
+   }
+
+   trace_begin("gen_block");
+   n = gen_block(&c->g, c->z, c->ipeak, sv->blocksize);
+   trace_end(n);
+   trace_begin("pack");
+   c->outlen = sink_pack(sv->format, 1.0/sv->p.sfecg, c->n0, c->z, c->ipeak,
+                         n, c->out);
+   trace_end(c->outlen);
+   c->outoff = 0;
+   c->n0 += n;
+   if(n < sv->blocksize) c->eof = 1;
+}
+
+static void *worker(void *arg)
+{
+   server *sv = (server *)arg;
+   client *c;
+   uint64_t one = 1;
+
+   trace_thread("worker", -1);
+   for(;;)
+   {
+      trace_begin("wait");
+      pthread_mutex_lock(&sv->mu);
+      while(!sv->jobhead && !sv->stop) pthread_cond_wait(&sv->cv, &sv->mu);
+      if(sv->stop)
+      {
+         pthread_mutex_unlock(&sv->mu);
+         trace_end(-1);
+         return NULL;
+      }
+      c = sv->jobhead;
+      sv->jobhead = c->next;
+      if(!sv->jobhead) sv->jobtail = NULL;
+      trace_count("jobs", --sv->njobs);
+      pthread_mutex_unlock(&sv->mu);
+      trace_end(-1);
+
+      trace_begin("job");
+      client_job(sv, c);
+      trace_end(c->id);
+
+      pthread_mutex_lock(&sv->mu);
+      c->next = sv->done;
+      sv->done = c;
+      pthread_mutex_unlock(&sv->mu);
+      if(write(sv->efd, &one, sizeof(one)) < 0) perror("eventfd");
+   }
+}
+
+static void enqueue(server *sv, client *c)
+{
+   c->busy = 1;
+   c->next = NULL;
+   pthread_mutex_lock(&sv->mu);
+   if(sv->jobtail) sv->jobtail->next = c;
+   else            sv->jobhead = c;
+   sv->jobtail = c;
+   trace_count("jobs", ++sv->njobs);
+   pthread_cond_signal(&sv->cv);
+   pthread_mutex_unlock(&sv->mu);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      CLIENTS                                                              */
+/*---------------------------------------------------------------------------*/
+
+/* A client with its block buffers: a spare one, whose arena is rewound for
+   the new patient, or a new one. After the first few patients, patients
+   come and go without any allocation. */
+static client *client_new(server *sv)
+{
+   client *c;
+   arena mem;
+
+   c = sv->spare;
+   if(c)
+   {
+      sv->spare = c->next;
+      sv->nspare--;
+      mem = c->mem;
+      if(arena_reset(&mem) != 0) arena_init(&mem, 0);
+   }
+   else
+   {
+      c = (client *)malloc(sizeof(client));
+      if(!c) return NULL;
+      arena_init(&mem, 0);
+   }
+   memset(c,0,sizeof(*c));
+   c->mem = mem;
+   c->z = arena_vect(&c->mem,0,2*sv->blocksize-1);
+   c->out = (char *)arena_alloc(&c->mem, (size_t)sv->blocksize*SINK_MAXREC);
+   if(!c->z || !c->out)
+   {
+      arena_free(&c->mem);
+      free(c);
+      return NULL;
+   }
+   c->ipeak = c->z + sv->blocksize;
+   return c;
+}
+
+static void client_free(server *sv, client *c)
+{
+   fprintf(stderr,"Patient %d: disconnected after %ld samples (%ld overruns)\n",
+           c->id, c->n0, c->overruns);
+   epoll_ctl(sv->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+   close(c->fd);
+   if(c->prev) c->prev->succ = c->succ;
+   else        sv->all = c->succ;
+   if(c->succ) c->succ->prev = c->prev;
+   if(c->ready) gen_free(&c->g);
+   sv->nclients--;
+   if(sv->nspare < MAXSPARE)
+   {
+      c->next = sv->spare;
+      sv->spare = c;
+      sv->nspare++;
+      return;
+   }
+   arena_free(&c->mem);
+   free(c);
+}
+
+static void client_want(server *sv, client *c, int wantout)
+{
+   struct epoll_event ev;
+
+   if(c->wantout == wantout) return;
+   c->wantout = wantout;
+   ev.events = EPOLLIN | EPOLLRDHUP | (wantout ? EPOLLOUT : 0);
+   ev.data.ptr = c;
+   epoll_ctl(sv->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/* send as much of the pending block as the socket takes */
+static void client_flush(server *sv, client *c)
+{
+   ssize_t len;
+   long off0;
+
+   off0 = c->outoff;
+   trace_begin("send");
+   while(c->outoff < c->outlen)
+   {
+      len = send(c->fd, c->out+c->outoff, c->outlen-c->outoff, MSG_NOSIGNAL);
+      if(len < 0)
+      {
+         if(errno == EINTR) continue;
+         if(errno != EAGAIN && errno != EWOULDBLOCK) c->closing = 1;
+         break;
+      }
+      c->outoff += len;
+   }
+   trace_end(c->outoff-off0);
+   client_want(sv, c, !c->closing && c->outoff < c->outlen);
+   if(c->eof && c->outoff >= c->outlen) c->closing = 1;
+}
+
+static void client_accept(server *sv)
+{
+   struct epoll_event ev;
+   client *c;
+   int fd;
+
+   while((fd = accept4(sv->lfd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC)) >= 0)
+   {
+      c = client_new(sv);
+      if(!c)
+      {
+         fprintf(stderr,"Out of memory, refusing connection\n");
+         close(fd);
+         continue;
+      }
+      c->fd = fd;
+      c->id = sv->nextid++;
+
+      ev.events = EPOLLIN | EPOLLRDHUP;
+      ev.data.ptr = c;
+      epoll_ctl(sv->epfd, EPOLL_CTL_ADD, fd, &ev);
+      c->succ = sv->all;
+      if(sv->all) sv->all->prev = c;
+      sv->all = c;
+      sv->nclients++;
+      fprintf(stderr,"Patient %d: connected (%d streams)\n",c->id,sv->nclients);
+
+      enqueue(sv, c);
+   }
+}
+
+/* the update of kernel wave (0: hrmean, hrstd, Anoise) among u[0..*n-1],
+   added if the line has none yet; NULL once the line holds GEN_NUPDATES */
+static genupdate *client_update(genupdate *u, int *n, int wave)
+{
+   int i;
+
+   for(i=0;i<*n;i++) if(u[i].wave == wave) return &u[i];
+   if(*n == GEN_NUPDATES) return NULL;
+   memset(&u[*n], 0, sizeof(genupdate));
+   u[*n].wave = wave;
+   return &u[(*n)++];
+}
+
+/* parse one "name=value ..." line into at most GEN_NUPDATES updates, one
+   per kernel it changes; returns their number or -1 */
+static int client_parse(client *c, char *line, genupdate *u)
+{
+   char *tok,*val,*end,*save;
+   double v;
+   genupdate *w;
+   int n,wave,mask;
+
+   n = 0;
+   for(tok=strtok_r(line," \t\r",&save);tok;tok=strtok_r(NULL," \t\r",&save))
+   {
+      val = strchr(tok,'=');
+      if(!val) return -1;
+      *val++ = '\0';
+      v = strtod(val,&end);
+      if(end == val || *end != '\0') return -1;
+
+      wave = 0;
+      if(strcmp(tok,"hrmean") == 0)      mask = GEN_SET_HRMEAN;
+      else if(strcmp(tok,"hrstd") == 0)  mask = GEN_SET_HRSTD;
+      else if(strcmp(tok,"Anoise") == 0) mask = GEN_SET_ANOISE;
+      else
+      {
+         /* ti<i>, ai<i>, bi<i> of kernel i */
+         if(strlen(tok) < 3 || tok[1] != 'i') return -1;
+         wave = (int)strtol(tok+2,&end,10);
+         if(*end != '\0' || wave < 1 || wave > c->g.k) return -1;
+         if(tok[0] == 't')      mask = GEN_SET_TI;
+         else if(tok[0] == 'a') mask = GEN_SET_AI;
+         else if(tok[0] == 'b') mask = GEN_SET_BI;
+         else return -1;
+      }
+
+      if((w = client_update(u,&n,wave)) == NULL) return -1;
+      w->mask |= mask;
+      if(mask == GEN_SET_HRMEAN)      w->hrmean = v;
+      else if(mask == GEN_SET_HRSTD)  w->hrstd = v;
+      else if(mask == GEN_SET_ANOISE) w->Anoise = v;
+      else if(mask == GEN_SET_TI)     w->ti = v;
+      else if(mask == GEN_SET_AI)     w->ai = v;
+      else                            w->bi = v;
+   }
+   return n;
+}
+
+/* hand the complete lines received so far to the generator */
+static void client_commands(client *c)
+{
+   genupdate u[GEN_NUPDATES];
+   char *nl,*line;
+   int n;
+
+   if(!c->started) return;
+   line = c->cmd;
+   while((nl = memchr(line, '\n', c->cmd+c->ncmd-line)) != NULL)
+   {
+      *nl = '\0';
+      n = client_parse(c, line, u);
+      if(n < 0)
+         fprintf(stderr,"Patient %d: update rejected (malformed or too many "
+                 "kernels)\n",c->id);
+      else if(gen_post(&c->g, u, n) != 0)
+         fprintf(stderr,"Patient %d: ignoring update\n",c->id);
+      line = nl+1;
+   }
+   c->ncmd -= line-c->cmd;
+   memmove(c->cmd, line, c->ncmd);
+}
+
+/* read parameter updates from the client and watch for EOF */
+static void client_read(client *c)
+{
+   ssize_t len;
+
+   for(;;)
+   {
+      if(c->ncmd == MAXCMD)
+      {
+         fprintf(stderr,"Patient %d: update too long, discarded\n",c->id);
+         c->ncmd = 0;
+      }
+      len = recv(c->fd, c->cmd+c->ncmd, MAXCMD-c->ncmd, 0);
+      if(len <= 0) break;
+      c->ncmd += len;
+      client_commands(c);
+   }
+   if(len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+      c->closing = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      LISTENING SOCKET                                                     */
+/*---------------------------------------------------------------------------*/
+
+/* "unix:path", "tcp:port" (loopback) or "tcp:host:port" */
+static int server_listen(const char *addr)
+{
+   struct sockaddr_un sun;
+   struct addrinfo hints,*res,*ai;
+   char host[100];
+   const char *port;
+   int fd,one = 1;
+
+   if(strncmp(addr,"unix:",5) == 0)
+   {
+      memset(&sun,0,sizeof(sun));
+      sun.sun_family = AF_UNIX;
+      if(strlen(addr+5) >= sizeof(sun.sun_path)) return -1;
+      strcpy(sun.sun_path, addr+5);
+      unlink(sun.sun_path);
+      fd = socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+      if(fd < 0) return -1;
+      if(bind(fd,(struct sockaddr *)&sun,sizeof(sun)) < 0
+         || listen(fd,SOMAXCONN) < 0)
+      {
+         close(fd);
+         return -1;
+      }
+      return fd;
+   }
+
+   if(strncmp(addr,"tcp:",4) != 0) return -1;
+   addr += 4;
+   port = strrchr(addr,':');
+   if(port)
+   {
+      if(port-addr >= (long)sizeof(host)) return -1;
+      memcpy(host,addr,port-addr);
+      host[port-addr] = '\0';
+      port++;
+   }
+   else
+   {
+      strcpy(host,"127.0.0.1");
+      port = addr;
+   }
+
+   memset(&hints,0,sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = AI_PASSIVE;
+   if(getaddrinfo(host, port, &hints, &res) != 0) return -1;
+   fd = -1;
+   for(ai=res;ai;ai=ai->ai_next)
+   {
+      fd = socket(ai->ai_family, ai->ai_socktype|SOCK_NONBLOCK|SOCK_CLOEXEC,
+                  ai->ai_protocol);
+      if(fd < 0) continue;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if(bind(fd, ai->ai_addr, ai->ai_addrlen) == 0
+         && listen(fd, SOMAXCONN) == 0) break;
+      close(fd);
+      fd = -1;
+   }
+   freeaddrinfo(res);
+   return fd;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      EVENT LOOP                                                           */
+/*---------------------------------------------------------------------------*/
+
+/* timer tick: queue one block for every idle client. If the loop fell
+   behind, the timer has expired ticks times since the last read; the blocks
+   of the ticks-1 missed ones are not made up but count as overruns. */
+static void server_tick(server *sv, uint64_t ticks)
+{
+   client *c;
+
+   for(c=sv->all;c;c=c->succ)
+   {
+      if(!c->ready || c->eof || c->closing) continue;
+      if(ticks > 1)
+      {
+         c->overruns += (long)(ticks-1);
+         trace_instant("overrun", c->id);
+      }
+      if(c->busy) continue;
+      if(c->outoff < c->outlen) 
+      { 
+         c->overruns++; 
+         trace_instant("overrun", c->id);
+         continue; 
+      }
+      enqueue(sv, c);
+   }
+}
+
+/* collect the clients whose jobs have finished */
+static void server_done(server *sv)
+{
+   client *c,*next;
+   uint64_t cnt;
+
+   if(read(sv->efd, &cnt, sizeof(cnt)) < 0) return;
+   pthread_mutex_lock(&sv->mu);
+   c = sv->done;
+   sv->done = NULL;
+   pthread_mutex_unlock(&sv->mu);
+
+   for(;c;c=next)
+   {
+      next = c->next;
+      c->busy = 0;
+      if(c->ready && !c->started)
+      {
+         c->started = 1;
+         client_commands(c);
+      }
+      if(!c->closing) client_flush(sv, c);
+   }
+}
+
+/* free the clients that are closing and no longer owned by a worker */
+static void server_reap(server *sv)
+{
+   client *c,*succ;
+
+   for(c=sv->all;c;c=succ)
+   {
+      succ = c->succ;
+      if(c->closing && !c->busy) client_free(sv, c);
+   }
+}
+
+//! @brief Serves ECG streams on `addr` until the process is terminated, or
+//! while tracing, until SIGINT or SIGTERM.
+//!
+//! @param addr       "tcp:port", "tcp:host:port" or "unix:path"
+//! @param p          model parameters; patient i uses seed p->seed + i
+//! @param nworkers   number of generator threads
+//! @param blocksize  samples per block; one block per client per tick
+//! @param format     output format, see sink.h
+//! @param norm       range the streams are scaled by, GEN_NORM_*
+//!
+//! @return zero if stopped by a signal while tracing, non-zero on an error
+int server_run(const char *addr, const genparams *p, int nworkers,
+               int blocksize, int format, int norm)
+{
+   server sv;
+   struct sigaction sa;
+   struct epoll_event ev,events[MAXEVENTS];
+   struct itimerspec its;
+   pthread_t *threads;
+   long long period;
+   const char *msg;
+   client *c;
+   uint64_t ticks;
+   int i,n,err;
+
+   if((msg = gen_check(p)) != NULL) {
+     fprintf(stderr,"%s!\n",msg);
+     return 1;}
+   if(format < 0 || blocksize < 1 || nworkers < 1 
+      || norm < GEN_NORM_PRESCAN || norm > GEN_NORM_BOUND) {
+     fprintf(stderr,"Invalid output format, block size, number of threads or range\n");
+     return 1;}
+
+   memset(&sv,0,sizeof(sv));
+   sv.p = *p;
+   sv.blocksize = blocksize;
+   sv.format = format;
+   sv.norm = norm;
+   pthread_mutex_init(&sv.mu, NULL);
+   pthread_cond_init(&sv.cv, NULL);
+   signal(SIGPIPE, SIG_IGN);
+   if(trace_on())
+   {
+      /* no SA_RESTART: epoll_wait returns with EINTR */
+      memset(&sa,0,sizeof(sa));
+      sa.sa_handler = onquit;
+      sigaction(SIGINT, &sa, NULL);
+      sigaction(SIGTERM, &sa, NULL);
+      trace_thread("event loop", -1);
+   }
+
+   sv.lfd = server_listen(addr);
+   if(sv.lfd < 0) {
+     fprintf(stderr,"Cannot listen on %s: %s\n",addr,strerror(errno));
+     return 1;}
+
+   /* one tick per block period */
+   period = (long long)blocksize*1000000000LL/p->sfecg;
+   memset(&its,0,sizeof(its));
+   its.it_value.tv_sec = its.it_interval.tv_sec = period/1000000000LL;
+   its.it_value.tv_nsec = its.it_interval.tv_nsec = period%1000000000LL;
+   sv.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+   sv.efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+   sv.epfd = epoll_create1(EPOLL_CLOEXEC);
+   if(sv.tfd < 0 || sv.efd < 0 || sv.epfd < 0
+      || timerfd_settime(sv.tfd, 0, &its, NULL) < 0) {
+     perror("ecgsyn server");
+     return 1;}
+
+   ev.events = EPOLLIN;
+   ev.data.ptr = &tag_listen;
+   epoll_ctl(sv.epfd, EPOLL_CTL_ADD, sv.lfd, &ev);
+   ev.data.ptr = &tag_timer;
+   epoll_ctl(sv.epfd, EPOLL_CTL_ADD, sv.tfd, &ev);
+   ev.data.ptr = &tag_event;
+   epoll_ctl(sv.epfd, EPOLL_CTL_ADD, sv.efd, &ev);
+
+   threads = (pthread_t *)malloc(nworkers*sizeof(pthread_t));
+   if(!threads) {
+     fprintf(stderr,"Out of memory for %d generator threads\n",nworkers);
+     return 1;}
+   for(i=0,err=0;i<nworkers && !err;i++)
+      err = pthread_create(&threads[i], NULL, worker, &sv);
+   if(err)
+   {
+      fprintf(stderr,"Cannot start %d generator threads: %s\n",nworkers,
+              strerror(err));
+      nworkers = i-1;
+      goto stop;
+   }
+
+   fprintf(stderr,"Serving ECG streams on %s with %d generator threads\n",
+           addr, nworkers);
+
+   for(;;)
+   {
+      trace_begin("epoll_wait");
+      n = epoll_wait(sv.epfd, events, MAXEVENTS, -1);
+      trace_end(n);
+      if(n < 0)
+      {
+         if(errno == EINTR && quit) break;
+         if(errno == EINTR) continue;
+         perror("epoll_wait");
+         break;
+      }
+      for(i=0;i<n;i++)
+      {
+         if(events[i].data.ptr == &tag_listen) client_accept(&sv);
+         else if(events[i].data.ptr == &tag_timer)
+         {
+            trace_begin("tick");
+            if(read(sv.tfd, &ticks, sizeof(ticks)) > 0) server_tick(&sv, ticks);
+            trace_end(sv.nclients);
+         }
+         else if(events[i].data.ptr == &tag_event) 
+         {
+            trace_begin("done");
+            server_done(&sv);
+            trace_end(-1);
+         }
+         else
+         {
+            c = (client *)events[i].data.ptr;
+            if(events[i].events & EPOLLIN) client_read(c);
+            if(events[i].events & (EPOLLRDHUP|EPOLLHUP|EPOLLERR)) c->closing = 1;
+            if((events[i].events & EPOLLOUT) && !c->closing) client_flush(&sv, c);
+         }
+      }
+      server_reap(&sv);
+   }
+
+stop:
+   pthread_mutex_lock(&sv.mu);
+   sv.stop = 1;
+   pthread_cond_broadcast(&sv.cv);
+   pthread_mutex_unlock(&sv.mu);
+   for(i=0;i<nworkers;i++) pthread_join(threads[i], NULL);
+   free(threads);
+   if(quit) fprintf(stderr,"Server stopped\n");
+   return quit ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+// "server.h" - multi-client ECG streaming server.
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include "gen.h"
+
+int server_run(const char *addr, const genparams *p, int nworkers,
+               int blocksize, int format, int norm);
+
+#endif /* _SERVER_H */
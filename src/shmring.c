@@ -0,0 +1,204 @@
+// "shmring.c" - lock-free shared-memory ring of ECG samples.
+//
+// The producer owns the ring and is the only writer. Sample s goes to slot
+// s mod nslots, which is rewritten under a per-slot sequence lock: the slot
+// sequence number is set to SHMRING_BUSY, the sample is stored and the
+// sequence number is set to s with release semantics. The header's head
+// counter is advanced once per published block. Consumers never write to
+// the ring, so any number of them can follow the producer at their own
+// pace; one that falls more than nslots samples behind loses the oldest
+// samples and is told so.
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmring.h"
+
+#define LOAD_ACQ(p)     __atomic_load_n(p,__ATOMIC_ACQUIRE)
+#define LOAD_RLX(p)     __atomic_load_n(p,__ATOMIC_RELAXED)
+#define STORE_REL(p,v)  __atomic_store_n(p,v,__ATOMIC_RELEASE)
+#define STORE_RLX(p,v)  __atomic_store_n(p,v,__ATOMIC_RELAXED)
+
+/*---------------------------------------------------------------------------*/
+/*      PRODUCER                                                             */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Creates (or replaces) the shared-memory ring `name`.
+//!
+//! @param r       ring to initialise
+//! @param name    POSIX shared-memory name, e.g. "/ecgsyn"
+//! @param nslots  capacity in samples, rounded up to a power of two
+//! @param tstep   sampling interval of the samples [s]
+//!
+//! @return 0 on success, -1 on error (errno is set)
+int shmring_create(shmring *r, const char *name, long nslots, double tstep){
+
+  long n;
+  int fd;
+  void *p;
+
+  for(n=1;n < nslots;n <<= 1) ;
+  memset(r,0,sizeof(*r));
+  r->size = (long)sizeof(shmring_hdr) + n*(long)sizeof(shmring_slot);
+
+  shm_unlink(name);
+  fd = shm_open(name,O_RDWR|O_CREAT|O_EXCL,0644);
+  if(fd < 0) return -1;
+  if(ftruncate(fd,r->size) < 0){
+    close(fd);
+    return -1;
+  }
+  p = mmap(NULL,r->size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if(p == MAP_FAILED) return -1;
+
+  r->hdr = (shmring_hdr *)p;
+  r->slot = (shmring_slot *)(r->hdr+1);
+  r->mask = n-1;
+  r->hdr->nslots = (uint32_t)n;
+  r->hdr->slotsize = sizeof(shmring_slot);
+  r->hdr->tstep = tstep;
+  r->hdr->version = SHMRING_VERSION;
+  for(n=0;n<=(long)r->mask;n++) r->slot[n].seq = SHMRING_BUSY;
+  STORE_REL(&r->hdr->magic,SHMRING_MAGIC);
+  return 0;
+}
+
+//! @brief Publishes a block of samples and their labels.
+void shmring_publish(shmring *r, const double *z, const double *ipeak, int n){
+
+  shmring_slot *sl;
+  int i;
+
+  for(i=0;i<n;i++,r->head++){
+    sl = &r->slot[r->head & r->mask];
+    STORE_RLX(&sl->seq,SHMRING_BUSY);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    sl->z = (float)z[i];
+    sl->label = (int32_t)ipeak[i];
+    STORE_REL(&sl->seq,r->head);
+  }
+  STORE_REL(&r->hdr->head,r->head);
+}
+
+//! @brief Marks the record as complete and unmaps the ring. The shared-memory
+//! object stays in place for the consumers until the next producer replaces
+//! it (or it is removed with shm_unlink).
+void shmring_close(shmring *r){
+  STORE_REL(&r->hdr->closed,1);
+  munmap(r->hdr,r->size);
+  r->hdr = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      CONSUMER                                                             */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Maps the ring `name` read-only.
+//!
+//! The slot count must be a non-zero power of two, as the slot of a sample
+//! is its index masked with nslots-1.
+//! @return 0 on success, -1 if it does not exist or is not an ECGSYN ring
+int shmring_attach(shmring *r, const char *name){
+
+  struct stat st;
+  shmring_hdr *h;
+  int fd;
+  void *p;
+
+  memset(r,0,sizeof(*r));
+  fd = shm_open(name,O_RDONLY,0);
+  if(fd < 0) return -1;
+  if(fstat(fd,&st) < 0 || st.st_size < (long)sizeof(shmring_hdr)){
+    close(fd);
+    return -1;
+  }
+  p = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(p == MAP_FAILED) return -1;
+
+  h = (shmring_hdr *)p;
+  if(LOAD_ACQ(&h->magic) != SHMRING_MAGIC || h->version != SHMRING_VERSION
+     || h->slotsize != sizeof(shmring_slot)
+     || h->nslots == 0 || (h->nslots & (h->nslots-1)) != 0
+     || st.st_size < (long)(sizeof(shmring_hdr)
+                            + h->nslots*(long)sizeof(shmring_slot))){
+    munmap(p,st.st_size);
+    return -1;
+  }
+  r->hdr = h;
+  r->slot = (shmring_slot *)(h+1);
+  r->mask = h->nslots-1;
+  r->size = st.st_size;
+  return 0;
+}
+
+//! @brief Number of samples published so far.
+uint64_t shmring_head(shmring *r){
+  return LOAD_ACQ(&r->hdr->head);
+}
+
+//! @brief Slot holding sample `pos`, for reading it in place. The sample is
+//! valid if shmring_check() confirms it after reading.
+const shmring_slot *shmring_at(shmring *r, uint64_t pos){
+  return &r->slot[pos & r->mask];
+}
+
+//! @brief Checks that the slot of sample `pos` still holds that sample, i.e.
+//! that it was not being overwritten while the caller read it in place.
+int shmring_check(shmring *r, uint64_t pos){
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return LOAD_RLX(&r->slot[pos & r->mask].seq) == pos;
+}
+
+//! @brief Copies up to n samples starting at *pos and advances *pos.
+//!
+//! @return number of samples copied (0 if none is available yet), or -1 if
+//! the consumer fell behind and samples were lost; *pos then points to the
+//! oldest sample still in the ring.
+long shmring_read(shmring *r, uint64_t *pos, float *z, int32_t *label,
+                  long n){
+
+  const shmring_slot *sl;
+  uint64_t head;
+  long i;
+
+  head = LOAD_ACQ(&r->hdr->head);
+  if(head - *pos > r->mask+1){
+    *pos = head - (r->mask+1);
+    return -1;
+  }
+  if((uint64_t)n > head - *pos) n = (long)(head - *pos);
+
+  for(i=0;i<n;i++){
+    sl = &r->slot[(*pos+i) & r->mask];
+    if(LOAD_ACQ(&sl->seq) != *pos+i) break;
+    z[i] = sl->z;
+    label[i] = sl->label;
+    if(!shmring_check(r,*pos+i)) break;
+  }
+  if(i < n){
+    /* overtaken by the producer while reading */
+    head = LOAD_ACQ(&r->hdr->head);
+    *pos = head - (r->mask+1);
+    return -1;
+  }
+  *pos += n;
+  return n;
+}
+
+//! @brief Non-zero once the producer has published the whole record.
+int shmring_closed(shmring *r){
+  return (int)LOAD_ACQ(&r->hdr->closed);
+}
+
+//! @brief Unmaps a ring mapped by shmring_attach().
+void shmring_detach(shmring *r){
+  munmap(r->hdr,r->size);
+  r->hdr = NULL;
+}
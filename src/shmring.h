@@ -0,0 +1,60 @@
+// "shmring.h" - lock-free shared-memory ring of ECG samples.
+//
+// A single producer publishes samples with their PQRST labels into a POSIX
+// shared-memory object; any number of consumer processes map the same
+// object read-only and read the samples in place. Every sample carries its
+// sequence number (its index in the record), so a consumer can tell both
+// how far it is behind the producer and whether a slot was overwritten
+// while it was reading it.
+
+#ifndef _SHMRING_H
+#define _SHMRING_H
+
+#include <stdint.h>
+
+#define SHMRING_MAGIC   0x52474345u   // "ECGR"
+#define SHMRING_VERSION 1
+#define SHMRING_BUSY    UINT64_MAX    // slot.seq while the slot is rewritten
+
+typedef struct shmring_slot {
+  uint64_t seq;        // sequence number of the sample, or SHMRING_BUSY
+  float z;             // voltage [mV]
+  int32_t label;       // PQRST peak label
+} shmring_slot;
+
+typedef struct shmring_hdr {
+  uint32_t magic;      // SHMRING_MAGIC
+  uint32_t version;    // SHMRING_VERSION
+  uint32_t nslots;     // number of slots, a power of two
+  uint32_t slotsize;   // sizeof(shmring_slot)
+  double tstep;        // sampling interval [s]
+  uint64_t closed;     // set once the producer has published the last sample
+  char pad1[32];
+  uint64_t head;       // number of samples published (next sequence number)
+  char pad2[56];       // keep head on its own cache line
+} shmring_hdr;
+
+typedef struct shmring {
+  shmring_hdr *hdr;    // mapped header, followed by the slots
+  shmring_slot *slot;  // slot[0..nslots-1]
+  uint64_t mask;       // nslots - 1
+  uint64_t head;       // producer: sequence number of the next sample
+  long size;           // size of the mapping [bytes]
+} shmring;
+
+/* producer */
+int  shmring_create(shmring *r, const char *name, long nslots, double tstep);
+void shmring_publish(shmring *r, const double *z, const double *ipeak, int n);
+void shmring_close(shmring *r);
+
+/* consumer */
+int  shmring_attach(shmring *r, const char *name);
+long shmring_read(shmring *r, uint64_t *pos, float *z, int32_t *label,
+                  long n);
+uint64_t shmring_head(shmring *r);
+const shmring_slot *shmring_at(shmring *r, uint64_t pos);
+int  shmring_check(shmring *r, uint64_t pos);
+int  shmring_closed(shmring *r);
+void shmring_detach(shmring *r);
+
+#endif /* _SHMRING_H */
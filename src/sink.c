@@ -0,0 +1,306 @@
+// "sink.c" - output sinks for synthetic ECG samples.
+//
+// Samples are handed over in blocks as soon as they are available, so that
+// ECGSYN can feed a downstream process through a pipe (`-O -`) without a
+// temporary file. Status messages of the generator go to stderr, leaving
+// standard output to the sample stream alone.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "sink.h"
+
+/*---------------------------------------------------------------------------*/
+/*      OUTPUT FORMAT BY NAME                                                */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Looks up an output format by name ("txt", "f32" or "i16").
+//!
+//! @return the format constant, or -1 if the name is not recognised
+int sink_format(const char *name){
+  if(strcmp(name,"txt") == 0) return SINK_TXT;
+  if(strcmp(name,"f32") == 0) return SINK_F32;
+  if(strcmp(name,"i16") == 0) return SINK_I16;
+  return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      PACK RECORDS                                                         */
+/*---------------------------------------------------------------------------*/
+
+/* one text record into buf[0..SINK_MAXREC-1]; a record too long for it (a
+   huge value) is cut short instead of moving past its slot */
+static long txtrec(char *buf, double t, double v, int label){
+  int m;
+
+  m = snprintf(buf,SINK_MAXREC,"%f %f %d\n",t,v,label);
+  if(m < 0) return 0;
+  return m < SINK_MAXREC ? m : SINK_MAXREC-1;
+}
+
+//! @brief Formats a block of samples into memory, e.g. for a socket.
+//!
+//! @param format  one of SINK_TXT, SINK_F32, SINK_I16
+//! @param tstep   sampling interval of the samples [s]
+//! @param n0      index of the first sample of the block in the record
+//! @param z       voltages of the block [mV], z[0..n-1]
+//! @param ipeak   PQRST peak labels of the block, ipeak[0..n-1]
+//! @param n       number of samples in the block
+//! @param buf     destination, at least n*SINK_MAXREC bytes
+//!
+//! @return number of bytes written to buf
+long sink_pack(int format, double tstep, long n0, const double *z, 
+               const double *ipeak, int n, char *buf){
+
+  int i;
+  long len;
+  float f;
+  int32_t l32;
+  int16_t v16[2];
+  double uv;
+
+  len = 0;
+  switch(format){
+  case SINK_TXT:
+    for(i=0;i<n;i++)
+      len += txtrec(buf+len,(n0+i)*tstep,z[i],(int)ipeak[i]);
+    break;
+  case SINK_F32:
+    for(i=0;i<n;i++){
+      f = (float)z[i];
+      l32 = (int32_t)ipeak[i];
+      memcpy(buf+8*i,&f,4);
+      memcpy(buf+8*i+4,&l32,4);
+    }
+    len = 8L*n;
+    break;
+  case SINK_I16:
+    for(i=0;i<n;i++){
+      uv = rint(1000.0*z[i]);
+      if(uv > INT16_MAX) uv = INT16_MAX;
+      if(uv < INT16_MIN) uv = INT16_MIN;
+      v16[0] = (int16_t)uv;
+      v16[1] = (int16_t)ipeak[i];
+      memcpy(buf+4*i,v16,4);
+    }
+    len = 4L*n;
+    break;
+  }
+  return len;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      SCALE AND PACK RECORDS                                               */
+/*---------------------------------------------------------------------------*/
+
+// Binary records as sink_pack() lays them out with memcpy().
+typedef struct { float v; int32_t label; } rec_f32;
+typedef struct { int16_t v; int16_t label; } rec_i16;
+
+// rint() in the default rounding mode for |x| < 2^51, in plain arithmetic
+// that vectorises without SSE4.1.
+#define RINT_MAGIC 6755399441055744.0
+
+//! @brief Scales a block of raw model output to the output voltage, adds
+//! the noise and packs it, in a single pass over the block.
+//!
+//! Gives the same bytes as scaling z to (z-zmin)*1.6/zrange - 0.4 mV,
+//! adding the noise and calling sink_pack(), without storing the scaled
+//! voltages anywhere. The binary formats compile to vector loops.
+//!
+//! @param format  one of SINK_TXT, SINK_F32, SINK_I16
+//! @param tstep   sampling interval of the samples [s]
+//! @param n0      index of the first sample of the block in the record
+//! @param z       raw z of the block, z[0..n-1]
+//! @param noise   additive noise of the block [mV], noise[0..n-1]
+//! @param ipeak   PQRST peak labels of the block, ipeak[0..n-1]
+//! @param n       number of samples in the block
+//! @param zmin    minimum of z over the record
+//! @param zrange  range of z over the record
+//! @param buf     destination, at least n*SINK_MAXREC bytes, malloc'ed
+//!
+//! @return number of bytes written to buf
+long sink_packraw(int format, double tstep, long n0, const double *z,
+                  const double *noise, const double *ipeak, int n,
+                  double zmin, double zrange, char *buf){
+
+  int i;
+  long len;
+  double v,uv;
+  rec_f32 *rf;
+  rec_i16 *ri;
+
+  len = 0;
+  switch(format){
+  case SINK_TXT:
+    for(i=0;i<n;i++){
+      v = (z[i]-zmin)*(1.6)/zrange - 0.4 + noise[i];
+      len += txtrec(buf+len,(n0+i)*tstep,v,(int)ipeak[i]);
+    }
+    break;
+  case SINK_F32:
+    rf = (rec_f32 *)buf;
+    for(i=0;i<n;i++){
+      v = (z[i]-zmin)*(1.6)/zrange - 0.4 + noise[i];
+      rf[i].v = (float)v;
+      rf[i].label = (int32_t)ipeak[i];
+    }
+    len = 8L*n;
+    break;
+  case SINK_I16:
+    ri = (rec_i16 *)buf;
+    for(i=0;i<n;i++){
+      v = (z[i]-zmin)*(1.6)/zrange - 0.4 + noise[i];
+      uv = (1000.0*v + RINT_MAGIC) - RINT_MAGIC;
+      uv = uv > INT16_MAX ? INT16_MAX : uv;
+      uv = uv < INT16_MIN ? INT16_MIN : uv;
+      ri[i].v = (int16_t)(int32_t)uv;
+      ri[i].label = (int16_t)(int32_t)ipeak[i];
+    }
+    len = 4L*n;
+    break;
+  }
+  return len;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      OPEN SINK                                                            */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Opens a sink on a file, or on standard output if the file name is
+//! "-".
+//!
+//! @param s          sink to initialise
+//! @param filename   output file name, "-" for standard output
+//! @param format     one of SINK_TXT, SINK_F32, SINK_I16
+//! @param tstep      sampling interval of the samples [s]
+//! @param blocksize  maximum number of samples passed to one sink_write()
+//!
+//! @return 0 on success, -1 if the file could not be opened
+int sink_open(sink *s, const char *filename, int format, double tstep, 
+              int blocksize){
+
+  memset(s,0,sizeof(*s));
+  s->format = format;
+  s->tstep = tstep;
+
+  if(strcmp(filename,"-") == 0){
+    s->fp = stdout;
+    s->isstdout = 1;
+  }
+  else{
+    s->fp = fopen(filename,(format == SINK_TXT) ? "w" : "wb");
+    if(!s->fp) return -1;
+  }
+
+  s->nbuf = blocksize;
+  s->buf = (char *)malloc((size_t)blocksize*SINK_MAXREC);
+  if(!s->buf){
+    if(!s->isstdout) fclose(s->fp);
+    return -1;
+  }
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      RESUME SINK                                                          */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Reopens the file of an interrupted run after its first nsamples
+//! samples (nbytes bytes), dropping anything written after them, so that the
+//! run can continue as if it had never stopped. Standard output is simply
+//! continued with sample nsamples.
+//!
+//! @return 0 on success, -1 if the file cannot be opened or is shorter
+int sink_resume(sink *s, const char *filename, int format, double tstep,
+                int blocksize, long nsamples, long nbytes){
+
+  if(strcmp(filename,"-") == 0){
+    if(sink_open(s,filename,format,tstep,blocksize) != 0) return -1;
+  }
+  else{
+    memset(s,0,sizeof(*s));
+    s->format = format;
+    s->tstep = tstep;
+    s->fp = fopen(filename,(format == SINK_TXT) ? "r+" : "r+b");
+    if(!s->fp) return -1;
+    if(fseek(s->fp,0,SEEK_END) != 0 || ftell(s->fp) < nbytes
+       || ftruncate(fileno(s->fp),(off_t)nbytes) != 0 
+       || fseek(s->fp,nbytes,SEEK_SET) != 0){
+      fclose(s->fp);
+      return -1;
+    }
+    s->nbuf = blocksize;
+    s->buf = (char *)malloc((size_t)blocksize*SINK_MAXREC);
+    if(!s->buf){
+      fclose(s->fp);
+      return -1;
+    }
+  }
+  s->nsamples = nsamples;
+  s->nbytes = nbytes;
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      WRITE BLOCK                                                          */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Writes a block of samples and flushes it if the sink is standard
+//! output, so that a downstream reader sees every block as soon as it is 
+//! produced.
+//!
+//! @param s      open sink
+//! @param z      voltages of the block [mV], z[0..n-1]
+//! @param ipeak  PQRST peak labels of the block, ipeak[0..n-1]
+//! @param n      number of samples in the block (at most the block size)
+//!
+//! @return 0 on success, -1 on a write error (e.g. closed pipe)
+int sink_write(sink *s, const double *z, const double *ipeak, int n){
+
+  long len;
+
+  len = sink_pack(s->format,s->tstep,s->nsamples,z,ipeak,n,s->buf);
+  if(fwrite(s->buf,1,len,s->fp) != (size_t)len) return -1;
+  s->nbytes += len;
+  s->nsamples += n;
+
+  if(s->isstdout && fflush(s->fp) != 0) return -1;
+  return 0;
+}
+
+//! @brief Writes a block of raw model output, scaled and with noise added
+//! on the way (see sink_packraw()).
+//!
+//! @return 0 on success, -1 on a write error (e.g. closed pipe)
+int sink_writeraw(sink *s, const double *z, const double *noise,
+                  const double *ipeak, int n, double zmin, double zrange){
+
+  long len;
+
+  len = sink_packraw(s->format,s->tstep,s->nsamples,z,noise,ipeak,n,
+                     zmin,zrange,s->buf);
+  if(fwrite(s->buf,1,len,s->fp) != (size_t)len) return -1;
+  s->nbytes += len;
+  s->nsamples += n;
+
+  if(s->isstdout && fflush(s->fp) != 0) return -1;
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      CLOSE SINK                                                           */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Flushes and closes a sink. Standard output is flushed but left open.
+void sink_close(sink *s){
+  if(s->isstdout) fflush(s->fp);
+  else if(s->fp) fclose(s->fp);
+  free(s->buf);
+  s->fp = NULL;
+  s->buf = NULL;
+}
@@ -0,0 +1,54 @@
+// "sink.h" - output sinks for synthetic ECG samples.
+//
+// A sink receives the final (scaled, noisy, labelled) ECG samples in blocks
+// and writes them to a file or to standard output, either as the original
+// "time voltage label" text lines or as packed binary records.
+
+#ifndef _SINK_H
+#define _SINK_H
+
+#include <stdio.h>
+
+/*---------------------------------------------------------------------------*/
+/*      OUTPUT FORMATS                                                       */
+/*---------------------------------------------------------------------------*/
+
+// Text lines "%f %f %d\n": time (s), voltage (mV) and PQRST peak label.
+#define SINK_TXT 0
+
+// Binary records { float voltage_mV; int32_t label; }, native byte order.
+#define SINK_F32 1
+
+// Binary records { int16_t voltage_uV; int16_t label; }, native byte order.
+#define SINK_I16 2
+
+// Upper bound of the size of one record in any format [bytes].
+#define SINK_MAXREC 64
+
+typedef struct sink {
+  FILE *fp;           // destination stream
+  int format;         // one of SINK_TXT, SINK_F32, SINK_I16
+  int isstdout;       // destination is standard output (flushed per block)
+  double tstep;       // sampling interval of the samples [s]
+  long nsamples;      // number of samples written so far
+  long nbytes;        // number of bytes written so far
+  char *buf;          // packing buffer, blocksize*SINK_MAXREC bytes
+  int nbuf;           // capacity of buf in samples
+} sink;
+
+int  sink_format(const char *name);
+long sink_pack(int format, double tstep, long n0, const double *z, 
+               const double *ipeak, int n, char *buf);
+long sink_packraw(int format, double tstep, long n0, const double *z,
+                  const double *noise, const double *ipeak, int n,
+                  double zmin, double zrange, char *buf);
+int  sink_open(sink *s, const char *filename, int format, double tstep, 
+               int blocksize);
+int  sink_resume(sink *s, const char *filename, int format, double tstep,
+                 int blocksize, long nsamples, long nbytes);
+int  sink_write(sink *s, const double *z, const double *ipeak, int n);
+int  sink_writeraw(sink *s, const double *z, const double *noise,
+                   const double *ipeak, int n, double zmin, double zrange);
+void sink_close(sink *s);
+
+#endif /* _SINK_H */
@@ -0,0 +1,128 @@
+// "stats.c" - per-stage timing of a run.
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "trace.h"
+
+static double wall_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static double cpu_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      STAGES                                                               */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Starts the clock of the run; with on == 0 all other calls return
+//! at once.
+void stats_start(runstats *s, int on)
+{
+   memset(s,0,sizeof(*s));
+   s->on = on;
+   s->cur = -1;
+   if(!on) return;
+   s->wall0 = wall_s();
+   s->cpu0 = cpu_s();
+}
+
+//! @brief Opens an interval of the stage `name`, which is created on its
+//! first use, and a trace span of the same name. An interval still open is
+//! closed without samples.
+void stats_begin(runstats *s, const char *name)
+{
+   int i;
+
+   if(!s->on) return;
+   if(s->cur >= 0) stats_end(s, 0, 0.0);
+   for(i=0;i<s->n;i++) if(strcmp(s->st[i].name,name) == 0) break;
+   if(i == s->n)
+   {
+      if(s->n == STATS_MAXSTAGE) return;
+      s->st[s->n++].name = name;
+   }
+   s->cur = i;
+   trace_begin(name);
+   s->c0 = cpu_s();
+   s->w0 = wall_s();
+}
+
+//! @brief Closes the open interval, which processed `samples` samples and
+//! wrote `bytes` bytes.
+void stats_end(runstats *s, long samples, double bytes)
+{
+   double w,c;
+   statstage *t;
+
+   if(!s->on || s->cur < 0) return;
+   w = wall_s();
+   c = cpu_s();
+   t = &s->st[s->cur];
+   t->calls++;
+   t->wall += w - s->w0;
+   t->cpu += c - s->c0;
+   t->samples += samples;
+   t->bytes += bytes;
+   s->cur = -1;
+   trace_end(samples);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      REPORT                                                               */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Writes the stages as JSON to filename, or to stderr if it is "-".
+//!
+//! @param run  further members of the document, "" or "\"key\": value, ..."
+//!
+//! @return non-zero if the file cannot be written
+int stats_write(const runstats *s, const char *filename, const char *run)
+{
+   FILE *fp;
+   struct rusage ru;
+   const statstage *t;
+   double wall,cpu,bytes;
+   int i;
+
+   if(!s->on) return 0;
+   wall = wall_s() - s->wall0;
+   cpu = cpu_s() - s->cpu0;
+   getrusage(RUSAGE_SELF, &ru);
+   bytes = 0.0;
+   for(i=0;i<s->n;i++) bytes += s->st[i].bytes;
+
+   if(strcmp(filename,"-") == 0) fp = stderr;
+   else if((fp = fopen(filename,"w")) == NULL) return -1;
+   fprintf(fp,"{\"ecgsyn_stats\": 1,\n");
+   if(run[0] != '\0') fprintf(fp," %s,\n",run);
+   fprintf(fp," \"wall_s\": %.6f, \"cpu_s\": %.6f, \"peak_rss_mb\": %.1f, "
+           "\"bytes_written\": %.0f,\n", wall, cpu, ru.ru_maxrss/1024.0, bytes);
+   fprintf(fp," \"stages\": [\n");
+   for(i=0;i<s->n;i++)
+   {
+      t = &s->st[i];
+      fprintf(fp,"  {\"name\": \"%s\", \"calls\": %ld, \"wall_s\": %.6f, "
+              "\"cpu_s\": %.6f, \"samples\": %ld, \"samples_per_s\": %.6g, "
+              "\"bytes\": %.0f}%s\n", t->name, t->calls, t->wall, t->cpu,
+              t->samples, t->wall > 0.0 ? t->samples/t->wall : 0.0, t->bytes,
+              i+1 < s->n ? "," : "");
+   }
+   fprintf(fp," ]\n}\n");
+   if(fp == stderr) return 0;
+   return fclose(fp) != 0 ? -1 : 0;
+}
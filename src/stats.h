@@ -0,0 +1,39 @@
+// "stats.h" - per-stage timing of a run.
+//
+// A run is divided into named stages (RR synthesis, integration, output,
+// ...). Each interval between stats_begin() and stats_end() adds its wall
+// and CPU time, the samples it processed and the bytes it wrote to its
+// stage; a stage may be entered many times. stats_write() emits the totals,
+// the peak resident memory and the stages as one JSON document. Every
+// interval is also a span of the trace, if tracing is on (trace.h). A
+// runstats that was not switched on costs a branch per call.
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#define STATS_MAXSTAGE 16
+
+typedef struct statstage {
+  const char *name;    // name of the stage (not copied)
+  long calls;          // number of intervals
+  double wall;         // wall time [s]
+  double cpu;          // CPU time of the process, all threads [s]
+  long samples;        // samples processed
+  double bytes;        // bytes written
+} statstage;
+
+typedef struct runstats {
+  int on;              // timing is switched on
+  int n;               // number of stages
+  int cur;             // stage of the open interval, -1 if none
+  double w0,c0;        // start of the open interval [s]
+  double wall0,cpu0;   // start of the run [s]
+  statstage st[STATS_MAXSTAGE];
+} runstats;
+
+void stats_start(runstats *s, int on);
+void stats_begin(runstats *s, const char *name);
+void stats_end(runstats *s, long samples, double bytes);
+int  stats_write(const runstats *s, const char *filename, const char *run);
+
+#endif /* _STATS_H */
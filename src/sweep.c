@@ -0,0 +1,252 @@
+// "sweep.c" - morphology parameter sweeps over one shared RR series.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "morph.h"
+#include "sweep.h"
+
+#define MAXLINE 256
+
+/*---------------------------------------------------------------------------*/
+/*      VARIANTS                                                             */
+/*---------------------------------------------------------------------------*/
+
+/* Latin hypercube: every range is cut into nvar strata, each used once */
+static void sweep_lhs(sweep *s, int seed)
+{
+   long idum;
+   ran1state st;
+   int d,v,j,*perm,t;
+   sweepdim *dm;
+
+   idum = -seed;
+   memset(&st,0,sizeof(st));
+   perm = (int *)malloc(s->nvar*sizeof(int));
+   for(d=0;d<s->ndim;d++)
+   {
+      dm = &s->dim[d];
+      for(v=0;v<s->nvar;v++) perm[v] = v;
+      for(v=s->nvar-1;v>0;v--)
+      {
+         j = (int)(ran1_r(&idum,&st)*(v+1));
+         t = perm[v]; perm[v] = perm[j]; perm[j] = t;
+      }
+      for(v=0;v<s->nvar;v++)
+         s->val[v*s->ndim+d] = dm->lo + (dm->hi-dm->lo)
+                               *(perm[v] + ran1_r(&idum,&st))/s->nvar;
+   }
+   free(perm);
+}
+
+/* grid: all combinations, the first parameter varying slowest */
+static void sweep_grid(sweep *s)
+{
+   int d,v,i,r;
+   sweepdim *dm;
+
+   for(v=0;v<s->nvar;v++)
+   {
+      r = v;
+      for(d=s->ndim-1;d>=0;d--)
+      {
+         dm = &s->dim[d];
+         i = r % dm->n;
+         r /= dm->n;
+         s->val[v*s->ndim+d] = (dm->n > 1) ?
+            dm->lo + (dm->hi-dm->lo)*i/(dm->n-1) : dm->lo;
+      }
+   }
+}
+
+//! @brief Reads a sweep file for a morphology of k kernels.
+//!
+//! @param nlhs  number of Latin hypercube samples, 0 for the grid
+//! @param seed  seed of the Latin hypercube
+//!
+//! @return 0 on success, -1 if the file cannot be read, is empty or has too
+//!         many variants, or the number of the first invalid line
+int sweep_read(sweep *s, const char *filename, int k, int nlhs, int seed)
+{
+   char line[MAXLINE],name[MAXLINE],*hash;
+   double nvar;
+   int n,lineno;
+   sweepdim *dm;
+   FILE *fp;
+
+   memset(s,0,sizeof(*s));
+   fp = fopen(filename,"r");
+   if(!fp) return -1;
+   for(lineno=1;fgets(line,sizeof(line),fp);lineno++)
+   {
+      if((hash = strchr(line,'#')) != NULL) *hash = '\0';
+      dm = &s->dim[s->ndim];
+      dm->n = 1;
+      n = sscanf(line,"%s %lf %lf %d",name,&dm->lo,&dm->hi,&dm->n);
+      if(n <= 0) continue;
+      if(n < 3 || s->ndim == SWEEP_MAXDIM || dm->n < 1 || strlen(name) >= 8
+         || morph_param(name, k, &dm->wave, &dm->which) != 0)
+      {
+         fclose(fp);
+         return lineno;
+      }
+      strcpy(dm->name, name);
+      s->ndim++;
+   }
+   fclose(fp);
+   if(s->ndim == 0) return -1;
+
+   nvar = 1.0;
+   for(n=0;n<s->ndim;n++) nvar *= s->dim[n].n;
+   if(nlhs > 0) nvar = nlhs;
+   if(nvar < 1 || nvar > SWEEP_MAXVAR) return -1;
+   s->nvar = (int)nvar;
+   s->val = (double *)calloc((size_t)nvar*(unsigned)s->ndim,sizeof(double));
+   if(!s->val) return -1;
+   if(nlhs > 0) sweep_lhs(s, seed);
+   else         sweep_grid(s);
+   return 0;
+}
+
+/* set the parameters of variant v (0..nvar-1) in m */
+void sweep_variant(const sweep *s, int v, genmorph *m)
+{
+   int d;
+
+   for(d=0;d<s->ndim;d++)
+      morph_set(m, s->dim[d].wave, s->dim[d].which, s->val[v*s->ndim+d]);
+}
+
+void sweep_free(sweep *s)
+{
+   free(s->val);
+   memset(s,0,sizeof(*s));
+}
+
+/*---------------------------------------------------------------------------*/
+/*      FORCING TABLE                                                        */
+/*---------------------------------------------------------------------------*/
+
+typedef struct zrec {
+  gen g;               // copy of the generator; must come first
+  zforce *f;           // table being filled
+  long n;              // stages recorded
+} zrec;
+
+/* (x, y) part of derivspqrst(), recording the phase of every stage */
+static void derivxy(gen *g, double t0, double x[], double dxdt[])
+{
+   zrec *r = (zrec *)g;
+   double a0,w0;
+
+   w0 = angfreq(g,t0);
+   a0 = 1.0 - sqrt(x[1]*x[1] + x[2]*x[2]);
+   r->f->theta[r->n] = atan2(x[2],x[1]);
+   r->f->zbase[r->n] = 0.005*sin(2.0*PI*g->p.fhi*t0);
+   r->n++;
+   dxdt[1] = a0*x[1] - w0*x[2];
+   dxdt[2] = a0*x[2] + w0*x[1];
+}
+
+//! @brief Integrates the phase oscillator of g once for the whole record.
+//!
+//! g itself is left untouched; the table comes from its arena.
+//!
+//! @return non-zero if memory runs out
+int zforce_init(zforce *f, const gen *g)
+{
+   zrec r;
+   long i,j;
+
+   memset(f,0,sizeof(*f));
+   f->Nt = g->Nt;
+   f->q = g->q;
+   f->Nts = (g->Nt+g->q-1)/g->q;
+   f->theta = (double *)arena_array(g->mem, f->Nt, 8*sizeof(double));
+   f->xts = arena_vect(g->mem,1,f->Nts);
+   f->yts = arena_vect(g->mem,1,f->Nts);
+   if(!f->theta || !f->xts || !f->yts)
+   {
+      zforce_free(f);
+      return -1;
+   }
+   f->zbase = f->theta + 4*(size_t)f->Nt;
+
+   r.g = *g;
+   r.f = f;
+   r.n = 0;
+   j = 0;
+   for(i=0;i<f->Nt;i++)
+   {
+      if(i % f->q == 0)
+      {
+         j++;
+         f->xts[j] = r.g.x[1];
+         f->yts[j] = r.g.x[2];
+      }
+      drk4(&r.g, r.g.x, 2, r.g.timev, r.g.h, r.g.x, derivxy);
+      r.g.timev += r.g.h;
+   }
+   return 0;
+}
+
+/* sum of the Gaussian kernels of g at phase t */
+static double zkernels(const gen *g, double t)
+{
+   int i;
+   double dt,dt2,s;
+
+   s = 0.0;
+   for(i=1;i<=g->k;i++)
+   {
+      dt = fmod(t-g->ti[i],2.0*PI);
+      dt2 = dt*dt;
+      s += -g->ai[i]*dt*exp(-0.5*dt2/(g->bi[i]*g->bi[i]));
+   }
+   return s;
+}
+
+//! @brief Integrates z for the morphology of g against the forcing table.
+//!
+//! Same fourth order Runge-Kutta steps as drk4() on the full model, so the
+//! result is identical to a run of the model with this morphology.
+//!
+//! @param zts  decimated raw z, zts[1..f->Nts]
+void zforce_run(const zforce *f, const gen *g, double *zts)
+{
+   long i,j;
+   double z,zt,h,hh,h6,k1,k2,k3,k4;
+   const double *th,*zb;
+
+   h = g->h;
+   hh = h*0.5;
+   h6 = h/6.0;
+   z = 0.04;
+   j = 0;
+   for(i=0;i<f->Nt;i++)
+   {
+      if(i % f->q == 0) zts[++j] = z;
+      th = f->theta + 4*(size_t)i;
+      zb = f->zbase + 4*(size_t)i;
+      k1 = zkernels(g,th[0]);
+      k1 += -1.0*(z - zb[0]);
+      zt = z + hh*k1;
+      k2 = zkernels(g,th[1]);
+      k2 += -1.0*(zt - zb[1]);
+      zt = z + hh*k2;
+      k3 = zkernels(g,th[2]);
+      k3 += -1.0*(zt - zb[2]);
+      zt = z + h*k3;
+      k3 += k2;
+      k4 = zkernels(g,th[3]);
+      k4 += -1.0*(zt - zb[3]);
+      z = z + h6*(k1+k4+2.0*k3);
+   }
+}
+
+/* the table goes with the arena of the generator */
+void zforce_free(zforce *f)
+{
+   memset(f,0,sizeof(*f));
+}
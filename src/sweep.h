@@ -0,0 +1,56 @@
+// "sweep.h" - morphology parameter sweeps over one shared RR series.
+//
+// A sweep file lists the morphology parameters to vary, one per line:
+//
+//     name lo hi [n]
+//
+// e.g. "ai3 20 40 5" for five R amplitudes from 20 to 40. The variants are
+// the grid of all combinations, or a Latin hypercube of a given number of
+// samples over the same ranges (n is then ignored).
+//
+// The (x, y) phase oscillator does not depend on the morphology, so it is
+// integrated once and its phase at every Runge-Kutta stage is kept in a
+// forcing table (`zforce`). Each variant then only integrates z against the
+// table, with the same RR series and the same arithmetic as the full model.
+
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include "gen.h"
+
+#define SWEEP_MAXDIM 16
+#define SWEEP_MAXVAR 1000000
+
+typedef struct sweepdim {
+  char name[8];        // parameter name, e.g. "ai3"
+  int wave;            // kernel number
+  char which;          // 't', 'a' or 'b'
+  double lo,hi;        // range
+  int n;               // grid points
+} sweepdim;
+
+typedef struct sweep {
+  int ndim;            // number of parameters varied
+  sweepdim dim[SWEEP_MAXDIM];
+  int nvar;            // number of variants
+  double *val;         // value of parameter d in variant v: val[v*ndim+d]
+} sweep;
+
+typedef struct zforce {
+  long Nt;             // number of internal samples
+  int q;               // decimation factor
+  long Nts;            // number of output samples
+  double *theta;       // phase at the four stages of step i: theta[4*i..]
+  double *zbase;       // baseline wander at the same stages
+  double *xts,*yts;    // decimated oscillator xts[1..Nts], yts[1..Nts]
+} zforce;
+
+int  sweep_read(sweep *s, const char *filename, int k, int nlhs, int seed);
+void sweep_variant(const sweep *s, int v, genmorph *m);
+void sweep_free(sweep *s);
+
+int  zforce_init(zforce *f, const gen *g);
+void zforce_run(const zforce *f, const gen *g, double *zts);
+void zforce_free(zforce *f);
+
+#endif /* _SWEEP_H */
@@ -0,0 +1,206 @@
+// "trace.c" - timeline of a threaded run in the Chrome trace-event format.
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "trace.h"
+
+typedef struct traceev {
+  const char *name;    // name of the event (not copied)
+  char ph;             // 'X' span, 'i' instant or 'C' counter
+  long long ts;        // time of the event or start of the span [ns]
+  long long dur;       // duration of the span [ns]
+  long n;              // argument, < 0 for none (spans and instants)
+} traceev;
+
+typedef struct tracebuf {
+  int tid;             // number of the thread, in order of its first event
+  char name[32];       // name of the thread, "" if not named
+  long long nev;       // events recorded; the last TRACE_NEVENT are kept
+  int depth;           // open spans
+  const char *open[TRACE_DEPTH]; // names of the open spans
+  long long t0[TRACE_DEPTH];     // starts of the open spans [ns]
+  traceev ev[TRACE_NEVENT];
+  struct tracebuf *next;
+} tracebuf;
+
+static int on;                 // tracing is switched on
+static long long t0ns;         // time of trace_start() [ns]
+static pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER; // protects bufs
+static tracebuf *bufs;         // rings of all threads that recorded events
+static int nthread;            // number of rings
+static __thread tracebuf *self; // ring of the calling thread
+
+static long long now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec*1000000000LL + ts.tv_nsec - t0ns;
+}
+
+/* the ring of the calling thread, created on its first event */
+static tracebuf *ring(void)
+{
+   tracebuf *b;
+
+   if(self) return self;
+   b = (tracebuf *)calloc(1, sizeof(tracebuf));
+   if(!b) return NULL;
+   pthread_mutex_lock(&mu);
+   b->tid = ++nthread;
+   b->next = bufs;
+   bufs = b;
+   pthread_mutex_unlock(&mu);
+   self = b;
+   return b;
+}
+
+static void record(tracebuf *b, const char *name, char ph, long long ts,
+                   long long dur, long n)
+{
+   traceev *e;
+
+   e = &b->ev[b->nev & (TRACE_NEVENT-1)];
+   e->name = name;
+   e->ph = ph;
+   e->ts = ts;
+   e->dur = dur;
+   e->n = n;
+   b->nev++;
+}
+
+/*---------------------------------------------------------------------------*/
+/*      EVENTS                                                               */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Switches tracing on (before any thread is started) and names the
+//! calling thread "main".
+void trace_start(int enable)
+{
+   on = enable;
+   if(!on) return;
+   t0ns = 0;
+   t0ns = now();
+   trace_thread("main", -1);
+}
+
+int trace_on(void)
+{
+   return on;
+}
+
+//! @brief Names the calling thread `name`, or "name i" if i >= 0.
+void trace_thread(const char *name, int i)
+{
+   tracebuf *b;
+
+   if(!on || (b = ring()) == NULL) return;
+   if(i < 0) snprintf(b->name, sizeof(b->name), "%s", name);
+   else      snprintf(b->name, sizeof(b->name), "%s %d", name, i);
+}
+
+//! @brief Opens a span of the calling thread; spans nest.
+void trace_begin(const char *name)
+{
+   tracebuf *b;
+
+   if(!on || (b = ring()) == NULL) return;
+   if(b->depth < TRACE_DEPTH)
+   {
+      b->open[b->depth] = name;
+      b->t0[b->depth] = now();
+   }
+   b->depth++;
+}
+
+//! @brief Closes the innermost open span, which processed n items (samples,
+//! bytes, ...; n < 0: none given).
+void trace_end(long n)
+{
+   tracebuf *b = self;
+   int d;
+
+   if(!on || !b || b->depth == 0) return;
+   d = --b->depth;
+   if(d < TRACE_DEPTH) record(b, b->open[d], 'X', b->t0[d], now()-b->t0[d], n);
+}
+
+//! @brief Records an event without duration.
+void trace_instant(const char *name, long n)
+{
+   tracebuf *b;
+
+   if(!on || (b = ring()) == NULL) return;
+   record(b, name, 'i', now(), 0, n);
+}
+
+//! @brief Records the value of the counter `name` (e.g. a queue length).
+void trace_count(const char *name, long value)
+{
+   tracebuf *b;
+
+   if(!on || (b = ring()) == NULL) return;
+   record(b, name, 'C', now(), 0, value);
+}
+
+/*---------------------------------------------------------------------------*/
+/*      REPORT                                                               */
+/*---------------------------------------------------------------------------*/
+
+//! @brief Writes the events of all threads to filename as a Chrome
+//! trace-event document. Spans still open are not written.
+//!
+//! @return non-zero if the file cannot be written
+int trace_write(const char *filename)
+{
+   FILE *fp;
+   tracebuf *b;
+   traceev *e;
+   long long i,i0,dropped;
+   const char *sep;
+
+   if(!on) return 0;
+   if((fp = fopen(filename,"w")) == NULL) return -1;
+   pthread_mutex_lock(&mu);
+   dropped = 0;
+   for(b=bufs;b;b=b->next)
+      if(b->nev > TRACE_NEVENT) dropped += b->nev-TRACE_NEVENT;
+   fprintf(fp,"{\"displayTimeUnit\": \"ms\", \"droppedEvents\": %lld,\n"
+           "\"traceEvents\": [\n", dropped);
+   sep = "";
+   for(b=bufs;b;b=b->next)
+   {
+      if(b->name[0] != '\0')
+      {
+         fprintf(fp,"%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                 "\"tid\": %d, \"args\": {\"name\": \"%s\"}}", sep, b->tid,
+                 b->name);
+         fprintf(fp,",\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", "
+                 "\"pid\": 1, \"tid\": %d, \"args\": {\"sort_index\": %d}}",
+                 b->tid, b->tid);
+         sep = ",\n";
+      }
+      i0 = b->nev > TRACE_NEVENT ? b->nev-TRACE_NEVENT : 0;
+      for(i=i0;i<b->nev;i++)
+      {
+         e = &b->ev[i & (TRACE_NEVENT-1)];
+         fprintf(fp,"%s{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, "
+                 "\"tid\": %d, \"ts\": %.3f", sep, e->name, e->ph, b->tid,
+                 e->ts*1e-3);
+         if(e->ph == 'X') fprintf(fp,", \"dur\": %.3f", e->dur*1e-3);
+         if(e->ph == 'i') fprintf(fp,", \"s\": \"t\"");
+         if(e->ph == 'C' || e->n >= 0)
+           fprintf(fp,", \"args\": {\"n\": %ld}", e->n);
+         fprintf(fp,"}");
+         sep = ",\n";
+      }
+   }
+   fprintf(fp,"\n]}\n");
+   pthread_mutex_unlock(&mu);
+   return fclose(fp) != 0 ? -1 : 0;
+}
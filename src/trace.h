@@ -0,0 +1,25 @@
+// "trace.h" - timeline of a threaded run in the Chrome trace-event format.
+//
+// Every thread records its spans (trace_begin() .. trace_end()), instants
+// and counters into a ring of its own, without locking; once the ring is
+// full the oldest events are overwritten. trace_write() merges the rings
+// into one JSON document that chrome://tracing and ui.perfetto.dev show as
+// a track per thread; call it once the traced threads have finished. While
+// tracing is off every call returns after one test.
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#define TRACE_NEVENT 65536   // events kept per thread (a power of two)
+#define TRACE_DEPTH  16      // open spans per thread
+
+void trace_start(int on);
+int  trace_on(void);
+void trace_thread(const char *name, int i);
+void trace_begin(const char *name);
+void trace_end(long n);
+void trace_instant(const char *name, long n);
+void trace_count(const char *name, long value);
+int  trace_write(const char *filename);
+
+#endif /* _TRACE_H */
@@ -0,0 +1,181 @@
+// "vcg.c" - vectorcardiogram engine: 12 leads from one integration.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vcg.h"
+
+/*---------------------------------------------------------------------------*/
+/*      LEAD SYSTEM                                                          */
+/*---------------------------------------------------------------------------*/
+
+const char *vcg_leadname[VCG_NLEAD] = {
+  "I", "II", "III", "aVR", "aVL", "aVF", "V1", "V2", "V3", "V4", "V5", "V6"
+};
+
+// Inverse Dower matrix (Edenbrandt & Pahlm, 1988) for I, II and V1..V6;
+// III = II - I, aVR = -(I + II)/2, aVL = I - II/2, aVF = II - I/2.
+#define D_I   0.632, -0.235,  0.059
+#define D_II  0.235,  1.066, -0.132
+const double vcg_dower[VCG_NLEAD][3] = {
+  { D_I },
+  { D_II },
+  { 0.235-0.632,          1.066+0.235,          -0.132-0.059 },
+  { -(0.632+0.235)/2,     -(-0.235+1.066)/2,    -(0.059-0.132)/2 },
+  { 0.632-0.235/2,        -0.235-1.066/2,       0.059+0.132/2 },
+  { 0.235-0.632/2,        1.066+0.235/2,        -0.132-0.059/2 },
+  { -0.515,  0.157, -0.917 },
+  {  0.044,  0.164, -1.387 },
+  {  0.882,  0.098, -1.277 },
+  {  1.213,  0.127, -0.601 },
+  {  1.125,  0.127, -0.086 },
+  {  0.831,  0.076,  0.230 }
+};
+
+/*---------------------------------------------------------------------------*/
+/*      DIPOLE MODEL                                                         */
+/*---------------------------------------------------------------------------*/
+
+/* the three dipole components share the phase and one kernel evaluation */
+static void derivvcg(gen *g, double t0, double x[], double dxdt[])
+{
+   vcg *v = (vcg *)g;
+   int i;
+   double a0,w0,t,dt,e,zbase;
+
+   w0 = angfreq(g,t0);
+   a0 = 1.0 - sqrt(x[1]*x[1] + x[2]*x[2]);
+   zbase = 0.005*sin(2.0*PI*g->p.fhi*t0);
+
+   t = atan2(x[2],x[1]);
+   dxdt[1] = a0*x[1] - w0*x[2];
+   dxdt[2] = a0*x[2] + w0*x[1];
+   dxdt[3] = dxdt[4] = dxdt[5] = 0.0;
+   for(i=1;i<=g->k;i++)
+   {
+      dt = fmod(t-g->ti[i],2.0*PI);
+      e = -dt*exp(-0.5*dt*dt/(g->bi[i]*g->bi[i]));
+      dxdt[3] += v->ax[i]*e;
+      dxdt[4] += v->ay[i]*e;
+      dxdt[5] += v->az[i]*e;
+   }
+   dxdt[3] += -1.0*(x[3] - zbase);
+   dxdt[4] += -1.0*(x[4] - zbase);
+   dxdt[5] += -1.0*(x[5] - zbase);
+}
+
+/* Put the dipole on its limit cycle. Started from X = Y = Z = 0 the first
+   beat is a start-up transient, deeper than any later one, which would set
+   the lead gain. A copy of the model runs for VCG_WARM seconds at the mean
+   heart rate, as gen_template() does, and on to the next start of a beat
+   (the phase crossing 0, where the record starts); its X, Y, Z become the
+   initial dipole. The record itself, RR cursor and all, is left untouched. */
+#define VCG_WARM 5.0
+
+static void vcg_settle(vcg *v)
+{
+   vcg s;
+   double theta,prev;
+   long i,nwarm;
+
+   s = *v;
+   s.g.chan.tail = s.g.chan.head;
+   s.g.morphdue = 0;
+   s.g.rrscaled = 1;
+   s.g.rra = 0.0;
+   s.g.rrb = 60.0/s.g.p.hrmean;
+   s.g.rrbeg = 1;
+   s.g.tecg = s.g.rrb;
+   s.g.rrend = lrint(s.g.tecg/s.g.h);
+   s.g.rrval = s.g.rrb;
+   s.g.timev = 0.0;
+   nwarm = (long)ceil(VCG_WARM/s.g.h);
+
+   theta = 0.0;
+   for(i=0;;i++)
+   {
+      prev = theta;
+      theta = atan2(s.x[2],s.x[1]);
+      if(i > nwarm && prev < 0.0 && theta >= 0.0) break;
+      drk4(&s.g, s.x, 5, s.g.timev, s.g.h, s.x, derivvcg);
+      s.g.timev += s.g.h;
+   }
+   for(i=3;i<=5;i++) v->x[i] = s.x[i];
+}
+
+//! @brief Sets up a VCG generator with the default dipole of each PQRST wave,
+//! the dipole settled on its limit cycle.
+//!
+//! @return non-zero if the parameters are invalid, the morphology is not the
+//!         five PQRST waves or memory runs out
+int vcg_init(vcg *v, const genparams *p)
+{
+   int i;
+
+   memset(v,0,sizeof(*v));
+   if(gen_init(&v->g, p) != 0) return -1;
+   if(v->g.k != 5)
+   {
+      gen_free(&v->g);
+      return -1;
+   }
+
+   /* dipole amplitudes: the scalar ai resolved along X, Y, Z */
+   v->ax=arena_vect(v->g.mem,1,5);
+   v->ay=arena_vect(v->g.mem,1,5);
+   v->az=arena_vect(v->g.mem,1,5);
+   if(!v->ax || !v->ay || !v->az)
+   {
+      gen_free(&v->g);
+      return -1;
+   }
+   /* P                  Q                  R                 S                 T        */
+   v->ax[1]=0.8;   v->ax[2]=-2.5;  v->ax[3]=24.0; v->ax[4]=-6.0; v->ax[5]=0.7;
+   v->ay[1]=1.0;   v->ay[2]=-4.0;  v->ay[3]=22.0; v->ay[4]=-5.0; v->ay[5]=0.55;
+   v->az[1]=0.1;   v->az[2]=-3.0;  v->az[3]=12.0; v->az[4]=6.0;  v->az[5]=-0.4;
+
+   for(i=1;i<=5;i++) v->x[i] = 0.0;
+   v->x[1] = 1.0;
+   vcg_settle(v);
+   return 0;
+}
+
+void vcg_free(vcg *v)
+{
+   gen_free(&v->g);
+   memset(v,0,sizeof(*v));
+}
+
+/* advance the dipole model by one internal time step */
+void vcg_step(vcg *v)
+{
+   gen *g = &v->g;
+
+   drk4(g, v->x, 5, g->timev, g->h, v->x, derivvcg);
+   g->timev += g->h;
+   g->it++;
+}
+
+//! @brief Projects n dipole samples onto the 12 leads.
+//!
+//! Each lead is one pass of three multiply-adds over contiguous arrays,
+//! lead[l][0..n-1] = gain * vcg_dower[l] . (X,Y,Z), which the compiler turns
+//! into SIMD code (see CFLAGS in the makefile).
+void vcg_project(const double *X, const double *Y, const double *Z, long n,
+                 double gain, double *lead[VCG_NLEAD])
+{
+   const double *restrict x = X, *restrict y = Y, *restrict z = Z;
+   double *restrict out;
+   double cx,cy,cz;
+   long i;
+   int l;
+
+   for(l=0;l<VCG_NLEAD;l++)
+   {
+      out = lead[l];
+      cx = gain*vcg_dower[l][0];
+      cy = gain*vcg_dower[l][1];
+      cz = gain*vcg_dower[l][2];
+      for(i=0;i<n;i++) out[i] = cx*x[i] + cy*y[i] + cz*z[i];
+   }
+}
@@ -0,0 +1,33 @@
+// "vcg.h" - vectorcardiogram engine: 12 leads from one integration.
+//
+// The scalar z of the ECGSYN model is replaced by the three components
+// X, Y, Z of a cardiac dipole (Frank axes: X left, Y foot, Z back). Each
+// component is a sum of Gaussian kernels driven by the same (x, y) phase
+// oscillator and RR process as the scalar model, with the same angles ti and
+// widths bi but an amplitude per axis. The 12 standard leads are fixed linear
+// projections of the dipole (the inverse Dower matrix), so one integration
+// serves all leads and the projection is the only per-lead cost.
+
+#ifndef _VCG_H
+#define _VCG_H
+
+#include "gen.h"
+
+#define VCG_NLEAD 12         // I II III aVR aVL aVF V1 .. V6
+
+typedef struct vcg {
+  gen g;               // oscillator, RR process and cursor; must come first
+  double *ax,*ay,*az;  // dipole amplitudes of kernel i along X, Y, Z [1..k]
+  double x[6];         // state vector x, y, X, Y, Z in x[1..5]
+} vcg;
+
+extern const char *vcg_leadname[VCG_NLEAD];
+extern const double vcg_dower[VCG_NLEAD][3];
+
+int  vcg_init(vcg *v, const genparams *p);
+void vcg_free(vcg *v);
+void vcg_step(vcg *v);
+void vcg_project(const double *X, const double *Y, const double *Z, long n,
+                 double gain, double *lead[VCG_NLEAD]);
+
+#endif /* _VCG_H */